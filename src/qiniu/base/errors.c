@@ -42,11 +42,16 @@ static qn_err_message_map_st qn_err_message_maps[] = {
     {QN_ERR_HTTP_ADDING_FILE_FIELD_FAILED, "Adding file field to HTTP form failed"},
     {QN_ERR_HTTP_ADDING_BUFFER_FIELD_FAILED, "Adding buffer field to HTTP form failed"},
     {QN_ERR_HTTP_MISMATCHING_FILE_SIZE, "Mismatching file size"},
+    {QN_ERR_HTTP_RESENDING_FORM_FAILED, "Resending HTTP form with data from a one-pass callback failed"},
+
+    {QN_ERR_COMM_DNS_FAILED, "Resolving the host name failed"},
+    {QN_ERR_COMM_TRANSMISSION_FAILED, "Transmitting data failed"},
 
     {QN_ERR_FL_OPENING_FILE_FAILED, "Opening file failed"},
     {QN_ERR_FL_DUPLICATING_FILE_FAILED, "Duplicating file failed"},
     {QN_ERR_FL_READING_FILE_FAILED, "Reading file failed"},
     {QN_ERR_FL_SEEKING_FILE_FAILED, "Seeking file failed"},
+    {QN_ERR_FL_WRITING_FILE_FAILED, "Writing file failed"},
     {QN_ERR_FL_INFO_STATING_FILE_INFO_FAILED, "Stating file infomation failed"},
 
     {QN_ERR_STOR_LACK_OF_AUTHORIZATION_INFORMATION, "Lack of auhorization information like token or put policy"},
@@ -60,6 +65,8 @@ static qn_err_message_map_st qn_err_message_maps[] = {
     {QN_ERR_STOR_LACK_OF_BLOCK_INFO, "Lack of block information"},
     {QN_ERR_STOR_LACK_OF_FILE_SIZE, "Lack of file size"},
     {QN_ERR_STOR_INVALID_UPLOAD_RESULT, "Invalid upload result"},
+    {QN_ERR_STOR_RANGE_NOT_HONORED, "The server ignored the range of the download request"},
+    {QN_ERR_STOR_INVALID_JOURNAL, "Invalid resumable upload journal"},
 
     {QN_ERR_ETAG_INITIALIZING_CONTEXT_FAILED, "Failed in initializing a new qetag context"},
     {QN_ERR_ETAG_UPDATING_CONTEXT_FAILED, "Failed in updating the qetag context"},
@@ -72,7 +79,9 @@ static qn_err_message_map_st qn_err_message_maps[] = {
 
     {QN_ERR_3RDP_GLIBC_ERROR_OCCURRED, "glibc error occurred"},
     {QN_ERR_3RDP_CURL_EASY_ERROR_OCCURRED, "cURL easy error occurred"},
-    {QN_ERR_3RDP_OPENSSL_ERROR_OCCURRED, "OpenSSL error occurred"}
+    {QN_ERR_3RDP_OPENSSL_ERROR_OCCURRED, "OpenSSL error occurred"},
+    {QN_ERR_3RDP_CURL_SHARE_ERROR_OCCURRED, "cURL share error occurred"},
+    {QN_ERR_3RDP_CURL_MULTI_ERROR_OCCURRED, "cURL multi error occurred"}
 };
 
 typedef struct _QN_ERR_MESSAGE
@@ -114,6 +123,12 @@ QN_SDK ssize_t qn_err_format_message(char * buf, size_t buf_size)
             case QN_ERR_3RDP_OPENSSL_ERROR_OCCURRED:
                 ret2 = qn_cs_snprintf(buf + ret, buf_size - ret, "(%lu:%s)", qn_err_msg.lib_code, ERR_error_string(qn_err_msg.lib_code, NULL));
                 break;
+            case QN_ERR_3RDP_CURL_SHARE_ERROR_OCCURRED:
+                ret2 = qn_cs_snprintf(buf + ret, buf_size - ret, "(%lu:%s)", qn_err_msg.lib_code, curl_share_strerror(qn_err_msg.lib_code));
+                break;
+            case QN_ERR_3RDP_CURL_MULTI_ERROR_OCCURRED:
+                ret2 = qn_cs_snprintf(buf + ret, buf_size - ret, "(%lu:%s)", qn_err_msg.lib_code, curl_multi_strerror(qn_err_msg.lib_code));
+                break;
             default:
                 break;
         } // switch
@@ -36,6 +36,7 @@ typedef enum _QN_ERR_CODE
     QN_ERR_HTTP_ADDING_FILE_FIELD_FAILED = 3003,
     QN_ERR_HTTP_ADDING_BUFFER_FIELD_FAILED = 3004,
     QN_ERR_HTTP_MISMATCHING_FILE_SIZE = 3005,
+    QN_ERR_HTTP_RESENDING_FORM_FAILED = 3006,
 
     QN_ERR_COMM_DNS_FAILED = 4001,
     QN_ERR_COMM_TRANSMISSION_FAILED = 4002,
@@ -44,6 +45,7 @@ typedef enum _QN_ERR_CODE
     QN_ERR_FL_DUPLICATING_FILE_FAILED = 11002,
     QN_ERR_FL_READING_FILE_FAILED = 11003,
     QN_ERR_FL_SEEKING_FILE_FAILED = 11004,
+    QN_ERR_FL_WRITING_FILE_FAILED = 11005,
     QN_ERR_FL_INFO_STATING_FILE_INFO_FAILED = 11101,
 
     QN_ERR_STOR_LACK_OF_AUTHORIZATION_INFORMATION = 21001,
@@ -57,6 +59,8 @@ typedef enum _QN_ERR_CODE
     QN_ERR_STOR_LACK_OF_BLOCK_INFO = 21009,
     QN_ERR_STOR_LACK_OF_FILE_SIZE = 21010,
     QN_ERR_STOR_INVALID_UPLOAD_RESULT = 21011,
+    QN_ERR_STOR_RANGE_NOT_HONORED = 21012,
+    QN_ERR_STOR_INVALID_JOURNAL = 21013,
 
     QN_ERR_ETAG_INITIALIZING_CONTEXT_FAILED = 22001,
     QN_ERR_ETAG_UPDATING_CONTEXT_FAILED = 22002,
@@ -70,6 +74,8 @@ typedef enum _QN_ERR_CODE
     QN_ERR_3RDP_GLIBC_ERROR_OCCURRED = 101001,
     QN_ERR_3RDP_CURL_EASY_ERROR_OCCURRED = 101002,
     QN_ERR_3RDP_OPENSSL_ERROR_OCCURRED = 101003,
+    QN_ERR_3RDP_CURL_SHARE_ERROR_OCCURRED = 101004,
+    QN_ERR_3RDP_CURL_MULTI_ERROR_OCCURRED = 101005,
 } qn_err_code_em;
 
 QN_SDK extern ssize_t qn_err_format_message(char * buf, size_t buf_size);
@@ -105,6 +111,7 @@ QN_SDK extern qn_err_code_em qn_err_get_code(void);
 #define qn_err_http_set_adding_file_field_failed() qn_err_set_code(QN_ERR_HTTP_ADDING_FILE_FIELD_FAILED, 0, __FILE__, __LINE__)
 #define qn_err_http_set_adding_buffer_field_failed() qn_err_set_code(QN_ERR_HTTP_ADDING_BUFFER_FIELD_FAILED, 0, __FILE__, __LINE__)
 #define qn_err_http_set_mismatching_file_size() qn_err_set_code(QN_ERR_HTTP_MISMATCHING_FILE_SIZE, 0, __FILE__, __LINE__)
+#define qn_err_http_set_resending_form_failed() qn_err_set_code(QN_ERR_HTTP_RESENDING_FORM_FAILED, 0, __FILE__, __LINE__)
 
 #define qn_err_comm_set_dns_failed() qn_err_set_code(QN_ERR_COMM_DNS_FAILED, 0, __FILE__, __LINE__)
 #define qn_err_comm_set_transmission_failed() qn_err_set_code(QN_ERR_COMM_TRANSMISSION_FAILED, 0, __FILE__, __LINE__)
@@ -113,6 +120,7 @@ QN_SDK extern qn_err_code_em qn_err_get_code(void);
 #define qn_err_fl_set_duplicating_file_failed() qn_err_set_code(QN_ERR_FL_DUPLICATING_FILE_FAILED, 0, __FILE__, __LINE__)
 #define qn_err_fl_set_reading_file_failed() qn_err_set_code(QN_ERR_FL_READING_FILE_FAILED, 0, __FILE__, __LINE__)
 #define qn_err_fl_set_seeking_file_failed() qn_err_set_code(QN_ERR_FL_SEEKING_FILE_FAILED, 0, __FILE__, __LINE__)
+#define qn_err_fl_set_writing_file_failed() qn_err_set_code(QN_ERR_FL_WRITING_FILE_FAILED, 0, __FILE__, __LINE__)
 
 #define qn_err_fl_info_set_stating_file_info_failed() qn_err_set_code(QN_ERR_FL_INFO_STATING_FILE_INFO_FAILED, 0, __FILE__, __LINE__)
 
@@ -127,6 +135,8 @@ QN_SDK extern qn_err_code_em qn_err_get_code(void);
 #define qn_err_stor_set_lack_of_file_size() qn_err_set_code(QN_ERR_STOR_LACK_OF_FILE_SIZE, 0, __FILE__, __LINE__)
 #define qn_err_stor_set_lack_of_block_info() qn_err_set_code(QN_ERR_STOR_LACK_OF_BLOCK_INFO, 0, __FILE__, __LINE__)
 #define qn_err_stor_set_invalid_upload_result() qn_err_set_code(QN_ERR_STOR_INVALID_UPLOAD_RESULT, 0, __FILE__, __LINE__)
+#define qn_err_stor_set_range_not_honored() qn_err_set_code(QN_ERR_STOR_RANGE_NOT_HONORED, 0, __FILE__, __LINE__)
+#define qn_err_stor_set_invalid_journal() qn_err_set_code(QN_ERR_STOR_INVALID_JOURNAL, 0, __FILE__, __LINE__)
 
 #define qn_err_etag_set_initializing_context_failed() qn_err_set_code(QN_ERR_ETAG_INITIALIZING_CONTEXT_FAILED, 0, __FILE__, __LINE__)
 #define qn_err_etag_set_updating_context_failed() qn_err_set_code(QN_ERR_ETAG_UPDATING_CONTEXT_FAILED, 0, __FILE__, __LINE__)
@@ -140,6 +150,8 @@ QN_SDK extern qn_err_code_em qn_err_get_code(void);
 #define qn_err_3rdp_set_glibc_error_occurred(lib_cd) qn_err_set_code(QN_ERR_3RDP_GLIBC_ERROR_OCCURRED, lib_cd, __FILE__, __LINE__)
 #define qn_err_3rdp_set_curl_easy_error_occurred(lib_cd) qn_err_set_code(QN_ERR_3RDP_CURL_EASY_ERROR_OCCURRED, lib_cd, __FILE__, __LINE__)
 #define qn_err_3rdp_set_openssl_error_occurred(lib_cd) qn_err_set_code(QN_ERR_3RDP_OPENSSL_ERROR_OCCURRED, lib_cd, __FILE__, __LINE__)
+#define qn_err_3rdp_set_curl_share_error_occurred(lib_cd) qn_err_set_code(QN_ERR_3RDP_CURL_SHARE_ERROR_OCCURRED, lib_cd, __FILE__, __LINE__)
+#define qn_err_3rdp_set_curl_multi_error_occurred(lib_cd) qn_err_set_code(QN_ERR_3RDP_CURL_MULTI_ERROR_OCCURRED, lib_cd, __FILE__, __LINE__)
 
 // ----
 
@@ -252,6 +264,7 @@ static inline qn_bool qn_err_http_is_adding_buffer_field_failed(void)
 }
 
 #define qn_err_http_is_mismatching_file_size() (qn_err_get_code() == QN_ERR_HTTP_MISMATCHING_FILE_SIZE)
+#define qn_err_http_is_resending_form_failed() (qn_err_get_code() == QN_ERR_HTTP_RESENDING_FORM_FAILED)
 
 #define qn_err_comm_is_dns_failed() (qn_err_get_code() == QN_ERR_COMM_DNS_FAILED)
 #define qn_err_comm_is_transmission_failed() (qn_err_get_code() == QN_ERR_COMM_TRANSMISSION_FAILED)
@@ -276,6 +289,11 @@ static inline qn_bool qn_err_fl_is_seeking_file_failed(void)
     return qn_err_get_code() == QN_ERR_FL_SEEKING_FILE_FAILED;
 }
 
+static inline qn_bool qn_err_fl_is_writing_file_failed(void)
+{
+    return qn_err_get_code() == QN_ERR_FL_WRITING_FILE_FAILED;
+}
+
 static inline qn_bool qn_err_fl_info_is_stating_file_info_failed(void)
 {
     return qn_err_get_code() == QN_ERR_FL_INFO_STATING_FILE_INFO_FAILED;
@@ -336,6 +354,16 @@ static inline qn_bool qn_err_stor_is_invalid_upload_result(void)
     return qn_err_get_code() == QN_ERR_STOR_INVALID_UPLOAD_RESULT;
 }
 
+static inline qn_bool qn_err_stor_is_range_not_honored(void)
+{
+    return qn_err_get_code() == QN_ERR_STOR_RANGE_NOT_HONORED;
+}
+
+static inline qn_bool qn_err_stor_is_invalid_journal(void)
+{
+    return qn_err_get_code() == QN_ERR_STOR_INVALID_JOURNAL;
+}
+
 static inline qn_bool qn_err_etag_is_initializing_context_failed(void)
 {
     return qn_err_get_code() == QN_ERR_ETAG_INITIALIZING_CONTEXT_FAILED;
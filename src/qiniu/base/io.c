@@ -87,7 +87,8 @@ static qn_io_reader_st qn_io_srdr_vtable = {
     NULL, // DUPLICATE
     NULL, // SECTION
     &qn_io_srdr_name_vfn,
-    &qn_io_srdr_size_vfn
+    &qn_io_srdr_size_vfn,
+    NULL // PREFETCH
 };
 
 QN_SDK qn_io_section_reader_ptr qn_io_srdr_create(qn_io_reader_itf restrict src_rdr, size_t section_size)
@@ -34,6 +34,8 @@ typedef qn_io_reader_itf (*qn_io_rdr_section_virtual_fn)(qn_io_reader_itf restri
 typedef qn_string (*qn_io_rdr_name_virtual_fn)(qn_io_reader_itf restrict itf);
 typedef qn_fsize (*qn_io_rdr_size_virtual_fn)(qn_io_reader_itf restrict itf);
 
+typedef void (*qn_io_rdr_prefetch_virtual_fn)(qn_io_reader_itf restrict itf, qn_foffset offset, size_t size);
+
 typedef struct _QN_IO_READER
 {
     qn_io_rdr_close_virtual_fn close;
@@ -47,6 +49,8 @@ typedef struct _QN_IO_READER
 
     qn_io_rdr_name_virtual_fn name;
     qn_io_rdr_size_virtual_fn size;
+
+    qn_io_rdr_prefetch_virtual_fn prefetch;     // Since v0.13.0, may be NULL.
 } qn_io_reader_st;
 
 static inline void qn_io_rdr_close(qn_io_reader_itf restrict itf)
@@ -94,6 +98,12 @@ static inline qn_io_reader_itf qn_io_rdr_section(qn_io_reader_itf restrict itf,
     return (*itf)->section(itf, offset, sec_size);
 }
 
+// ---- Hint that the given range will be read soon, so that it can be loaded while the caller is busy with other work. Readers that cannot load data ahead ignore the hint.
+static inline void qn_io_rdr_prefetch(qn_io_reader_itf restrict itf, qn_foffset offset, size_t size)
+{
+    if ((*itf)->prefetch) (*itf)->prefetch(itf, offset, size);
+}
+
 // ----
 
 struct _QN_IO_SECTION_READER;
@@ -107,6 +117,11 @@ QN_SDK extern qn_io_reader_itf qn_io_srdr_to_io_reader(qn_io_section_reader_ptr
 
 // ----
 
+enum
+{
+    QN_IO_WRT_WRITING_FAILED = -1
+};
+
 struct _QN_IO_WRITER;
 typedef struct _QN_IO_WRITER * qn_io_writer_ptr;
 typedef qn_io_writer_ptr * qn_io_writer_itf;
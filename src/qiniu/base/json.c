@@ -209,7 +209,14 @@ static qn_bool qn_json_obj_set_variant(qn_json_object_ptr restrict obj, const ch
         return qn_true;
     } // if
 
-    if ((obj->cap - obj->cnt) <= 0 && ! qn_json_obj_augment(obj)) return qn_false;
+    if ((obj->cap - obj->cnt) <= 0) {
+        if (! qn_json_obj_augment(obj)) return qn_false;
+
+        // ---- The storage has moved.
+        keys = qn_json_obj_key_offset(obj->data, obj->cap);
+        vars = qn_json_obj_variant_offset(obj->data, obj->cap);
+        attrs = qn_json_obj_attribute_offset(obj->data, obj->cap);
+    } // if
     if (! (new_key = qn_cs_duplicate(key))) return qn_false;
 
     if (pos < obj->cnt) {
@@ -662,8 +669,8 @@ QN_SDK void qn_json_arr_destroy(qn_json_array_ptr restrict arr)
     qn_json_attribute_ptr attrs = NULL;
 
     if (arr) {
-        vars = qn_json_arr_variant_offset(arr->data, arr->cnt);
-        attrs = qn_json_arr_attribute_offset(arr->data, arr->cnt);
+        vars = qn_json_arr_variant_offset(arr->data, arr->cap);
+        attrs = qn_json_arr_attribute_offset(arr->data, arr->cap);
 
         for (i = arr->begin; i < arr->end; i += 1) {
             qn_json_destroy_variant(attrs[i].type, &vars[i]);
@@ -1,8 +1,19 @@
 #include <stdarg.h>
 #include <strings.h>
 #include <ctype.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
 #include <curl/curl.h>
 
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+#include <pthread.h>
+#endif
+
 #include "qiniu/base/string.h"
 #include "qiniu/base/json.h"
 #include "qiniu/base/json_parser.h"
@@ -10,6 +21,7 @@
 #include "qiniu/http_header.h"
 #include "qiniu/http_header_parser.h"
 #include "qiniu/http.h"
+#include "qiniu/os/time.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -138,10 +150,37 @@ QN_SDK size_t qn_http_json_wrt_write_cfn(void * user_data, char * restrict buf,
 
 // ---- Definition of HTTP form
 
+static size_t qn_http_conn_body_reader(char * ptr, size_t size, size_t nmemb, void * user_data);
+
+typedef enum _QN_HTTP_FORM_PART_KIND
+{
+    QN_HTTP_FORM_PART_BUFFER = 0,
+    QN_HTTP_FORM_PART_FILE = 1,
+    QN_HTTP_FORM_PART_FILE_READER = 2,
+    QN_HTTP_FORM_PART_READER = 3
+} qn_http_form_part_kind_em;
+
+// ---- A part is recorded besides the mime structure, since cURL has no way to rewind a mime structure sent by a reset handle.
+typedef struct _QN_HTTP_FORM_PART
+{
+    qn_http_form_part_kind_em kind;
+    qn_string field;
+    qn_string fname;
+    qn_string fname_utf8;
+    qn_string mime_type;
+    qn_string val;      // The copy of the value of a text field.
+    const char * buf;
+    qn_fsize size;
+    void * src;
+} qn_http_form_part;
+
 typedef struct _QN_HTTP_FORM
 {
-    struct curl_httppost * first;
-    struct curl_httppost * last;
+    curl_mime * mime;
+    qn_http_form_part * parts;
+    int cnt;
+    int cap;
+    qn_bool sent;
 } qn_http_form;
 
 QN_SDK qn_http_form_ptr qn_http_form_create(void)
@@ -158,30 +197,221 @@ QN_SDK void qn_http_form_destroy(qn_http_form_ptr restrict form)
 {
     if (form) {
         qn_http_form_reset(form);
+        free(form->parts);
         free(form);
     } // form
 }
 
+static void qn_http_form_part_clean(qn_http_form_part * restrict pt)
+{
+    qn_str_destroy(pt->field);
+    qn_str_destroy(pt->fname);
+    qn_str_destroy(pt->fname_utf8);
+    qn_str_destroy(pt->mime_type);
+    qn_str_destroy(pt->val);
+}
+
 QN_SDK void qn_http_form_reset(qn_http_form_ptr restrict form)
 {
-    curl_formfree(form->first);
-    form->first = NULL;
-    form->last = NULL;
+    int i;
+
+    for (i = 0; i < form->cnt; i += 1) qn_http_form_part_clean(&form->parts[i]);
+    form->cnt = 0;
+    form->sent = qn_false;
+
+    curl_mime_free(form->mime);
+    form->mime = NULL;
 }
 
-QN_SDK qn_bool qn_http_form_add_raw(qn_http_form_ptr restrict form, const char * restrict fld, qn_size fld_size, const char * restrict val, qn_size val_size)
+typedef struct _QN_HTTP_FORM_BUFFER
 {
-    CURLFORMcode ret;
+    const char * buf;
+    curl_off_t size;
+    curl_off_t pos;
+} qn_http_form_buffer, *qn_http_form_buffer_ptr;
 
-    if (sizeof(curl_off_t) == 4 && sizeof(curl_off_t) < sizeof(qn_size)) {
-        if (UINT32_MAX < fld_size || UINT32_MAX < val_size) {
-            qn_err_set_overflow_upper_bound();
+static size_t qn_http_form_buf_read_cfn(char * ptr, size_t size, size_t nmemb, void * user_data)
+{
+    qn_http_form_buffer_ptr fb = (qn_http_form_buffer_ptr) user_data;
+    size_t cpy_size = size * nmemb;
+
+    if (fb->size - fb->pos < cpy_size) cpy_size = fb->size - fb->pos;
+    memcpy(ptr, fb->buf + fb->pos, cpy_size);
+    fb->pos += cpy_size;
+    return cpy_size;
+}
+
+static int qn_http_form_buf_seek_cfn(void * user_data, curl_off_t offset, int origin)
+{
+    qn_http_form_buffer_ptr fb = (qn_http_form_buffer_ptr) user_data;
+
+    switch (origin) {
+        case SEEK_CUR: offset += fb->pos; break;
+        case SEEK_END: offset += fb->size; break;
+        default: break;
+    } // switch
+    if (offset < 0 || fb->size < offset) return CURL_SEEKFUNC_FAIL;
+    fb->pos = offset;
+    return CURL_SEEKFUNC_OK;
+}
+
+static size_t qn_http_form_rdr_read_cfn(char * ptr, size_t size, size_t nmemb, void * user_data)
+{
+    ssize_t ret = qn_io_rdr_read((qn_io_reader_itf) user_data, ptr, size * nmemb);
+    if (ret < 0) return CURL_READFUNC_ABORT;
+    return ret;
+}
+
+static int qn_http_form_rdr_seek_cfn(void * user_data, curl_off_t offset, int origin)
+{
+    // ---- cURL rewinds a part with SEEK_SET only, and the reader seeks to absolute offsets only.
+    if (origin != SEEK_SET) return CURL_SEEKFUNC_CANTSEEK;
+    return qn_io_rdr_seek((qn_io_reader_itf) user_data, offset) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+static CURLcode qn_http_form_set_buffer_data(curl_mimepart * restrict part, const char * restrict buf, qn_fsize buf_size)
+{
+    CURLcode curl_code;
+    qn_http_form_buffer_ptr fb;
+
+    // ---- Let cURL read from the buffer in place rather than copy it with curl_mime_data().
+    if (!(fb = malloc(sizeof(qn_http_form_buffer)))) return CURLE_OUT_OF_MEMORY;
+    fb->buf = buf;
+    fb->size = buf_size;
+    fb->pos = 0;
+
+    if ((curl_code = curl_mime_data_cb(part, fb->size, qn_http_form_buf_read_cfn, qn_http_form_buf_seek_cfn, free, fb)) != CURLE_OK) free(fb);
+    return curl_code;
+}
+
+static qn_bool qn_http_form_build_part(qn_http_form_ptr restrict form, qn_http_form_part * restrict pt)
+{
+    curl_mimepart * part;
+    CURLcode curl_code;
+
+    // ---- The mime structure is bound to no easy handle, since a handle is checked out only when the request is sent.
+    if (!form->mime && !(form->mime = curl_mime_init(NULL))) {
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+
+    if (!(part = curl_mime_addpart(form->mime))) {
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+
+    if ((curl_code = curl_mime_name(part, pt->field)) != CURLE_OK) goto QN_HTTP_FORM_BUILD_PART_ERROR;
+
+    switch (pt->kind) {
+        case QN_HTTP_FORM_PART_BUFFER:
+            curl_code = qn_http_form_set_buffer_data(part, pt->buf, pt->size);
+            break;
+
+        case QN_HTTP_FORM_PART_FILE:
+            curl_code = curl_mime_filedata(part, pt->fname);
+            break;
+
+        case QN_HTTP_FORM_PART_FILE_READER:
+            // ---- The part pulls data through the body reader of the request when the request is sent.
+            curl_code = curl_mime_data_cb(part, (curl_off_t)pt->size, qn_http_conn_body_reader, NULL, NULL, pt->src);
+            break;
+
+        case QN_HTTP_FORM_PART_READER:
+            curl_code = curl_mime_data_cb(part, (curl_off_t)pt->size, qn_http_form_rdr_read_cfn, qn_http_form_rdr_seek_cfn, NULL, pt->src);
+            break;
+    } // switch
+    if (curl_code != CURLE_OK) goto QN_HTTP_FORM_BUILD_PART_ERROR;
+
+    if (pt->fname_utf8 && (curl_code = curl_mime_filename(part, pt->fname_utf8)) != CURLE_OK) goto QN_HTTP_FORM_BUILD_PART_ERROR;
+    if (pt->mime_type && (curl_code = curl_mime_type(part, pt->mime_type)) != CURLE_OK) goto QN_HTTP_FORM_BUILD_PART_ERROR;
+    return qn_true;
+
+QN_HTTP_FORM_BUILD_PART_ERROR:
+    if (curl_code == CURLE_OUT_OF_MEMORY) {
+        qn_err_set_out_of_memory();
+    } else {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+    } // if
+    return qn_false;
+}
+
+static qn_bool qn_http_form_add_part(qn_http_form_ptr restrict form, qn_http_form_part * restrict pt)
+{
+    qn_http_form_part * new_parts;
+    int new_cap;
+
+    if (form->cnt == form->cap) {
+        new_cap = (form->cap > 0) ? form->cap * 2 : 4;
+        if (!(new_parts = realloc(form->parts, sizeof(qn_http_form_part) * new_cap))) {
+            qn_err_set_out_of_memory();
             return qn_false;
         } // if
+        form->parts = new_parts;
+        form->cap = new_cap;
+    } // if
+
+    if (!qn_http_form_build_part(form, pt)) return qn_false;
+    form->parts[form->cnt++] = *pt;
+    return qn_true;
+}
+
+static inline qn_bool qn_http_form_copy_cstr(qn_string * restrict dst, const char * restrict src)
+{
+    return !src || (*dst = qn_cs_duplicate(src));
+}
+
+// ---- Rebuild the mime structure if the form has been sent, so that it can be sent again, e.g. when retrying.
+static qn_bool qn_http_form_prepare_for_sending(qn_http_form_ptr restrict form)
+{
+    int i;
+
+    if (form->sent) {
+        for (i = 0; i < form->cnt; i += 1) {
+            switch (form->parts[i].kind) {
+                case QN_HTTP_FORM_PART_FILE_READER:
+                    // ---- The body reader callback of the request cannot be rewound.
+                    qn_err_http_set_resending_form_failed();
+                    return qn_false;
+
+                case QN_HTTP_FORM_PART_READER:
+                    if (!qn_io_rdr_seek((qn_io_reader_itf) form->parts[i].src, 0)) return qn_false;
+                    break;
+
+                default:
+                    break;
+            } // switch
+        } // for
+
+        curl_mime_free(form->mime);
+        form->mime = NULL;
+        for (i = 0; i < form->cnt; i += 1) {
+            if (!qn_http_form_build_part(form, &form->parts[i])) return qn_false;
+        } // for
     } // if
-    
-    ret = curl_formadd(&form->first, &form->last, CURLFORM_COPYNAME, fld, CURLFORM_NAMELENGTH, fld_size, CURLFORM_COPYCONTENTS, val, CURLFORM_CONTENTLEN, (curl_off_t)val_size, CURLFORM_END);
-    if (ret != 0) {
+    form->sent = qn_true;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Form
+*
+* Add a text field to the form. Both the field name and the value are copied.
+*
+* @param [in] form The pointer to the form.
+* @param [in] fld The field name.
+* @param [in] fld_size The size of the field name.
+* @param [in] val The field value.
+* @param [in] val_size The size of the field value.
+* @retval qn_true The field is added.
+* @retval qn_false Failed in adding the field, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_form_add_raw(qn_http_form_ptr restrict form, const char * restrict fld, qn_size fld_size, const char * restrict val, qn_size val_size)
+{
+    qn_http_form_part pt = {QN_HTTP_FORM_PART_BUFFER};
+
+    pt.size = val_size;
+    if (!(pt.field = qn_cs_clone(fld, fld_size)) || !(pt.val = qn_cs_clone(val, val_size)) || !(pt.buf = qn_str_cstr(pt.val)) || !qn_http_form_add_part(form, &pt)) {
+        qn_http_form_part_clean(&pt);
         qn_err_http_set_adding_string_field_failed();
         return qn_false;
     } // if
@@ -201,15 +431,16 @@ static inline const char * qn_http_get_fname_utf8(const char * restrict fname)
 
 QN_SDK qn_bool qn_http_form_add_file(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict fname_utf8, qn_fsize fsize, const char * restrict mime_type)
 {
-    CURLFORMcode ret;
+    qn_http_form_part pt = {QN_HTTP_FORM_PART_FILE};
 
     /// BUG NOTE 1 : Golang HTTP server will fail in case that the fsize is larger than 10MB and the `filename` attribute of the multipart-data section doesn't exist.
     /// BUG FIX    : Use a mandatory filename value to prevent Golang HTTP server from failing.
     if (!fname_utf8) fname_utf8 = qn_http_get_fname_utf8(fname);
     if (! mime_type) mime_type = "application/octet-stream";
 
-    ret = curl_formadd(&form->first, &form->last, CURLFORM_COPYNAME, field, CURLFORM_FILE, fname, CURLFORM_FILENAME, fname_utf8, CURLFORM_CONTENTTYPE, mime_type, CURLFORM_END);
-    if (ret != 0) {
+    pt.size = fsize;
+    if (!qn_http_form_copy_cstr(&pt.field, field) || !qn_http_form_copy_cstr(&pt.fname, fname) || !qn_http_form_copy_cstr(&pt.fname_utf8, fname_utf8) || !qn_http_form_copy_cstr(&pt.mime_type, mime_type) || !qn_http_form_add_part(form, &pt)) {
+        qn_http_form_part_clean(&pt);
         qn_err_http_set_adding_file_field_failed();
         return qn_false;
     } // if
@@ -218,35 +449,67 @@ QN_SDK qn_bool qn_http_form_add_file(qn_http_form_ptr restrict form, const char
 
 QN_SDK qn_bool qn_http_form_add_file_reader(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict fname_utf8, qn_fsize fsize, const char * restrict mime_type, void * restrict req)
 {
-    CURLFORMcode ret;
+    qn_http_form_part pt = {QN_HTTP_FORM_PART_FILE_READER};
 
     /// See BUG NOTE 1.
     if (!fname_utf8) fname_utf8 = qn_http_get_fname_utf8(fname);
     if (! mime_type) mime_type = "application/octet-stream";
 
-    ret = curl_formadd(&form->first, &form->last, CURLFORM_COPYNAME, field, CURLFORM_STREAM, req, CURLFORM_CONTENTSLENGTH, (long)fsize, CURLFORM_FILENAME, fname_utf8, CURLFORM_CONTENTTYPE, mime_type, CURLFORM_END);
-    if (ret != 0) {
+    pt.size = fsize;
+    pt.src = req;
+    if (!qn_http_form_copy_cstr(&pt.field, field) || !qn_http_form_copy_cstr(&pt.fname_utf8, fname_utf8) || !qn_http_form_copy_cstr(&pt.mime_type, mime_type) || !qn_http_form_add_part(form, &pt)) {
+        qn_http_form_part_clean(&pt);
         qn_err_http_set_adding_file_field_failed();
         return qn_false;
     } // if
     return qn_true;
 }
 
-QN_SDK qn_bool qn_http_form_add_buffer(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict buf, qn_size buf_size, const char * restrict mime_type)
+/***************************************************************************//**
+* @ingroup HTTP-Form
+*
+* Add a file field whose content is streamed from an I/O reader when the
+* request is sent. The reader must stay open until the request is done, and
+* its size decides the length of the field.
+*
+* @param [in] form The pointer to the form.
+* @param [in] field The field name.
+* @param [in] fname_utf8 The file name in UTF-8 sent to the server, or NULL to
+*                        use the name of the reader.
+* @param [in] rdr The reader providing the file content.
+* @param [in] mime_type The MIME type of the content, or NULL for
+*                       application/octet-stream.
+* @retval qn_true The field is added.
+* @retval qn_false Failed in adding the field, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_form_add_reader(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname_utf8, qn_io_reader_itf restrict rdr, const char * restrict mime_type)
 {
-    CURLFORMcode ret;
+    qn_http_form_part pt = {QN_HTTP_FORM_PART_READER};
 
-    if (sizeof(long) < sizeof(qn_size)) {
-        if (UINT32_MAX < buf_size) {
-            qn_err_set_overflow_upper_bound();
-            return qn_false;
-        } // if
+    /// See BUG NOTE 1.
+    if (!fname_utf8) fname_utf8 = qn_http_get_fname_utf8(qn_str_cstr(qn_io_rdr_name(rdr)));
+    if (! mime_type) mime_type = "application/octet-stream";
+
+    pt.size = qn_io_rdr_size(rdr);
+    pt.src = rdr;
+    if (!qn_http_form_copy_cstr(&pt.field, field) || !qn_http_form_copy_cstr(&pt.fname_utf8, fname_utf8) || !qn_http_form_copy_cstr(&pt.mime_type, mime_type) || !qn_http_form_add_part(form, &pt)) {
+        qn_http_form_part_clean(&pt);
+        qn_err_http_set_adding_file_field_failed();
+        return qn_false;
     } // if
+    return qn_true;
+}
+
+QN_SDK qn_bool qn_http_form_add_buffer(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict buf, qn_size buf_size, const char * restrict mime_type)
+{
+    qn_http_form_part pt = {QN_HTTP_FORM_PART_BUFFER};
 
     if (! mime_type) mime_type = "application/octet-stream";
-    
-    ret = curl_formadd(&form->first, &form->last, CURLFORM_COPYNAME, field, CURLFORM_BUFFER, fname, CURLFORM_BUFFERPTR, buf, CURLFORM_BUFFERLENGTH, buf_size, CURLFORM_CONTENTTYPE, mime_type, CURLFORM_END);
-    if (ret != 0) {
+
+    pt.buf = buf;
+    pt.size = buf_size;
+    if (!qn_http_form_copy_cstr(&pt.field, field) || !qn_http_form_copy_cstr(&pt.fname_utf8, fname) || !qn_http_form_copy_cstr(&pt.mime_type, mime_type) || !qn_http_form_add_part(form, &pt)) {
+        qn_http_form_part_clean(&pt);
         qn_err_http_set_adding_buffer_field_failed();
         return qn_false;
     } // if
@@ -264,6 +527,7 @@ typedef struct _QN_HTTP_REQUEST
 {
     int flags;
     qn_http_header_ptr hdr;
+    qn_http_req_template_ptr tmpl;
     qn_http_form_ptr form;
 
     const char * body_data;
@@ -314,6 +578,7 @@ QN_SDK void qn_http_req_reset(qn_http_request_ptr restrict req)
     req->body_rdr = NULL;
     req->body_rdr_cb = NULL;
     req->form = NULL;
+    req->tmpl = NULL;
 }
 
 // ----
@@ -394,6 +659,226 @@ QN_SDK qn_fsize qn_http_req_body_size(qn_http_request_ptr restrict req)
     return req->body_size;
 }
 
+// ---- Definition of HTTP request template ----
+
+typedef struct _QN_HTTP_REQ_TEMPLATE
+{
+    qn_http_header_ptr hdr;
+
+    // ---- Compiled from the headers, shared by all requests using the template and never changed by them.
+    struct curl_slist * headers;
+} qn_http_req_template;
+
+QN_SDK qn_http_req_template_ptr qn_http_req_tmpl_create(void)
+{
+    qn_http_req_template_ptr new_tmpl = NULL;
+
+    new_tmpl = calloc(1, sizeof(qn_http_req_template));
+    if (!new_tmpl) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_tmpl->hdr = qn_http_hdr_create();
+    if (!new_tmpl->hdr) {
+        free(new_tmpl);
+        return NULL;
+    } // if
+    return new_tmpl;
+}
+
+QN_SDK void qn_http_req_tmpl_destroy(qn_http_req_template_ptr restrict tmpl)
+{
+    if (tmpl) {
+        curl_slist_free_all(tmpl->headers);
+        qn_http_hdr_destroy(tmpl->hdr);
+        free(tmpl);
+    } // if
+}
+
+static qn_bool qn_http_req_tmpl_compile(qn_http_req_template_ptr restrict tmpl)
+{
+    struct curl_slist * headers = NULL;
+    struct curl_slist * headers2 = NULL;
+    qn_string entry = NULL;
+    qn_http_hdr_iterator_ptr itr;
+
+    itr = qn_http_hdr_itr_create(tmpl->hdr);
+    if (!itr) return qn_false;
+
+    while ((entry = qn_http_hdr_itr_next_entry(itr))) {
+        headers2 = curl_slist_append(headers, entry);
+        if (!headers2) {
+            curl_slist_free_all(headers);
+            qn_http_hdr_itr_destroy(itr);
+            qn_err_set_out_of_memory();
+            return qn_false;
+        } // if
+        headers = headers2;
+    } // while
+    qn_http_hdr_itr_destroy(itr);
+
+    curl_slist_free_all(tmpl->headers);
+    tmpl->headers = headers;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Request-Template
+*
+* Set a fixed header in the template and compile the template again. Call it
+* only while setting up, before any request uses the template.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_req_tmpl_set_header(qn_http_req_template_ptr restrict tmpl, const char * restrict hdr, const char * restrict val)
+{
+    if (!qn_http_hdr_set_string(tmpl->hdr, hdr, val)) return qn_false;
+    return qn_http_req_tmpl_compile(tmpl);
+}
+
+QN_SDK void qn_http_req_set_template(qn_http_request_ptr restrict req, qn_http_req_template_ptr restrict tmpl)
+{
+    req->tmpl = tmpl;
+}
+
+// ---- Definition of HTTP response header arena ----
+
+enum
+{
+    QN_HTTP_HDR_ARENA_INIT_SIZE = 2048,
+    QN_HTTP_HDR_ARENA_INIT_ENTRIES = 32
+};
+
+typedef struct _QN_HTTP_HDR_ARENA_ENTRY
+{
+    qn_uint32 offset;   // Where the `Key: Value\0` text begins.
+    qn_uint32 key_size;
+    qn_uint32 val_size;
+} qn_http_hdr_arena_entry;
+
+// ---- All response headers live in one bump buffer which is kept across resets, so
+//      that a response costs no allocation once the buffer is large enough.
+typedef struct _QN_HTTP_HDR_ARENA
+{
+    char * buf;
+    qn_uint32 used;
+    qn_uint32 cap;
+
+    qn_http_hdr_arena_entry * ents;
+    int cnt;
+    int cap_ents;
+} qn_http_hdr_arena;
+
+static inline void qn_http_hdr_arena_reset(qn_http_hdr_arena * restrict arena)
+{
+    arena->used = 0;
+    arena->cnt = 0;
+}
+
+static void qn_http_hdr_arena_release(qn_http_hdr_arena * restrict arena)
+{
+    free(arena->buf);
+    free(arena->ents);
+    memset(arena, 0, sizeof(qn_http_hdr_arena));
+}
+
+static qn_bool qn_http_hdr_arena_alloc(qn_http_hdr_arena * restrict arena, qn_size size, qn_uint32 * restrict offset)
+{
+    qn_uint32 new_cap;
+    char * new_buf;
+
+    if (arena->cap - arena->used < size) {
+        if (UINT32_MAX / 2 < arena->used + size) {
+            qn_err_set_overflow_upper_bound();
+            return qn_false;
+        } // if
+
+        new_cap = (arena->cap > 0) ? arena->cap : QN_HTTP_HDR_ARENA_INIT_SIZE;
+        while (new_cap - arena->used < size) new_cap *= 2;
+
+        new_buf = realloc(arena->buf, new_cap);
+        if (!new_buf) {
+            qn_err_set_out_of_memory();
+            return qn_false;
+        } // if
+        arena->buf = new_buf;
+        arena->cap = new_cap;
+    } // if
+
+    *offset = arena->used;
+    arena->used += size;
+    return qn_true;
+}
+
+static inline const char * qn_http_hdr_arena_text(qn_http_hdr_arena * restrict arena, qn_uint32 offset)
+{
+    return arena->buf + offset;
+}
+
+static qn_bool qn_http_hdr_arena_copy(qn_http_hdr_arena * restrict arena, const char * restrict txt, qn_size txt_size, qn_uint32 * restrict offset)
+{
+    if (!qn_http_hdr_arena_alloc(arena, txt_size + 1, offset)) return qn_false;
+    memcpy(arena->buf + *offset, txt, txt_size);
+    arena->buf[*offset + txt_size] = '\0';
+    return qn_true;
+}
+
+static qn_bool qn_http_hdr_arena_add(qn_http_hdr_arena * restrict arena, const char * restrict key, qn_size key_size, const char * restrict val, qn_size val_size)
+{
+    qn_http_hdr_arena_entry * new_ents;
+    qn_http_hdr_arena_entry * ent;
+    qn_uint32 offset;
+    int new_cap;
+    char * pos;
+
+    if (arena->cnt == arena->cap_ents) {
+        new_cap = (arena->cap_ents > 0) ? arena->cap_ents * 2 : QN_HTTP_HDR_ARENA_INIT_ENTRIES;
+        new_ents = realloc(arena->ents, sizeof(qn_http_hdr_arena_entry) * new_cap);
+        if (!new_ents) {
+            qn_err_set_out_of_memory();
+            return qn_false;
+        } // if
+        arena->ents = new_ents;
+        arena->cap_ents = new_cap;
+    } // if
+
+    if (!qn_http_hdr_arena_alloc(arena, key_size + 2 + val_size + 1, &offset)) return qn_false;
+
+    pos = arena->buf + offset;
+    memcpy(pos, key, key_size);
+    pos[key_size] = ':';
+    pos[key_size + 1] = ' ';
+    memcpy(pos + key_size + 2, val, val_size);
+    pos[key_size + 2 + val_size] = '\0';
+
+    ent = &arena->ents[arena->cnt++];
+    ent->offset = offset;
+    ent->key_size = key_size;
+    ent->val_size = val_size;
+    return qn_true;
+}
+
+static int qn_http_hdr_arena_find(qn_http_hdr_arena * restrict arena, const char * restrict key, qn_size key_size)
+{
+    int i;
+
+    // ---- Search backward so that the last one wins, as the header table does.
+    for (i = arena->cnt - 1; i >= 0; i -= 1) {
+        if (arena->ents[i].key_size == key_size && strncasecmp(arena->buf + arena->ents[i].offset, key, key_size) == 0) return i;
+    } // for
+    return -1;
+}
+
+static void qn_http_hdr_arena_remove(qn_http_hdr_arena * restrict arena, const char * restrict key, qn_size key_size)
+{
+    int i;
+
+    // ---- The text is left in the buffer until the next reset.
+    while ((i = qn_http_hdr_arena_find(arena, key, key_size)) >= 0) {
+        arena->cnt -= 1;
+        memmove(&arena->ents[i], &arena->ents[i + 1], sizeof(qn_http_hdr_arena_entry) * (arena->cnt - i));
+    } // while
+}
+
 // ---- Definition of HTTP response ----
 
 enum
@@ -409,12 +894,21 @@ typedef struct _QN_HTTP_RESPONSE
     int body_wrt_code;
     void * body_wrt;
     qn_http_data_writer_callback_fn body_wrt_cb;
+    qn_io_writer_itf body_stm;
+    qn_fl_writer_ptr body_fl;       // Set if the stream writer is a file writer.
+    qn_bool body_reserved;
 
     int http_code;
-    qn_string http_ver;
-    qn_string http_msg;
+    qn_uint32 http_ver;     // Offsets into the arena.
+    qn_uint32 http_msg;
+
+    qn_http_hdr_arena arena;
 
+    // ---- Only filled on demand for header iterators.
+    qn_bool hdr_synced;
     qn_http_header_ptr hdr;
+
+    qn_http_timing_st timing;
 } qn_http_response;
 
 QN_SDK qn_http_response_ptr qn_http_resp_create(void)
@@ -439,8 +933,7 @@ QN_SDK qn_http_response_ptr qn_http_resp_create(void)
 QN_SDK void qn_http_resp_destroy(qn_http_response_ptr restrict resp)
 {
     if (resp) {
-        qn_str_destroy(resp->http_ver);
-        qn_str_destroy(resp->http_msg);
+        qn_http_hdr_arena_release(&resp->arena);
         qn_http_hdr_destroy(resp->hdr);
         free(resp);
     } // if
@@ -448,17 +941,22 @@ QN_SDK void qn_http_resp_destroy(qn_http_response_ptr restrict resp)
 
 QN_SDK void qn_http_resp_reset(qn_http_response_ptr restrict resp)
 {
-    qn_str_destroy(resp->http_ver);
-    resp->http_ver = NULL;
-    qn_str_destroy(resp->http_msg);
-    resp->http_msg = NULL;
+    qn_http_hdr_arena_reset(&resp->arena);
+    resp->http_ver = 0;
+    resp->http_msg = 0;
 
     resp->body_wrt_sts = QN_HTTP_RESP_WRT_PARSING_BODY;
     resp->http_code = 0;
     resp->body_wrt = NULL;
     resp->body_wrt_cb = NULL;
+    resp->body_stm = NULL;
+    resp->body_fl = NULL;
+    memset(&resp->timing, 0, sizeof(resp->timing));
 
-    qn_http_hdr_reset(resp->hdr);
+    if (resp->hdr_synced) {
+        qn_http_hdr_reset(resp->hdr);
+        resp->hdr_synced = qn_false;
+    } // if
 }
 
 QN_SDK int qn_http_resp_get_code(qn_http_response_ptr restrict resp)
@@ -471,24 +969,65 @@ QN_SDK int qn_http_resp_get_writer_retcode(qn_http_response_ptr restrict resp)
     return resp->body_wrt_code;
 }
 
+QN_SDK const qn_http_timing_st * qn_http_resp_get_timing(qn_http_response_ptr restrict resp)
+{
+    return &resp->timing;
+}
+
+static void qn_http_resp_capture_timing(qn_http_response_ptr restrict resp, CURL * restrict curl)
+{
+    curl_off_t val;
+
+    // ---- Phases that never happen (e.g. appconnect for plain HTTP) are left as 0.
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &val) == CURLE_OK) resp->timing.namelookup = val;
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &val) == CURLE_OK) resp->timing.connect = val;
+    if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &val) == CURLE_OK) resp->timing.appconnect = val;
+    if (curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &val) == CURLE_OK) resp->timing.pretransfer = val;
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &val) == CURLE_OK) resp->timing.starttransfer = val;
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &val) == CURLE_OK) resp->timing.total = val;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &val) == CURLE_OK) resp->timing.bytes_up = val;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &val) == CURLE_OK) resp->timing.bytes_down = val;
+}
+
 QN_SDK qn_http_hdr_iterator_ptr qn_http_resp_get_header_iterator(qn_http_response_ptr restrict resp)
 {
+    qn_http_hdr_arena_entry * ent;
+    const char * txt;
+    int i;
+
+    if (!resp->hdr_synced) {
+        // ---- Build the header table from the arena only when someone needs to iterate over headers.
+        qn_http_hdr_reset(resp->hdr);
+        for (i = 0; i < resp->arena.cnt; i += 1) {
+            ent = &resp->arena.ents[i];
+            txt = qn_http_hdr_arena_text(&resp->arena, ent->offset);
+            if (!qn_http_hdr_set_raw(resp->hdr, txt, ent->key_size, txt + ent->key_size + 2, ent->val_size)) return NULL;
+        } // for
+        resp->hdr_synced = qn_true;
+    } // if
     return qn_http_hdr_itr_create(resp->hdr);
 }
 
 QN_SDK const char * qn_http_resp_get_header(qn_http_response_ptr restrict resp, const char * restrict hdr)
 {
-    return qn_http_hdr_get_value(resp->hdr, hdr);
+    int i = qn_http_hdr_arena_find(&resp->arena, hdr, posix_strlen(hdr));
+    if (i < 0) return NULL;
+    return qn_http_hdr_arena_text(&resp->arena, resp->arena.ents[i].offset) + resp->arena.ents[i].key_size + 2;
 }
 
 QN_SDK qn_bool qn_http_resp_set_header(qn_http_response_ptr restrict resp, const char * restrict hdr, const char * restrict val, qn_size val_size)
 {
-    return qn_http_hdr_set_text(resp->hdr, hdr, val, val_size);
+    qn_size hdr_size = posix_strlen(hdr);
+
+    qn_http_hdr_arena_remove(&resp->arena, hdr, hdr_size);
+    resp->hdr_synced = qn_false;
+    return qn_http_hdr_arena_add(&resp->arena, hdr, hdr_size, val, val_size);
 }
 
 QN_SDK void qn_http_resp_unset_header(qn_http_response_ptr restrict resp, const char * restrict hdr)
 {
-    qn_http_hdr_unset(resp->hdr, hdr);
+    qn_http_hdr_arena_remove(&resp->arena, hdr, posix_strlen(hdr));
+    resp->hdr_synced = qn_false;
 }
 
 QN_SDK void qn_http_resp_set_data_writer(qn_http_response_ptr restrict resp, void * restrict body_wrt, qn_http_data_writer_callback_fn body_wrt_cb)
@@ -497,6 +1036,61 @@ QN_SDK void qn_http_resp_set_data_writer(qn_http_response_ptr restrict resp, voi
     resp->body_wrt_cb = body_wrt_cb;
 }
 
+/***************************************************************************//**
+* @ingroup HTTP-Response
+*
+* Stream the body of a successful (2xx) response into an I/O writer as is.
+* Bodies of other responses still go to the data writer, which usually parses
+* the error message in JSON.
+*
+* @param [in] resp The pointer to the response.
+* @param [in] body_stm The writer receiving the body, or NULL to stop streaming.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_resp_set_stream_writer(qn_http_response_ptr restrict resp, qn_io_writer_itf restrict body_stm)
+{
+    resp->body_stm = body_stm;
+    resp->body_fl = NULL;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Response
+*
+* Stream the body of a successful (2xx) response into a file writer, like
+* qn_http_resp_set_stream_writer() does. Before the first byte is written, the
+* space of the `Content-Length` bytes from the offset of the writer is
+* allocated up front.
+*
+* @param [in] resp The pointer to the response.
+* @param [in] fl_wrt The file writer receiving the body, or NULL to stop
+*                    streaming. Call qn_fl_wrt_flush() after the request if it
+*                    works in direct I/O mode.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_resp_set_file_writer(qn_http_response_ptr restrict resp, qn_fl_writer_ptr restrict fl_wrt)
+{
+    resp->body_stm = (fl_wrt) ? qn_fl_wrt_to_io_writer(fl_wrt) : NULL;
+    resp->body_fl = fl_wrt;
+    resp->body_reserved = qn_false;
+}
+
+static qn_bool qn_http_resp_reserve_file_space(qn_http_response_ptr restrict resp)
+{
+    const char * val;
+    char * end;
+    unsigned long long body_size;
+
+    resp->body_reserved = qn_true;
+
+    // ---- Bodies without the header, e.g. chunked ones, just grow the file.
+    val = qn_http_resp_get_header(resp, "Content-Length");
+    if (!val) return qn_true;
+
+    body_size = strtoull(val, &end, 10);
+    if (end == val || body_size == 0) return qn_true;
+    return qn_fl_wrt_reserve(resp->body_fl, qn_fl_wrt_offset(resp->body_fl) + (qn_fsize)body_size);
+}
+
 static size_t qn_http_resp_hdr_wrt_write_cfn(char * buf, size_t size, size_t nitems, void * user_data)
 {
     qn_http_response_ptr resp = (qn_http_response_ptr) user_data;
@@ -512,40 +1106,42 @@ static size_t qn_http_resp_hdr_wrt_write_cfn(char * buf, size_t size, size_t nit
         begin = strchr(buf, '/');
 
         // ---- http version
-        if (!begin) return 0;
+        if (!begin) goto QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX;
         begin += 1;
         end = strchr(begin, ' ');
-        if (!end) return 0;
+        if (!end) goto QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX;
 
-        resp->http_ver = qn_cs_clone(begin, end - begin);
-        if (!resp->http_ver) return 0;
+        if (!qn_http_hdr_arena_copy(&resp->arena, begin, end - begin, &resp->http_ver)) return 0;
 
         // ---- http code
         begin = end + 1;
         end = strchr(begin, ' ');
-        if (!end) return 0;
+        if (!end) goto QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX;
 
         for (i = 0; i < end - begin; i += 1) {
-            if (!isdigit(begin[i])) return 0;
+            if (!isdigit(begin[i])) goto QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX;
             resp->http_code = resp->http_code * 10 + (begin[i] - '0');
         } // for
 
         // ---- http message
         begin = end + 1;
         end = buf + buf_size;
-        if (end[-1] != '\n') return 0;
+        if (end[-1] != '\n') goto QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX;
         end -= (end[-2] == '\r') ? 2 : 1;
 
-        resp->http_msg = qn_cs_clone(begin, end - begin);
-        if (!resp->http_msg) return 0;
+        if (!qn_http_hdr_arena_copy(&resp->arena, begin, end - begin, &resp->http_msg)) return 0;
     } else {
         // Parse response headers.
         begin = buf;
         end = strchr(begin, ':');
 
         if (!end) {
-            if ((begin[0] == '\r' && begin[1] == '\n') || begin[0] == '\n') return buf_size;
-            return 0;
+            if ((begin[0] == '\r' && begin[1] == '\n') || begin[0] == '\n') {
+                // ---- An interim response like `100 Continue` ends here, and the final status line follows.
+                if (resp->http_code < 200) resp->http_code = 0;
+                return buf_size;
+            } // if
+            goto QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX;
         } // if
 
         while (isspace(begin[0])) begin += 1;
@@ -557,9 +1153,15 @@ static size_t qn_http_resp_hdr_wrt_write_cfn(char * buf, size_t size, size_t nit
         while (isspace(val_begin[0])) val_begin += 1;
         while (isspace(val_end[-1])) val_end -= 1;
 
-        if (!qn_http_hdr_set_raw(resp->hdr, begin, end - begin, val_begin, val_end - val_begin)) return 0;
+        if (!qn_http_hdr_arena_add(&resp->arena, begin, end - begin, val_begin, val_end - val_begin)) return 0;
+        resp->hdr_synced = qn_false;
     } // if
     return buf_size;
+
+QN_HTTP_RESP_HDR_WRT_INVALID_SYNTAX:
+    // ---- cURL reports any short write as CURLE_WRITE_ERROR, so the cause is set here. The arena sets its own.
+    qn_err_http_set_invalid_header_syntax();
+    return 0;
 }
 
 static size_t qn_http_resp_body_wrt_write_cfn(char * buf, size_t size, size_t nitems, void * user_data)
@@ -567,6 +1169,14 @@ static size_t qn_http_resp_body_wrt_write_cfn(char * buf, size_t size, size_t ni
     qn_http_response_ptr resp = (qn_http_response_ptr) user_data;
     size_t buf_size = size * nitems;
 
+    if (resp->body_stm && 200 <= resp->http_code && resp->http_code < 300) {
+        // ---- Returning less than the given size makes cURL abort the transfer.
+        if (resp->body_fl && !resp->body_reserved && !qn_http_resp_reserve_file_space(resp)) return 0;
+        if (qn_io_wrt_write(resp->body_stm, buf, buf_size) != (ssize_t)buf_size) return 0;
+        return buf_size;
+    } // if
+    if (!resp->body_wrt_cb) return buf_size;
+
     // **NOTE**: If the writing is done, or encounter an error, always return the buf_size for consuming all data received.
     switch (resp->body_wrt_sts) {
         case QN_HTTP_RESP_WRT_PARSING_BODY:
@@ -586,200 +1196,2796 @@ static size_t qn_http_resp_body_wrt_write_cfn(char * buf, size_t size, size_t ni
     return 0;
 }
 
-// ---- Definition of HTTP connection ----
+// ---- Definition of HTTP DNS cache ----
 
-typedef struct _QN_HTTP_CONNECTION
+enum
 {
-    int port;
-    qn_string ip;
-    qn_string host;
-    qn_string url_prefix;
+    QN_HTTP_DNS_INIT_ENTRIES = 16,
+    QN_HTTP_DNS_MAX_ENTRIES = 1024,
+    QN_HTTP_DNS_MAX_ADDRESSES = 8,
+    QN_HTTP_DNS_MAX_HOST_SIZE = 256
+};
 
-    CURL * curl;
-} qn_http_connection;
+enum
+{
+    // ---- The head start the preferred address family gets before cURL races the other one.
+    QN_HTTP_HAPPY_EYEBALLS_TIMEOUT_MS = 100
+};
 
-QN_SDK qn_http_connection_ptr qn_http_conn_create(void)
+typedef struct _QN_HTTP_DNS_ENTRY
 {
-    qn_http_connection_ptr new_conn = NULL;
+    qn_string host;
+    int port;
+    qn_string addrs;    // Comma separated addresses, in the form of CURLOPT_RESOLVE, or NULL if not resolved yet.
+    int family;         // The address family which won the last connection race, or AF_UNSPEC.
+    int ttl;
+    qn_time expire_time;
+    qn_time refresh_time;
+    qn_time use_time;   // The last time a request went to the host.
+} qn_http_dns_entry;
+
+typedef struct _QN_HTTP_DNS_CACHE
+{
+    int cnt;
+    int cap;
+    qn_http_dns_entry * entries;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t refresher;
+    qn_bool refresher_running;
+    qn_bool stopping;
+#endif
+} qn_http_dns_cache;
 
-    new_conn = calloc(1, sizeof(qn_http_connection));
-    if (!new_conn) {
-        qn_err_set_out_of_memory();
-        return NULL;
-    } // if
-    new_conn->curl = curl_easy_init();
-    if (!new_conn->curl) {
-        free(new_conn);
-        qn_err_3rdp_set_curl_easy_error_occurred(CURLE_FAILED_INIT);
-        return NULL;
-    }
-    curl_easy_setopt(new_conn->curl, CURLOPT_NOSIGNAL, 1L);
-    return new_conn;
-}
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+static qn_http_dns_cache qn_http_dns_inst = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
 
-QN_SDK void qn_http_conn_destroy(qn_http_connection_ptr restrict conn)
+#define qn_http_dns_lock(cache) pthread_mutex_lock(&(cache)->lock)
+#define qn_http_dns_unlock(cache) pthread_mutex_unlock(&(cache)->lock)
+#else
+static qn_http_dns_cache qn_http_dns_inst;
+
+#define qn_http_dns_lock(cache)
+#define qn_http_dns_unlock(cache)
+#endif
+
+static qn_bool qn_http_dns_parse_url(const char * restrict url, char * restrict host, int * restrict port)
+{
+    const char * begin;
+    const char * end;
+    const char * colon;
+    struct in_addr addr;
+
+    begin = posix_strstr(url, "://");
+    if (!begin) return qn_false;
+    *port = (strncasecmp(url, "https", 5) == 0) ? 443 : 80;
+    begin += 3;
+
+    // ---- No need to cache IPv6 literals.
+    if (begin[0] == '[') return qn_false;
+
+    end = qn_str_find_char_or_null(begin, '/');
+    colon = memchr(begin, ':', end - begin);
+    if (colon) {
+        *port = atoi(colon + 1);
+        end = colon;
+    } // if
+    if (end == begin || end - begin >= QN_HTTP_DNS_MAX_HOST_SIZE) return qn_false;
+
+    memcpy(host, begin, end - begin);
+    host[end - begin] = '\0';
+
+    // ---- No need to cache IPv4 literals.
+    return inet_pton(AF_INET, host, &addr) != 1;
+}
+
+// ---- Compare whole entries of the list, since one address may be a substring of another, e.g. 10.0.0.1 and 110.0.0.12.
+static qn_bool qn_http_dns_has_address(const char * restrict list, int list_size, const char * restrict addr)
+{
+    const char * begin = list;
+    const char * end = list + list_size;
+    const char * sep;
+    size_t addr_size = strlen(addr);
+
+    while (begin < end) {
+        sep = memchr(begin, ',', end - begin);
+        if (!sep) sep = end;
+        if (sep - begin == addr_size && memcmp(begin, addr, addr_size) == 0) return qn_true;
+        begin = sep + 1;
+    } // while
+    return qn_false;
+}
+
+static qn_string qn_http_dns_lookup_addresses(const char * restrict host)
+{
+    struct addrinfo hints;
+    struct addrinfo * res = NULL;
+    struct addrinfo * ai;
+    char addr[INET6_ADDRSTRLEN + 2];
+    char addr6[INET6_ADDRSTRLEN];
+    char buf[QN_HTTP_DNS_MAX_ADDRESSES * (INET6_ADDRSTRLEN + 3)];
+    const void * src;
+    int pos = 0;
+    int cnt = 0;
+    int ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if ((ret = getaddrinfo(host, NULL, &hints, &res)) != 0) {
+        qn_err_comm_set_dns_failed();
+        return NULL;
+    } // if
+
+    for (ai = res; ai && cnt < QN_HTTP_DNS_MAX_ADDRESSES; ai = ai->ai_next) {
+        if (ai->ai_family == AF_INET) {
+            src = &((struct sockaddr_in *) ai->ai_addr)->sin_addr;
+            if (!inet_ntop(AF_INET, src, addr, sizeof(addr))) continue;
+        } else if (ai->ai_family == AF_INET6) {
+            // ---- IPv6 addresses must be enclosed in brackets.
+            src = &((struct sockaddr_in6 *) ai->ai_addr)->sin6_addr;
+            if (!inet_ntop(AF_INET6, src, addr6, sizeof(addr6))) continue;
+            qn_cs_snprintf(addr, sizeof(addr), "[%s]", addr6);
+        } else {
+            continue;
+        } // if
+
+        // ---- Skip duplicated addresses.
+        if (qn_http_dns_has_address(buf, pos, addr)) continue;
+        pos += qn_cs_snprintf(buf + pos, sizeof(buf) - pos, "%s%s", (pos > 0) ? "," : "", addr);
+        cnt += 1;
+    } // for
+    freeaddrinfo(res);
+
+    if (cnt == 0) {
+        qn_err_comm_set_dns_failed();
+        return NULL;
+    } // if
+    return qn_cs_clone(buf, pos);
+}
+
+static qn_http_dns_entry * qn_http_dns_find_entry(qn_http_dns_cache * restrict cache, const char * restrict host, int port)
+{
+    int i;
+    for (i = 0; i < cache->cnt; i += 1) {
+        if (cache->entries[i].port == port && posix_strcmp(cache->entries[i].host, host) == 0) return &cache->entries[i];
+    } // for
+    return NULL;
+}
+
+static void qn_http_dns_remove_entry(qn_http_dns_cache * restrict cache, qn_http_dns_entry * restrict ent)
+{
+    qn_str_destroy(ent->host);
+    qn_str_destroy(ent->addrs);
+    cache->cnt -= 1;
+    *ent = cache->entries[cache->cnt];
+}
+
+static qn_http_dns_entry * qn_http_dns_add_entry(qn_http_dns_cache * restrict cache, const char * restrict host, int port, int ttl)
+{
+    qn_http_dns_entry * new_entries;
+    qn_http_dns_entry * ent;
+    qn_string new_host;
+    int new_cap;
+    int i;
+
+    if (cache->cnt == cache->cap) {
+        if (cache->cap < QN_HTTP_DNS_MAX_ENTRIES) {
+            new_cap = (cache->cap > 0) ? cache->cap * 2 : QN_HTTP_DNS_INIT_ENTRIES;
+            if (!(new_entries = realloc(cache->entries, sizeof(qn_http_dns_entry) * new_cap))) {
+                qn_err_set_out_of_memory();
+                return NULL;
+            } // if
+            cache->entries = new_entries;
+            cache->cap = new_cap;
+        } else {
+            // ---- Evict the entry which has gone unused for the longest time.
+            ent = &cache->entries[0];
+            for (i = 1; i < cache->cnt; i += 1) {
+                if (cache->entries[i].use_time < ent->use_time) ent = &cache->entries[i];
+            } // for
+            qn_http_dns_remove_entry(cache, ent);
+        } // if
+    } // if
+    if (!(new_host = qn_cs_duplicate(host))) return NULL;
+
+    ent = &cache->entries[cache->cnt++];
+    ent->host = new_host;
+    ent->port = port;
+    ent->addrs = NULL;
+    ent->family = AF_UNSPEC;
+    ent->ttl = ttl;
+    ent->expire_time = 0;
+    ent->refresh_time = 0;
+    ent->use_time = qn_tm_time();
+    return ent;
+}
+
+static qn_bool qn_http_dns_update_entry(qn_http_dns_cache * restrict cache, const char * restrict host, int port, qn_string addrs, int ttl)
+{
+    qn_http_dns_entry * ent;
+
+    ent = qn_http_dns_find_entry(cache, host, port);
+    if (!ent && !(ent = qn_http_dns_add_entry(cache, host, port, ttl))) return qn_false;
+
+    qn_str_destroy(ent->addrs);
+    ent->addrs = addrs;
+    ent->ttl = ttl;
+    ent->expire_time = qn_tm_time() + ttl;
+    // ---- Refresh an entry when the last tenth of its TTL begins.
+    ent->refresh_time = ent->expire_time - ttl / 10;
+    return qn_true;
+}
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+enum
+{
+    QN_HTTP_DNS_RETRY_INTERVAL = 5
+};
+
+static void * qn_http_dns_refresh_routine(void * user_data)
+{
+    qn_http_dns_cache * cache = (qn_http_dns_cache *) user_data;
+    char host[QN_HTTP_DNS_MAX_HOST_SIZE];
+    struct timespec wake_time;
+    qn_http_dns_entry * ent;
+    qn_string addrs;
+    qn_time now;
+    qn_time next;
+    int port;
+    int ttl;
+    int i;
+
+    qn_http_dns_lock(cache);
+    while (!cache->stopping) {
+        now = qn_tm_time();
+        next = now + 3600;
+        ent = NULL;
+
+        for (i = 0; i < cache->cnt; i += 1) {
+            if (cache->entries[i].refresh_time <= now) {
+                ent = &cache->entries[i];
+                break;
+            } // if
+            if (cache->entries[i].refresh_time < next) next = cache->entries[i].refresh_time;
+        } // for
+
+        if (!ent) {
+            wake_time.tv_sec = next;
+            wake_time.tv_nsec = 0;
+            pthread_cond_timedwait(&cache->cond, &cache->lock, &wake_time);
+            continue;
+        } // if
+
+        // ---- Stop refreshing a host which no request has gone to for a whole TTL.
+        if (ent->addrs && ent->use_time + ent->ttl <= now) {
+            qn_http_dns_remove_entry(cache, ent);
+            continue;
+        } // if
+
+        // ---- Resolve without holding the lock, so that requests are not blocked.
+        memcpy(host, ent->host, qn_str_size(ent->host) + 1);
+        port = ent->port;
+        ttl = ent->ttl;
+        qn_http_dns_unlock(cache);
+
+        addrs = qn_http_dns_lookup_addresses(host);
+
+        qn_http_dns_lock(cache);
+        if (addrs) {
+            if (!qn_http_dns_update_entry(cache, host, port, addrs, ttl)) qn_str_destroy(addrs);
+        } else if ((ent = qn_http_dns_find_entry(cache, host, port))) {
+            if (ent->expire_time <= qn_tm_time()) {
+                // ---- Drop the expired entry and let cURL resolve the host itself.
+                qn_http_dns_remove_entry(cache, ent);
+            } else {
+                // ---- Keep the current answer and retry later.
+                ent->refresh_time = qn_tm_time() + QN_HTTP_DNS_RETRY_INTERVAL;
+            } // if
+        } // if
+    } // while
+    qn_http_dns_unlock(cache);
+    return NULL;
+}
+#endif
+
+static void qn_http_dns_wake_refresher(qn_http_dns_cache * restrict cache)
+{
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    if (!cache->refresher_running) {
+        cache->stopping = qn_false;
+        cache->refresher_running = (pthread_create(&cache->refresher, NULL, &qn_http_dns_refresh_routine, cache) == 0);
+    } else {
+        pthread_cond_signal(&cache->cond);
+    } // if
+#endif
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-DNS-Cache
+*
+* Resolve the host of the given URL and cache the answer for ttl seconds. The
+* cached addresses are handed to cURL for every later request to the same
+* host and port, so no DNS lookup happens on the request path. When built with
+* multithread support, a background thread refreshes entries before they
+* expire.
+*
+* @param [in] url The URL, or just the `scheme://host[:port]` part of it.
+* @param [in] ttl The time to live of the answer in seconds.
+*
+* @retval true The answer is cached, or the URL has a numeric host which needs
+*              no cache.
+* @retval false Failed in resolving the host, call qn_err_get_message() to get
+*               the reason.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_dns_resolve(const char * restrict url, int ttl)
+{
+    qn_http_dns_cache * cache = &qn_http_dns_inst;
+    char host[QN_HTTP_DNS_MAX_HOST_SIZE];
+    qn_string addrs;
+    qn_bool ret;
+    int port;
+
+    if (!qn_http_dns_parse_url(url, host, &port)) return qn_true;
+    if (ttl <= 0) return qn_true;
+
+    addrs = qn_http_dns_lookup_addresses(host);
+    if (!addrs) return qn_false;
+
+    qn_http_dns_lock(cache);
+    ret = qn_http_dns_update_entry(cache, host, port, addrs, ttl);
+    if (!ret) qn_str_destroy(addrs);
+    if (ret) qn_http_dns_wake_refresher(cache);
+    qn_http_dns_unlock(cache);
+    return ret;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-DNS-Cache
+*
+* Add the host of the given URL to the DNS cache without resolving it now.
+* When built with multithread support, the background thread resolves it
+* right away, so adding many hosts never blocks the caller. Otherwise the host
+* is resolved when the first request goes to it.
+*
+* @param [in] url The URL, or just the `scheme://host[:port]` part of it.
+* @param [in] ttl The time to live of the answer in seconds.
+*
+* @retval true The host is in the cache, or the URL has a numeric host which
+*              needs no cache.
+* @retval false Failed in adding the host, call qn_err_get_message() to get
+*               the reason.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_dns_add_host(const char * restrict url, int ttl)
+{
+    qn_http_dns_cache * cache = &qn_http_dns_inst;
+    char host[QN_HTTP_DNS_MAX_HOST_SIZE];
+    qn_bool ret = qn_true;
+    int port;
+
+    if (!qn_http_dns_parse_url(url, host, &port)) return qn_true;
+    if (ttl <= 0) return qn_true;
+
+    qn_http_dns_lock(cache);
+    if (!qn_http_dns_find_entry(cache, host, port)) {
+        ret = (qn_http_dns_add_entry(cache, host, port, ttl) != NULL);
+        if (ret) qn_http_dns_wake_refresher(cache);
+    } // if
+    qn_http_dns_unlock(cache);
+    return ret;
+}
+
+QN_SDK void qn_http_dns_reset(void)
+{
+    qn_http_dns_cache * cache = &qn_http_dns_inst;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    qn_http_dns_lock(cache);
+    if (cache->refresher_running) {
+        cache->stopping = qn_true;
+        pthread_cond_signal(&cache->cond);
+        qn_http_dns_unlock(cache);
+
+        pthread_join(cache->refresher, NULL);
+
+        qn_http_dns_lock(cache);
+        cache->refresher_running = qn_false;
+    } // if
+#else
+    qn_http_dns_lock(cache);
+#endif
+
+    while (cache->cnt > 0) qn_http_dns_remove_entry(cache, &cache->entries[cache->cnt - 1]);
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->cap = 0;
+    qn_http_dns_unlock(cache);
+}
+
+static inline int qn_http_dns_address_family(const char * restrict addr)
+{
+    return (addr[0] == '[' || strchr(addr, ':')) ? AF_INET6 : AF_INET;
+}
+
+// ---- cURL connects to the family of the first address and races the other one after a head start, so put addresses of the preferred family first.
+static qn_string qn_http_dns_order_addresses(qn_string addrs, int family)
+{
+    char buf[QN_HTTP_DNS_MAX_ADDRESSES * (INET6_ADDRSTRLEN + 3)];
+    const char * begin;
+    const char * end;
+    int pos = 0;
+    int pass;
+
+    if (family == AF_UNSPEC || qn_str_size(addrs) >= sizeof(buf)) return qn_str_duplicate(addrs);
+
+    for (pass = 0; pass < 2; pass += 1) {
+        for (begin = qn_str_cstr(addrs); *begin; begin = (*end) ? end + 1 : end) {
+            end = qn_str_find_char_or_null(begin, ',');
+            if ((qn_http_dns_address_family(begin) == family) != (pass == 0)) continue;
+            if (pos > 0) buf[pos++] = ',';
+            memcpy(buf + pos, begin, end - begin);
+            pos += end - begin;
+        } // for
+    } // for
+    return qn_cs_clone(buf, pos);
+}
+
+static void qn_http_dns_record_family(const char * restrict url, CURL * restrict curl)
+{
+    qn_http_dns_cache * cache = &qn_http_dns_inst;
+    char host[QN_HTTP_DNS_MAX_HOST_SIZE];
+    qn_http_dns_entry * ent;
+    const char * ip = NULL;
+    long conn_cnt = 0;
+    int port;
+
+    // ---- Only a new connection tells which family won the race.
+    if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &conn_cnt) != CURLE_OK || conn_cnt == 0) return;
+    if (curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &ip) != CURLE_OK || !ip || !*ip) return;
+    if (!qn_http_dns_parse_url(url, host, &port)) return;
+
+    qn_http_dns_lock(cache);
+    if ((ent = qn_http_dns_find_entry(cache, host, port))) ent->family = qn_http_dns_address_family(ip);
+    qn_http_dns_unlock(cache);
+}
+
+static qn_bool qn_http_dns_make_resolve_list(const char * restrict url, struct curl_slist ** restrict rsv_list)
+{
+    qn_http_dns_cache * cache = &qn_http_dns_inst;
+    char host[QN_HTTP_DNS_MAX_HOST_SIZE];
+    qn_http_dns_entry * ent;
+    qn_string rsv_entry = NULL;
+    qn_string addrs = NULL;
+    int port;
+
+    *rsv_list = NULL;
+    if (!qn_http_dns_parse_url(url, host, &port)) return qn_true;
+
+    qn_http_dns_lock(cache);
+    ent = qn_http_dns_find_entry(cache, host, port);
+    if (ent) ent->use_time = qn_tm_time();
+    if (ent && !ent->addrs) {
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+        // ---- The background thread is resolving the host, let cURL resolve it for this request.
+        ent = NULL;
+#else
+        // ---- Resolve a host added by qn_http_dns_add_host() on the first request to it.
+        if ((addrs = qn_http_dns_lookup_addresses(host))) {
+            if (!qn_http_dns_update_entry(cache, host, port, addrs, ent->ttl)) qn_str_destroy(addrs);
+            addrs = NULL;
+        } else {
+            qn_http_dns_remove_entry(cache, ent);
+            ent = NULL;
+        } // if
+#endif
+    } // if
+    if (ent && ent->expire_time <= qn_tm_time()) {
+#if !defined(QN_CFG_SUPPORT_MULTITHREAD)
+        // ---- No background refresher, drop the expired entry and let cURL resolve the host itself.
+        qn_http_dns_remove_entry(cache, ent);
+#endif
+        ent = NULL;
+    } // if
+    if (ent && (addrs = qn_http_dns_order_addresses(ent->addrs, ent->family))) {
+        // ---- The leading `+` lets cURL time the entry out of its own DNS cache like a normal answer.
+        rsv_entry = qn_cs_sprintf("+%s:%d:%s", host, port, qn_str_cstr(addrs));
+        qn_str_destroy(addrs);
+    } // if
+    qn_http_dns_unlock(cache);
+
+    if (!ent) return qn_true;
+    if (!rsv_entry) return qn_false;
+
+    *rsv_list = curl_slist_append(NULL, qn_str_cstr(rsv_entry));
+    qn_str_destroy(rsv_entry);
+    if (!*rsv_list) {
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+// ---- Definition of HTTP connection pool ----
+
+enum
+{
+    QN_HTTP_POOL_MAX_IDLE_HANDLES = 32
+};
+
+typedef struct _QN_HTTP_POOL_ENTRY
+{
+    qn_string key;
+    CURL * curl;
+} qn_http_pool_entry;
+
+typedef struct _QN_HTTP_POOL
+{
+    qn_bool ready;
+    CURLSH * share;
+
+    int cnt;
+    qn_http_pool_entry idle[QN_HTTP_POOL_MAX_IDLE_HANDLES];
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    pthread_mutex_t lock;
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+#endif
+} qn_http_pool;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+static qn_http_pool qn_http_pool_inst = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void qn_http_pool_lock_share_cfn(CURL * curl, curl_lock_data data, curl_lock_access access, void * user_data)
+{
+    pthread_mutex_lock(&((qn_http_pool *) user_data)->share_locks[data]);
+}
+
+static void qn_http_pool_unlock_share_cfn(CURL * curl, curl_lock_data data, void * user_data)
+{
+    pthread_mutex_unlock(&((qn_http_pool *) user_data)->share_locks[data]);
+}
+
+#define qn_http_pool_lock(pool) pthread_mutex_lock(&(pool)->lock)
+#define qn_http_pool_unlock(pool) pthread_mutex_unlock(&(pool)->lock)
+#else
+static qn_http_pool qn_http_pool_inst;
+
+#define qn_http_pool_lock(pool)
+#define qn_http_pool_unlock(pool)
+#endif
+
+static qn_bool qn_http_pool_prepare_share(qn_http_pool * restrict pool)
+{
+    CURLSHcode sh_code;
+
+    pool->share = curl_share_init();
+    if (!pool->share) {
+        qn_err_3rdp_set_curl_share_error_occurred(CURLSHE_NOMEM);
+        return qn_false;
+    } // if
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    {
+        int i;
+        for (i = 0; i < CURL_LOCK_DATA_LAST; i += 1) pthread_mutex_init(&pool->share_locks[i], NULL);
+    }
+    curl_share_setopt(pool->share, CURLSHOPT_USERDATA, pool);
+    curl_share_setopt(pool->share, CURLSHOPT_LOCKFUNC, qn_http_pool_lock_share_cfn);
+    curl_share_setopt(pool->share, CURLSHOPT_UNLOCKFUNC, qn_http_pool_unlock_share_cfn);
+#endif
+
+    // ---- Share DNS answers, TLS sessions and live connections among all easy handles.
+    if ((sh_code = curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS)) != CURLSHE_OK) goto QN_HTTP_POOL_PREPARE_SHARE_FAILED;
+    if ((sh_code = curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION)) != CURLSHE_OK) goto QN_HTTP_POOL_PREPARE_SHARE_FAILED;
+    if ((sh_code = curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT)) != CURLSHE_OK) goto QN_HTTP_POOL_PREPARE_SHARE_FAILED;
+    return qn_true;
+
+QN_HTTP_POOL_PREPARE_SHARE_FAILED:
+    curl_share_cleanup(pool->share);
+    pool->share = NULL;
+    qn_err_3rdp_set_curl_share_error_occurred(sh_code);
+    return qn_false;
+}
+
+static qn_bool qn_http_pool_init_unlocked(qn_http_pool * restrict pool)
+{
+    if (pool->ready) return qn_true;
+    if (!qn_http_pool_prepare_share(pool)) return qn_false;
+    pool->cnt = 0;
+    pool->ready = qn_true;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection-Pool
+*
+* Initialize the process-wide connection pool explicitly. All connection
+* objects check out easy handles from this pool, so they share DNS answers,
+* TLS sessions and keep-alive connections. Calling this function is optional
+* since the pool is initialized on first use.
+*
+* @retval true The pool is ready.
+* @retval false Failed in initializing the pool, call qn_err_get_message() to
+*               get the reason.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_pool_init(void)
+{
+    qn_bool ret;
+
+    qn_http_pool_lock(&qn_http_pool_inst);
+    ret = qn_http_pool_init_unlocked(&qn_http_pool_inst);
+    qn_http_pool_unlock(&qn_http_pool_inst);
+    return ret;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection-Pool
+*
+* Close all idle connections, release the process-wide connection pool and
+* clear the DNS cache. Call it only after all connection objects are destroyed.
+*******************************************************************************/
+QN_SDK void qn_http_pool_cleanup(void)
+{
+    int i;
+
+    qn_http_pool_lock(&qn_http_pool_inst);
+    if (qn_http_pool_inst.ready) {
+        for (i = 0; i < qn_http_pool_inst.cnt; i += 1) {
+            curl_easy_cleanup(qn_http_pool_inst.idle[i].curl);
+            qn_str_destroy(qn_http_pool_inst.idle[i].key);
+        } // for
+        qn_http_pool_inst.cnt = 0;
+
+        curl_share_cleanup(qn_http_pool_inst.share);
+        qn_http_pool_inst.share = NULL;
+        qn_http_pool_inst.ready = qn_false;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+        for (i = 0; i < CURL_LOCK_DATA_LAST; i += 1) pthread_mutex_destroy(&qn_http_pool_inst.share_locks[i]);
+#endif
+    } // if
+    qn_http_pool_unlock(&qn_http_pool_inst);
+
+    qn_http_dns_reset();
+}
+
+static qn_size qn_http_pool_key_size(const char * restrict url)
+{
+    const char * begin;
+    const char * end;
+
+    // ---- The key is the `scheme://host[:port]` part of the URL.
+    begin = posix_strstr(url, "://");
+    begin = (begin) ? begin + 3 : url;
+    end = qn_str_find_char_or_null(begin, '/');
+    return end - url;
+}
+
+static qn_bool qn_http_pool_set_handle_options(qn_http_pool * restrict pool, CURL * restrict curl)
+{
+    CURLcode curl_code;
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_SHARE, pool->share)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+
+    // ---- Race IPv4 and IPv6 on dual-stack hosts, so that a broken path of either family costs a short delay rather than a connect timeout.
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_IPRESOLVE, (long) CURL_IPRESOLVE_WHATEVER)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, (long) QN_HTTP_HAPPY_EYEBALLS_TIMEOUT_MS)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+static CURL * qn_http_pool_check_out(const char * restrict url)
+{
+    qn_http_pool * pool = &qn_http_pool_inst;
+    qn_size key_size = qn_http_pool_key_size(url);
+    CURL * curl = NULL;
+    qn_string key = NULL;
+    int i;
+
+    qn_http_pool_lock(pool);
+    if (!qn_http_pool_init_unlocked(pool)) {
+        qn_http_pool_unlock(pool);
+        return NULL;
+    } // if
+
+    // ---- Prefer the most recently used handle which talked to the same host.
+    for (i = pool->cnt - 1; i >= 0; i -= 1) {
+        if (qn_str_size(pool->idle[i].key) == key_size && posix_strncmp(pool->idle[i].key, url, key_size) == 0) {
+            curl = pool->idle[i].curl;
+            key = pool->idle[i].key;
+            pool->cnt -= 1;
+            memmove(&pool->idle[i], &pool->idle[i + 1], sizeof(pool->idle[0]) * (pool->cnt - i));
+            break;
+        } // if
+    } // for
+    qn_http_pool_unlock(pool);
+
+    qn_str_destroy(key);
+    if (curl) {
+        // ---- Resetting options keeps live connections and caches of the handle.
+        curl_easy_reset(curl);
+    } else {
+        curl = curl_easy_init();
+        if (!curl) {
+            qn_err_3rdp_set_curl_easy_error_occurred(CURLE_FAILED_INIT);
+            return NULL;
+        } // if
+    } // if
+
+    if (!qn_http_pool_set_handle_options(pool, curl)) {
+        curl_easy_cleanup(curl);
+        return NULL;
+    } // if
+    return curl;
+}
+
+static void qn_http_pool_check_in(const char * restrict url, CURL * restrict curl)
+{
+    qn_http_pool * pool = &qn_http_pool_inst;
+    qn_string key = NULL;
+    qn_http_pool_entry evicted = {NULL, NULL};
+
+    key = qn_cs_clone(url, qn_http_pool_key_size(url));
+    if (!key) {
+        curl_easy_cleanup(curl);
+        return;
+    } // if
+
+    qn_http_pool_lock(pool);
+    if (!pool->ready) {
+        // ---- The pool has been cleaned up while the handle was in use.
+        qn_http_pool_unlock(pool);
+        qn_str_destroy(key);
+        curl_easy_cleanup(curl);
+        return;
+    } // if
+
+    if (pool->cnt == QN_HTTP_POOL_MAX_IDLE_HANDLES) {
+        // ---- Evict the least recently used handle.
+        evicted = pool->idle[0];
+        pool->cnt -= 1;
+        memmove(&pool->idle[0], &pool->idle[1], sizeof(pool->idle[0]) * pool->cnt);
+    } // if
+
+    pool->idle[pool->cnt].key = key;
+    pool->idle[pool->cnt].curl = curl;
+    pool->cnt += 1;
+    qn_http_pool_unlock(pool);
+
+    if (evicted.curl) {
+        curl_easy_cleanup(evicted.curl);
+        qn_str_destroy(evicted.key);
+    } // if
+}
+
+// ---- Definition of HTTP TLS session cache ----
+
+enum
+{
+    QN_HTTP_SSLS_MAX_ENTRIES = 256
+};
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+static CURL * qn_http_ssls_open_handle(void)
+{
+    qn_http_pool * pool = &qn_http_pool_inst;
+    CURL * curl;
+
+    if (!qn_http_pool_init()) return NULL;
+
+    // ---- A private handle on the shared cache, so that no idle handle is parked in the pool for it.
+    if (!(curl = curl_easy_init())) {
+        qn_err_3rdp_set_curl_easy_error_occurred(CURLE_FAILED_INIT);
+        return NULL;
+    } // if
+    if (!qn_http_pool_set_handle_options(pool, curl)) {
+        curl_easy_cleanup(curl);
+        return NULL;
+    } // if
+    return curl;
+}
+
+static qn_bool qn_http_ssls_set_binary(qn_json_object_ptr restrict ent, const char * restrict key, const unsigned char * restrict bin, size_t bin_size)
+{
+    qn_string val = qn_cs_encode_base64_urlsafe((const char *) bin, bin_size);
+    if (!val) return qn_false;
+    if (!qn_json_obj_set_string(ent, key, val)) {
+        qn_str_destroy(val);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+static CURLcode qn_http_ssls_export_cfn(CURL * curl, void * user_data, const char * session_key, const unsigned char * shmac, size_t shmac_len, const unsigned char * sdata, size_t sdata_len, curl_off_t valid_until, int ietf_tls_id, const char * alpn, size_t earlydata_max)
+{
+    qn_json_array_ptr sessions = (qn_json_array_ptr) user_data;
+    qn_json_object_ptr ent;
+
+    if (valid_until <= qn_tm_time() || qn_json_arr_size(sessions) >= QN_HTTP_SSLS_MAX_ENTRIES) return CURLE_OK;
+
+    if (!(ent = qn_json_arr_push_new_empty_object(sessions))) return CURLE_OUT_OF_MEMORY;
+
+    // ---- Sessions of a cache which hashes peer keys come without the plain key.
+    if (session_key && !qn_json_obj_set_cstr(ent, "key", session_key)) return CURLE_OUT_OF_MEMORY;
+    if (shmac_len > 0 && !qn_http_ssls_set_binary(ent, "shmac", shmac, shmac_len)) return CURLE_OUT_OF_MEMORY;
+    if (!qn_http_ssls_set_binary(ent, "data", sdata, sdata_len)) return CURLE_OUT_OF_MEMORY;
+    if (!qn_json_obj_set_integer(ent, "valid_until", (qn_json_integer) valid_until)) return CURLE_OUT_OF_MEMORY;
+    return CURLE_OK;
+}
+
+static qn_string qn_http_ssls_read_file(const char * restrict fname)
+{
+    qn_file_ptr fl;
+    qn_string txt;
+    char * buf;
+    qn_fsize fsize;
+    qn_fsize pos = 0;
+    ssize_t ret;
+
+    if (!(fl = qn_fl_open(fname, NULL))) return NULL;
+
+    fsize = qn_fl_fsize(fl);
+    if (!(buf = malloc(fsize + 1))) {
+        qn_fl_close(fl);
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    while (pos < fsize && (ret = qn_fl_read(fl, buf + pos, fsize - pos)) > 0) pos += ret;
+    qn_fl_close(fl);
+
+    txt = qn_cs_clone(buf, pos);
+    free(buf);
+    return txt;
+}
+
+static qn_bool qn_http_ssls_import(CURL * restrict curl, qn_json_object_ptr restrict ent)
+{
+    qn_bool ret = qn_false;
+    qn_string key = NULL;
+    qn_string enc_shmac = NULL;
+    qn_string enc_sdata = NULL;
+    qn_string shmac = NULL;
+    qn_string sdata = NULL;
+    qn_json_integer valid_until = 0;
+    CURLcode curl_code;
+
+    if (!qn_json_obj_get_integer(ent, "valid_until", &valid_until) || valid_until <= qn_tm_time()) return qn_true;
+    if (!qn_json_obj_get_string(ent, "data", &enc_sdata)) return qn_true;
+    qn_json_obj_get_string(ent, "key", &key);
+    qn_json_obj_get_string(ent, "shmac", &enc_shmac);
+
+    if (enc_shmac && !(shmac = qn_cs_decode_base64_urlsafe(qn_str_cstr(enc_shmac), qn_str_size(enc_shmac)))) goto QN_HTTP_SSLS_IMPORT_CLEAN;
+    if (!(sdata = qn_cs_decode_base64_urlsafe(qn_str_cstr(enc_sdata), qn_str_size(enc_sdata)))) goto QN_HTTP_SSLS_IMPORT_CLEAN;
+
+    curl_code = curl_easy_ssls_import(curl, (key) ? qn_str_cstr(key) : NULL, (const unsigned char *) ((shmac) ? qn_str_cstr(shmac) : NULL), (shmac) ? qn_str_size(shmac) : 0, (const unsigned char *) qn_str_cstr(sdata), qn_str_size(sdata));
+
+    // ---- A session which cURL refuses, e.g. one of another TLS backend, is dropped rather than fails the whole load.
+    if (curl_code == CURLE_NOT_BUILT_IN || curl_code == CURLE_OUT_OF_MEMORY) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        goto QN_HTTP_SSLS_IMPORT_CLEAN;
+    } // if
+    ret = qn_true;
+
+QN_HTTP_SSLS_IMPORT_CLEAN:
+    qn_str_destroy(shmac);
+    qn_str_destroy(sdata);
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    // ---- In multithread builds qn_json_obj_get_string() returns duplicates owned by the caller.
+    qn_str_destroy(key);
+    qn_str_destroy(enc_shmac);
+    qn_str_destroy(enc_sdata);
+#endif
+    return ret;
+}
+#endif
+
+/***************************************************************************//**
+* @ingroup HTTP-TLS-Session-Cache
+*
+* Load TLS sessions saved by qn_http_ssls_save() into the session cache shared
+* by all connection objects, so that the first HTTPS request of a new process
+* to a known host resumes a session instead of doing a full handshake.
+* Expired sessions are skipped.
+*
+* @param [in] fname The name of the session file.
+*
+* @retval true The sessions are loaded.
+* @retval false Failed in reading the file, or the cURL library is built
+*               without session export support, call qn_err_get_message() to
+*               get the reason.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_ssls_load(const char * restrict fname)
+{
+#if LIBCURL_VERSION_NUM >= 0x080c00
+    CURL * curl;
+    qn_string txt;
+    qn_json_object_ptr root;
+    qn_json_array_ptr sessions = NULL;
+    qn_json_object_ptr ent;
+    qn_bool ret = qn_true;
+    int i;
+
+    if (!(txt = qn_http_ssls_read_file(fname))) return qn_false;
+    root = qn_json_object_from_string(qn_str_cstr(txt), qn_str_size(txt));
+    qn_str_destroy(txt);
+    if (!root) return qn_false;
+
+    if (!qn_json_obj_get_array(root, "sessions", &sessions)) {
+        // ---- No session to resume.
+        qn_json_obj_destroy(root);
+        return qn_true;
+    } // if
+    if (!(curl = qn_http_ssls_open_handle())) {
+        qn_json_obj_destroy(root);
+        return qn_false;
+    } // if
+
+    for (i = 0; i < qn_json_arr_size(sessions) && ret; i += 1) {
+        ent = NULL;
+        if (!qn_json_arr_get_object(sessions, i, &ent)) continue;
+        ret = qn_http_ssls_import(curl, ent);
+    } // for
+
+    curl_easy_cleanup(curl);
+    qn_json_obj_destroy(root);
+    return ret;
+#else
+    qn_err_3rdp_set_curl_easy_error_occurred(CURLE_NOT_BUILT_IN);
+    return qn_false;
+#endif
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-TLS-Session-Cache
+*
+* Save unexpired TLS sessions of the shared session cache to a file, which can
+* be loaded by later processes through qn_http_ssls_load(). The file is
+* replaced atomically, so processes may save to the same file concurrently.
+* Call it before qn_http_pool_cleanup() releases the cache.
+*
+* @param [in] fname The name of the session file.
+*
+* @retval true The sessions are saved.
+* @retval false Failed in writing the file, or the cURL library is built
+*               without session export support, call qn_err_get_message() to
+*               get the reason.
+*
+* @warning The file holds secrets which allow resuming TLS sessions, and is
+*          created readable by its owner only.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_ssls_save(const char * restrict fname)
+{
+#if LIBCURL_VERSION_NUM >= 0x080c00
+    CURL * curl;
+    CURLcode curl_code;
+    qn_json_object_ptr root;
+    qn_json_array_ptr sessions;
+    qn_string txt;
+    qn_string tmp_fname;
+    const char * pos;
+    size_t rem;
+    ssize_t wrt_size;
+    int fd;
+    qn_bool ret;
+
+    if (!(root = qn_json_obj_create())) return qn_false;
+    if (!(sessions = qn_json_obj_set_new_empty_array(root, "sessions")) || !(curl = qn_http_ssls_open_handle())) {
+        qn_json_obj_destroy(root);
+        return qn_false;
+    } // if
+
+    curl_code = curl_easy_ssls_export(curl, &qn_http_ssls_export_cfn, sessions);
+    curl_easy_cleanup(curl);
+    if (curl_code != CURLE_OK) {
+        qn_json_obj_destroy(root);
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+
+    txt = qn_json_object_to_string(root);
+    qn_json_obj_destroy(root);
+    if (!txt) return qn_false;
+
+    if (!(tmp_fname = qn_cs_sprintf("%s.XXXXXX", fname))) {
+        qn_str_destroy(txt);
+        return qn_false;
+    } // if
+
+    // ---- Write a temporary file and rename it over the old one, so readers never see a partial file.
+    // ---- mkstemp() picks an unused name and creates the file with O_EXCL and mode 0600, so nobody else can
+    //      plant or read it before the secrets are in.
+    if ((fd = mkstemp((char *) qn_str_cstr(tmp_fname))) < 0) {
+        qn_str_destroy(tmp_fname);
+        qn_str_destroy(txt);
+        qn_err_fl_set_opening_file_failed();
+        return qn_false;
+    } // if
+
+    ret = qn_true;
+    pos = qn_str_cstr(txt);
+    rem = qn_str_size(txt);
+    while (rem > 0) {
+        if ((wrt_size = write(fd, pos, rem)) < 0) {
+            if (errno == EINTR) continue;
+            ret = qn_false;
+            break;
+        } // if
+        pos += wrt_size;
+        rem -= wrt_size;
+    } // while
+    qn_str_destroy(txt);
+
+    // ---- Make the content durable before the rename publishes it, otherwise a crash may leave an empty file.
+    if (ret && fsync(fd) != 0) ret = qn_false;
+    if (close(fd) != 0) ret = qn_false;
+
+    if (ret && rename(qn_str_cstr(tmp_fname), fname) != 0) ret = qn_false;
+    if (!ret) {
+        unlink(qn_str_cstr(tmp_fname));
+        qn_str_destroy(tmp_fname);
+        qn_err_fl_set_writing_file_failed();
+        return qn_false;
+    } // if
+    qn_str_destroy(tmp_fname);
+    return qn_true;
+#else
+    qn_err_3rdp_set_curl_easy_error_occurred(CURLE_NOT_BUILT_IN);
+    return qn_false;
+#endif
+}
+
+// ---- Definition of HTTP bandwidth limiter ----
+
+typedef struct _QN_HTTP_BANDWIDTH
+{
+    qn_uint64 up_rate;      // In bytes per second, 0 means unlimited.
+    qn_uint64 down_rate;
+    int active;             // The number of transfers sharing the global limits.
+    qn_uint32 gen;          // Bumped whenever the shares change, so that running transfers pick up new ones.
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    pthread_mutex_t lock;
+#endif
+} qn_http_bandwidth;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+static qn_http_bandwidth qn_http_bw_inst = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+#define qn_http_bw_lock(bw) pthread_mutex_lock(&(bw)->lock)
+#define qn_http_bw_unlock(bw) pthread_mutex_unlock(&(bw)->lock)
+#else
+static qn_http_bandwidth qn_http_bw_inst;
+
+#define qn_http_bw_lock(bw)
+#define qn_http_bw_unlock(bw)
+#endif
+
+/***************************************************************************//**
+* @ingroup HTTP-Bandwidth
+*
+* Set the process-wide bandwidth limits shared by all connections and multi
+* objects. Each running transfer is capped at an equal share of the limits,
+* and the shares are rebalanced whenever a transfer starts or finishes, so the
+* aggregate throughput stays at the limits. cURL paces each transfer by itself,
+* so neither a connection nor a multi object is ever blocked by the limits.
+*
+* @param [in] up_bps The upload limit in bytes per second, or 0 for unlimited.
+* @param [in] down_bps The download limit in bytes per second, or 0 for
+*                      unlimited.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_bw_set_global_limits(qn_uint64 up_bps, qn_uint64 down_bps)
+{
+    qn_http_bw_lock(&qn_http_bw_inst);
+    qn_http_bw_inst.up_rate = up_bps;
+    qn_http_bw_inst.down_rate = down_bps;
+    qn_http_bw_inst.gen += 1;
+    qn_http_bw_unlock(&qn_http_bw_inst);
+}
+
+typedef struct _QN_HTTP_BW_METER
+{
+    CURL * curl;
+    qn_uint64 up_bps;       // The local limits of the transfer.
+    qn_uint64 down_bps;
+    qn_uint32 gen;          // The generation of the shares applied last time.
+    qn_bool joined;
+} qn_http_bw_meter;
+
+static inline curl_off_t qn_http_bw_min_rate(qn_uint64 local, qn_uint64 global)
+{
+    if (local == 0 || (global != 0 && global < local)) return (curl_off_t)global;
+    return (curl_off_t)local;
+}
+
+static inline qn_uint64 qn_http_bw_share(qn_uint64 rate, int active)
+{
+    qn_uint64 share;
+
+    if (rate == 0) return 0;
+    share = rate / ((active > 0) ? active : 1);
+    return (share > 0) ? share : 1;
+}
+
+// ---- Cap the transfer at the tighter one of its local limits and its share of the global limits.
+static CURLcode qn_http_bw_apply(qn_http_bw_meter * restrict mtr)
+{
+    CURLcode curl_code;
+    qn_uint64 up_share;
+    qn_uint64 down_share;
+
+    qn_http_bw_lock(&qn_http_bw_inst);
+    up_share = qn_http_bw_share(qn_http_bw_inst.up_rate, qn_http_bw_inst.active);
+    down_share = qn_http_bw_share(qn_http_bw_inst.down_rate, qn_http_bw_inst.active);
+    mtr->gen = qn_http_bw_inst.gen;
+    qn_http_bw_unlock(&qn_http_bw_inst);
+
+    if ((curl_code = curl_easy_setopt(mtr->curl, CURLOPT_MAX_SEND_SPEED_LARGE, qn_http_bw_min_rate(mtr->up_bps, up_share))) != CURLE_OK) return curl_code;
+    return curl_easy_setopt(mtr->curl, CURLOPT_MAX_RECV_SPEED_LARGE, qn_http_bw_min_rate(mtr->down_bps, down_share));
+}
+
+static int qn_http_bw_xferinfo_cfn(void * user_data, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+    qn_http_bw_meter * mtr = (qn_http_bw_meter *) user_data;
+    qn_uint32 gen;
+
+    qn_http_bw_lock(&qn_http_bw_inst);
+    gen = qn_http_bw_inst.gen;
+    qn_http_bw_unlock(&qn_http_bw_inst);
+
+    // ---- cURL reads the speed limits on every read and write, so new caps take effect right away.
+    if (gen != mtr->gen) qn_http_bw_apply(mtr);
+    return 0;
+}
+
+// ---- Stop sharing the global limits, so that the transfers left get larger shares.
+static void qn_http_bw_leave(qn_http_bw_meter * restrict mtr)
+{
+    if (!mtr->joined) return;
+
+    qn_http_bw_lock(&qn_http_bw_inst);
+    qn_http_bw_inst.active -= 1;
+    qn_http_bw_inst.gen += 1;
+    qn_http_bw_unlock(&qn_http_bw_inst);
+    mtr->joined = qn_false;
+}
+
+static qn_bool qn_http_set_bandwidth_options(CURL * restrict curl, qn_http_bw_meter * restrict mtr, qn_uint64 up_bps, qn_uint64 down_bps)
+{
+    CURLcode curl_code;
+    qn_bool shared;
+
+    mtr->curl = curl;
+    mtr->up_bps = up_bps;
+    mtr->down_bps = down_bps;
+
+    qn_http_bw_lock(&qn_http_bw_inst);
+    shared = (qn_http_bw_inst.up_rate != 0 || qn_http_bw_inst.down_rate != 0);
+    if (shared) {
+        qn_http_bw_inst.active += 1;
+        qn_http_bw_inst.gen += 1;
+    } // if
+    qn_http_bw_unlock(&qn_http_bw_inst);
+    mtr->joined = shared;
+
+    if ((curl_code = qn_http_bw_apply(mtr)) != CURLE_OK) goto QN_HTTP_SET_BANDWIDTH_OPTIONS_ERROR;
+    if (!shared) return qn_true;
+
+    // ---- Running transfers check for rebalanced shares in the progress callback, which never blocks.
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, qn_http_bw_xferinfo_cfn)) != CURLE_OK) goto QN_HTTP_SET_BANDWIDTH_OPTIONS_ERROR;
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_XFERINFODATA, mtr)) != CURLE_OK) goto QN_HTTP_SET_BANDWIDTH_OPTIONS_ERROR;
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L)) != CURLE_OK) goto QN_HTTP_SET_BANDWIDTH_OPTIONS_ERROR;
+    return qn_true;
+
+QN_HTTP_SET_BANDWIDTH_OPTIONS_ERROR:
+    qn_http_bw_leave(mtr);
+    qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+    return qn_false;
+}
+
+// ---- Definition of HTTP tuning ----
+
+#define QN_HTTP_TUN_SMALL_BUFFER_SIZE (16 * 1024)
+#define QN_HTTP_TUN_UP_BUFFER_MIN (64 * 1024)
+#define QN_HTTP_TUN_UP_BUFFER_MAX (2 * 1024 * 1024)
+#define QN_HTTP_TUN_UP_BUFFER_INIT (512 * 1024)
+#define QN_HTTP_TUN_DOWN_BUFFER_MIN (16 * 1024)
+#define QN_HTTP_TUN_DOWN_BUFFER_MAX (1024 * 1024)
+#define QN_HTTP_TUN_DOWN_BUFFER_INIT (256 * 1024)
+#define QN_HTTP_TUN_MIN_WINDOW 20000            // In microseconds.
+#define QN_HTTP_TUN_MAX_WINDOW 1000000          // In microseconds.
+#define QN_HTTP_TUN_MIN_SAMPLE_BYTES (256 * 1024)
+
+typedef struct _QN_HTTP_TUNING
+{
+    qn_http_tuning_profile_em prof;
+
+    // ---- Estimates taken from previous bulk transfers, 0 means not measured yet.
+    qn_uint64 up_rate;      // In bytes per second.
+    qn_uint64 down_rate;    // In bytes per second.
+    qn_uint64 rtt;          // In microseconds, measured on TCP handshakes.
+} qn_http_tuning;
+
+static inline qn_uint64 qn_http_tun_smooth(qn_uint64 old_val, qn_uint64 sample)
+{
+    return (old_val == 0) ? sample : (old_val * 3 + sample) / 4;
+}
+
+static long qn_http_tun_buffer_size(qn_http_tuning * restrict tun, qn_uint64 rate, long min, long max, long init)
+{
+    qn_uint64 win;
+    qn_uint64 size;
+
+    if (rate == 0) return init;
+
+    // ---- Hand over about one round trip of data per callback, so the pipe is kept full with the fewest calls.
+    win = tun->rtt;
+    if (win < QN_HTTP_TUN_MIN_WINDOW) win = QN_HTTP_TUN_MIN_WINDOW;
+    if (win > QN_HTTP_TUN_MAX_WINDOW) win = QN_HTTP_TUN_MAX_WINDOW;
+
+    size = rate * win / 1000000;
+    if (size < (qn_uint64)min) return min;
+    if (size > (qn_uint64)max) return max;
+    return (long)((size + QN_HTTP_TUN_SMALL_BUFFER_SIZE - 1) / QN_HTTP_TUN_SMALL_BUFFER_SIZE * QN_HTTP_TUN_SMALL_BUFFER_SIZE);
+}
+
+static qn_bool qn_http_set_tuning_options(CURL * restrict curl, qn_http_tuning * restrict tun)
+{
+    CURLcode curl_code;
+    long up_buf_size;
+    long down_buf_size;
+    int i;
+    struct {
+        CURLoption opt;
+        long val;
+    } opts[] = {
+        {CURLOPT_TCP_NODELAY, 1L},
+        {CURLOPT_TCP_KEEPALIVE, 1L},
+        {CURLOPT_TCP_KEEPIDLE, 60L},
+        {CURLOPT_TCP_KEEPINTVL, 15L},
+        {CURLOPT_BUFFERSIZE, 0L},
+        {CURLOPT_UPLOAD_BUFFERSIZE, 0L}
+    };
+
+    // ---- Pooled handles are reset on checking out, so nothing is left over from other profiles.
+    if (tun->prof == QN_HTTP_TUNING_DEFAULT) return qn_true;
+
+    if (tun->prof == QN_HTTP_TUNING_BULK) {
+        up_buf_size = qn_http_tun_buffer_size(tun, tun->up_rate, QN_HTTP_TUN_UP_BUFFER_MIN, QN_HTTP_TUN_UP_BUFFER_MAX, QN_HTTP_TUN_UP_BUFFER_INIT);
+        down_buf_size = qn_http_tun_buffer_size(tun, tun->down_rate, QN_HTTP_TUN_DOWN_BUFFER_MIN, QN_HTTP_TUN_DOWN_BUFFER_MAX, QN_HTTP_TUN_DOWN_BUFFER_INIT);
+    } else {
+        up_buf_size = QN_HTTP_TUN_SMALL_BUFFER_SIZE;
+        down_buf_size = QN_HTTP_TUN_SMALL_BUFFER_SIZE;
+    } // if
+    opts[4].val = down_buf_size;
+    opts[5].val = up_buf_size;
+
+    for (i = 0; i < sizeof(opts) / sizeof(opts[0]); i += 1) {
+        if ((curl_code = curl_easy_setopt(curl, opts[i].opt, opts[i].val)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+    } // for
+    return qn_true;
+}
+
+static void qn_http_tun_measure(qn_http_tuning * restrict tun, const qn_http_timing_st * restrict timing)
+{
+    qn_uint64 elapsed;
+
+    if (tun->prof != QN_HTTP_TUNING_BULK) return;
+
+    // ---- Only new connections tell the round trip time, by the TCP handshake.
+    if (timing->connect > timing->namelookup) tun->rtt = qn_http_tun_smooth(tun->rtt, timing->connect - timing->namelookup);
+
+    // ---- Small transfers are dominated by latency rather than bandwidth, so they are not taken as samples.
+    if (timing->bytes_up >= QN_HTTP_TUN_MIN_SAMPLE_BYTES && timing->total > timing->pretransfer) {
+        // ---- The first byte may be an interim `100 Continue`, so count until the end, which is close for small replies.
+        elapsed = timing->total - timing->pretransfer;
+        tun->up_rate = qn_http_tun_smooth(tun->up_rate, timing->bytes_up * 1000000 / elapsed);
+    } // if
+    if (timing->bytes_down >= QN_HTTP_TUN_MIN_SAMPLE_BYTES && timing->total > timing->starttransfer) {
+        elapsed = timing->total - timing->starttransfer;
+        tun->down_rate = qn_http_tun_smooth(tun->down_rate, timing->bytes_down * 1000000 / elapsed);
+    } // if
+}
+
+// ---- Definition of HTTP connection ----
+
+typedef struct _QN_HTTP_CONNECTION
+{
+    qn_http_transport_ptr tpt_vtbl;     // The default transport built on cURL.
+    qn_http_transport_itf tpt;          // The transport requests go through.
+
+    int port;
+    qn_string ip;
+    qn_string host;
+    qn_string url_prefix;
+
+    qn_http_version_em ver;
+    qn_bool compressed;
+
+    // ---- Bandwidth limits of this connection in bytes per second, 0 means unlimited.
+    qn_uint64 up_bps;
+    qn_uint64 down_bps;
+    qn_http_bw_meter meter;
+
+    qn_http_tuning tun;
+
+    // ---- The easy handle checked out from the pool, only valid during a request.
+    CURL * curl;
+} qn_http_connection;
+
+static qn_http_transport_st qn_http_conn_tpt_vtable;
+
+QN_SDK qn_http_connection_ptr qn_http_conn_create(void)
+{
+    qn_http_connection_ptr new_conn = NULL;
+
+    if (!qn_http_pool_init()) return NULL;
+
+    new_conn = calloc(1, sizeof(qn_http_connection));
+    if (!new_conn) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_conn->tpt_vtbl = &qn_http_conn_tpt_vtable;
+    new_conn->tpt = &new_conn->tpt_vtbl;
+    return new_conn;
+}
+
+QN_SDK void qn_http_conn_destroy(qn_http_connection_ptr restrict conn)
+{
+    if (conn) {
+        free(conn);
+    } // if
+}
+
+QN_SDK void qn_http_conn_set_version(qn_http_connection_ptr restrict conn, qn_http_version_em ver)
+{
+    conn->ver = ver;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection
+*
+* Set the bandwidth limits of requests sent through the connection. The limits
+* work together with the global ones set by qn_http_bw_set_global_limits(), and
+* the tighter one wins.
+*
+* @param [in] conn The pointer to the connection.
+* @param [in] up_bps The upload limit in bytes per second, or 0 for unlimited.
+* @param [in] down_bps The download limit in bytes per second, or 0 for
+*                      unlimited.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_conn_set_bandwidth_limits(qn_http_connection_ptr restrict conn, qn_uint64 up_bps, qn_uint64 down_bps)
+{
+    conn->up_bps = up_bps;
+    conn->down_bps = down_bps;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection
+*
+* Send requests of the connection through another transport, e.g. a loopback
+* one for benchmarking the SDK without network. The transport must stay alive
+* until it is replaced or the connection is destroyed.
+*
+* @param [in] conn The pointer to the connection.
+* @param [in] tpt The transport to use, or NULL to restore the default one
+*                 built on cURL.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_conn_set_transport(qn_http_connection_ptr restrict conn, qn_http_transport_itf restrict tpt)
+{
+    conn->tpt = (tpt) ? tpt : &conn->tpt_vtbl;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection
+*
+* Ask servers to compress response bodies of following requests. Bodies are
+* decoded on the fly and handed to the body writer piece by piece, so nothing
+* is buffered whole. Leave it off for ranged downloads, whose offsets refer to
+* the original data.
+*
+* @param [in] conn The pointer to the connection.
+* @param [in] enable Advertise supported encodings or not.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_conn_set_compression(qn_http_connection_ptr restrict conn, qn_bool enable)
+{
+    conn->compressed = enable;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection
+*
+* Set how buffers and sockets of the connection are tuned. The bulk profile
+* starts with large buffers, then sizes them to about one round trip of data
+* at the throughput measured on previous bulk transfers, so the body reader
+* and writer are called fewer times with more data each.
+*
+* @param [in] conn The pointer to the connection.
+* @param [in] prof The tuning profile of following requests.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_conn_set_tuning_profile(qn_http_connection_ptr restrict conn, qn_http_tuning_profile_em prof)
+{
+    conn->tun.prof = prof;
+}
+
+static size_t qn_http_conn_body_reader(char * ptr, size_t size, size_t nmemb, void * user_data)
+{
+    qn_http_request_ptr req = (qn_http_request_ptr) user_data;
+    return req->body_rdr_cb(req->body_rdr, ptr, size * nmemb);
+}
+
+static qn_bool qn_http_set_get_options(CURL * restrict curl, const char * restrict url, qn_http_request_ptr restrict req)
+{
+    CURLcode curl_code;
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_POST, 0)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_URL, url)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+static qn_bool qn_http_set_post_options(CURL * restrict curl, const char * restrict url, qn_http_request_ptr restrict req)
+{
+    CURLcode curl_code;
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_POST, 1)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_URL, url)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+
+    if (req->form) {
+        if (!qn_http_form_prepare_for_sending(req->form)) return qn_false;
+
+        // ---- Each part of the form carries its own data source, so no read function is set on the handle.
+        if ((curl_code = curl_easy_setopt(curl, CURLOPT_MIMEPOST, req->form->mime)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+    } else if (req->body_data) {
+        if ((curl_code = curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req->body_data)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+        if ((curl_code = curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, req->body_size)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+    } else {
+        if ((curl_code = curl_easy_setopt(curl, CURLOPT_READFUNCTION, qn_http_conn_body_reader)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+        if ((curl_code = curl_easy_setopt(curl, CURLOPT_READDATA, req)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+    } // form
+    return qn_true;
+}
+
+static qn_bool qn_http_set_version_options(CURL * restrict curl, qn_http_version_em ver)
+{
+    CURLcode curl_code;
+    long curl_ver;
+
+    switch (ver) {
+        case QN_HTTP_VERSION_1_1: curl_ver = CURL_HTTP_VERSION_1_1; break;
+        case QN_HTTP_VERSION_2: curl_ver = CURL_HTTP_VERSION_2TLS; break;
+        case QN_HTTP_VERSION_2_PRIOR_KNOWLEDGE: curl_ver = CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE; break;
+        default: return qn_true;
+    } // switch
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, curl_ver)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+
+    if (ver != QN_HTTP_VERSION_1_1) {
+        // ---- Wait for an existing HTTP/2 connection to the same host and multiplex on it, rather than open a new one.
+        if ((curl_code = curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L)) != CURLE_OK) {
+            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+            return qn_false;
+        } // if
+    } // if
+    return qn_true;
+}
+
+static qn_bool qn_http_set_encoding_options(CURL * restrict curl, qn_bool compressed)
+{
+    CURLcode curl_code;
+
+    if (!compressed) return qn_true;
+
+    // ---- An empty string advertises all encodings cURL is built with, and cURL decodes the body as it arrives.
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "")) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+static qn_bool qn_http_set_resolve_options(CURL * restrict curl, const char * restrict url, struct curl_slist ** restrict rsv_list)
+{
+    CURLcode curl_code;
+
+    if (!qn_http_dns_make_resolve_list(url, rsv_list)) return qn_false;
+    if (!*rsv_list) return qn_true;
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_RESOLVE, *rsv_list)) != CURLE_OK) {
+        curl_slist_free_all(*rsv_list);
+        *rsv_list = NULL;
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+typedef struct _QN_HTTP_HDR_LIST
+{
+    struct curl_slist * head;       // The list handed to cURL.
+    struct curl_slist * own_last;   // The last node owned by the request, if it links to the list of a template.
+    qn_bool shared_only;            // The list is the one of a template and owned by it.
+} qn_http_hdr_list;
+
+static void qn_http_hdr_list_release(qn_http_hdr_list * restrict list)
+{
+    if (!list->shared_only) {
+        // ---- Unlink the list of the template before freeing nodes owned by the request.
+        if (list->own_last) list->own_last->next = NULL;
+        curl_slist_free_all(list->head);
+    } // if
+    list->head = NULL;
+    list->own_last = NULL;
+    list->shared_only = qn_false;
+}
+
+static qn_bool qn_http_hdr_list_append(struct curl_slist ** restrict headers, const char * restrict entry)
+{
+    struct curl_slist * headers2 = curl_slist_append(*headers, entry);
+    if (!headers2) {
+        curl_slist_free_all(*headers);
+        *headers = NULL;
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+    *headers = headers2;
+    return qn_true;
+}
+
+static qn_bool qn_http_hdr_list_has_key(struct curl_slist * restrict headers, const char * restrict entry)
+{
+    qn_size key_size = qn_str_find_char_or_null(entry, ':') - entry;
+
+    for (; headers; headers = headers->next) {
+        if (strncasecmp(headers->data, entry, key_size) == 0 && headers->data[key_size] == ':') return qn_true;
+    } // for
+    return qn_false;
+}
+
+static qn_bool qn_http_hdr_list_build(qn_http_request_ptr restrict req, qn_http_hdr_list * restrict list)
+{
+    struct curl_slist * headers = NULL;
+    struct curl_slist * node;
+    qn_string entry = NULL;
+    qn_http_hdr_iterator_ptr itr;
+    qn_bool overridden = qn_false;
+
+    list->head = NULL;
+    list->own_last = NULL;
+    list->shared_only = qn_false;
+
+    if (qn_http_hdr_count(req->hdr) > 0) {
+        itr = qn_http_hdr_itr_create(req->hdr);
+        if (!itr) return qn_false;
+
+        while ((entry = qn_http_hdr_itr_next_entry(itr))) {
+            if (!qn_http_hdr_list_append(&headers, entry)) {
+                qn_http_hdr_itr_destroy(itr);
+                return qn_false;
+            } // if
+        } // while
+
+        qn_http_hdr_itr_destroy(itr);
+    } // if
+
+    if (!req->tmpl || !req->tmpl->headers) {
+        list->head = headers;
+        return qn_true;
+    } // if
+
+    if (!headers) {
+        // ---- Hand the compiled list of the template to cURL directly.
+        list->head = req->tmpl->headers;
+        list->shared_only = qn_true;
+        return qn_true;
+    } // if
+
+    for (node = req->tmpl->headers; node && !overridden; node = node->next) {
+        overridden = qn_http_hdr_list_has_key(headers, node->data);
+    } // for
+
+    if (overridden) {
+        // ---- Copy headers of the template which are not overridden by the request.
+        for (node = req->tmpl->headers; node; node = node->next) {
+            if (qn_http_hdr_list_has_key(headers, node->data)) continue;
+            if (!qn_http_hdr_list_append(&headers, node->data)) return qn_false;
+        } // for
+        list->head = headers;
+        return qn_true;
+    } // if
+
+    // ---- Link the compiled list of the template after headers owned by the request.
+    for (node = headers; node->next; node = node->next) ;
+    node->next = req->tmpl->headers;
+    list->head = headers;
+    list->own_last = node;
+    return qn_true;
+}
+
+static qn_bool qn_http_set_common_options(CURL * restrict curl, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, qn_http_hdr_list * restrict hdr_list)
+{
+    CURLcode curl_code;
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, qn_http_resp_hdr_wrt_write_cfn)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_HEADERDATA, resp)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, qn_http_resp_body_wrt_write_cfn)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_WRITEDATA, resp)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+
+    if (!qn_http_hdr_list_build(req, hdr_list)) return qn_false;
+
+    // ---- The header list must live until the transfer is done.
+    if ((curl_code = curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdr_list->head)) != CURLE_OK) {
+        qn_http_hdr_list_release(hdr_list);
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+static qn_bool qn_http_check_curl_code(CURLcode curl_code)
+{
+    if (curl_code != CURLE_OK) {
+        switch (curl_code) {
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_OPERATION_TIMEDOUT:
+                qn_err_set_try_again();
+                return qn_false;
+
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_RESOLVE_PROXY:
+                qn_err_comm_set_dns_failed();
+                return qn_false;
+
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+                qn_err_comm_set_transmission_failed();
+                return qn_false;
+
+            case CURLE_HTTP2:
+            case CURLE_HTTP2_STREAM:
+                // ---- The HTTP/2 framing layer failed or the stream was reset by the peer.
+                qn_err_comm_set_transmission_failed();
+                return qn_false;
+
+            // case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_PARTIAL_FILE:
+                qn_err_http_set_mismatching_file_size();
+                return qn_false;
+
+            case CURLE_WRITE_ERROR:
+                // ---- A writer callback refused the data and has set the error itself, unless cURL aborted the write on its own.
+                if (qn_err_is_succeed()) qn_err_comm_set_transmission_failed();
+                return qn_false;
+
+            default:
+                break;
+        } // switch
+    } // if
+    return qn_true;
+}
+
+static qn_bool qn_http_conn_do_request(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    CURLcode curl_code;
+    qn_http_hdr_list headers;
+    struct curl_slist * resolves = NULL;
+
+    if (!qn_http_set_version_options(conn->curl, conn->ver)) return qn_false;
+    if (!qn_http_set_tuning_options(conn->curl, &conn->tun)) return qn_false;
+    if (!qn_http_set_encoding_options(conn->curl, conn->compressed)) return qn_false;
+    if (!qn_http_set_resolve_options(conn->curl, url, &resolves)) return qn_false;
+    if (!qn_http_set_common_options(conn->curl, req, resp, &headers)) {
+        curl_slist_free_all(resolves);
+        return qn_false;
+    } // if
+
+    // ---- Join the global limits last, so that no failure above leaves a share taken.
+    if (!qn_http_set_bandwidth_options(conn->curl, &conn->meter, conn->up_bps, conn->down_bps)) {
+        qn_http_hdr_list_release(&headers);
+        curl_slist_free_all(resolves);
+        return qn_false;
+    } // if
+
+    curl_code = curl_easy_perform(conn->curl);
+    qn_http_bw_leave(&conn->meter);
+    qn_http_resp_capture_timing(resp, conn->curl);
+    qn_http_hdr_list_release(&headers);
+    curl_slist_free_all(resolves);
+
+    if (curl_code == CURLE_OK) {
+        qn_http_tun_measure(&conn->tun, &resp->timing);
+        qn_http_dns_record_family(url, conn->curl);
+    } // if
+    return qn_http_check_curl_code(curl_code);
+}
+
+static inline qn_http_connection_ptr qn_http_conn_from_transport(qn_http_transport_itf restrict itf)
+{
+    return (qn_http_connection_ptr)( ( (char *) itf ) - (char *)( &((qn_http_connection_ptr)0)->tpt_vtbl ) );
+}
+
+static qn_bool qn_http_conn_tpt_get_vfn(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    qn_bool ret;
+    qn_http_connection_ptr conn = qn_http_conn_from_transport(itf);
+
+    conn->curl = qn_http_pool_check_out(url);
+    if (!conn->curl) return qn_false;
+
+    ret = qn_http_set_get_options(conn->curl, url, req) && qn_http_conn_do_request(conn, url, req, resp);
+
+    qn_http_pool_check_in(url, conn->curl);
+    conn->curl = NULL;
+    return ret;
+}
+
+static qn_bool qn_http_conn_tpt_post_vfn(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    qn_bool ret;
+    qn_http_connection_ptr conn = qn_http_conn_from_transport(itf);
+
+    conn->curl = qn_http_pool_check_out(url);
+    if (!conn->curl) return qn_false;
+
+    ret = qn_http_set_post_options(conn->curl, url, req) && qn_http_conn_do_request(conn, url, req, resp);
+
+    qn_http_pool_check_in(url, conn->curl);
+    conn->curl = NULL;
+    return ret;
+}
+
+static qn_http_transport_st qn_http_conn_tpt_vtable = {
+    &qn_http_conn_tpt_get_vfn,
+    &qn_http_conn_tpt_post_vfn
+};
+
+QN_SDK qn_bool qn_http_conn_get(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    return qn_http_tpt_get(conn->tpt, url, req, resp);
+}
+
+QN_SDK qn_bool qn_http_conn_post(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    return qn_http_tpt_post(conn->tpt, url, req, resp);
+}
+
+typedef struct _QN_HTTP_PREWARM_TARGET
+{
+    qn_string url;                  // The `scheme://host[:port]/` part of the given URL.
+    CURL * curl;
+    struct curl_slist * resolves;
+} qn_http_prewarm_target;
+
+static qn_bool qn_http_prewarm_is_duplicate(const char ** restrict urls, int n)
+{
+    qn_size key_size = qn_http_pool_key_size(urls[n]);
+    int i;
+
+    for (i = 0; i < n; i += 1) {
+        if (qn_http_pool_key_size(urls[i]) == key_size && posix_strncmp(urls[i], urls[n], key_size) == 0) return qn_true;
+    } // for
+    return qn_false;
+}
+
+static qn_bool qn_http_prewarm_add_target(CURLM * restrict multi, qn_http_prewarm_target * restrict tgt, const char * restrict url, qn_http_version_em ver, int timeout_ms)
+{
+    CURLcode curl_code;
+    CURLMcode multi_code;
+
+    if (!(tgt->url = qn_cs_sprintf("%.*s/", (int)qn_http_pool_key_size(url), url))) return qn_false;
+    if (!(tgt->curl = qn_http_pool_check_out(tgt->url))) return qn_false;
+
+    // ---- A HEAD request leaves a keep-alive connection in the shared cache, which a connect-only one does not.
+    if ((curl_code = curl_easy_setopt(tgt->curl, CURLOPT_URL, tgt->url)) != CURLE_OK || (curl_code = curl_easy_setopt(tgt->curl, CURLOPT_NOBODY, 1L)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if (timeout_ms > 0 && (curl_code = curl_easy_setopt(tgt->curl, CURLOPT_TIMEOUT_MS, (long)timeout_ms)) != CURLE_OK) {
+        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        return qn_false;
+    } // if
+    if (!qn_http_set_version_options(tgt->curl, ver)) return qn_false;
+    if (!qn_http_set_resolve_options(tgt->curl, tgt->url, &tgt->resolves)) return qn_false;
+
+    if ((multi_code = curl_multi_add_handle(multi, tgt->curl)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Connection
+*
+* Open connections to the hosts of the given URLs in parallel ahead of time, so
+* that the first requests sent to them pay no DNS, TCP or TLS latency. Each
+* host gets one HEAD request to the root path, and any answer validates the
+* connection, which then stays in the process-wide pool for reuse.
+*
+* @param [in] conn The pointer to the connection, whose HTTP version is used.
+* @param [in] urls The URLs, only the `scheme://host[:port]` parts are used.
+* @param [in] cnt The number of URLs.
+* @param [in] timeout_ms The time limit of each request in milliseconds, or 0
+*                        for no limit.
+* @retval qn_true All hosts are connected.
+* @retval qn_false Failed in connecting some of the hosts, and the error code
+*                  of the last failure is set. Connections to the other hosts
+*                  are kept.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_conn_prewarm(qn_http_connection_ptr restrict conn, const char ** restrict urls, int cnt, int timeout_ms)
+{
+    CURLM * multi;
+    CURLMsg * msg;
+    CURLMcode multi_code = CURLM_OK;
+    qn_http_prewarm_target * tgts;
+    const char * eff_url;
+    qn_bool ret = qn_true;
+    int running = 0;
+    int msg_cnt = 0;
+    int i;
+
+    if (cnt <= 0) return qn_true;
+
+    if (!(tgts = calloc(cnt, sizeof(qn_http_prewarm_target)))) {
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+    if (!(multi = curl_multi_init())) {
+        free(tgts);
+        qn_err_3rdp_set_curl_multi_error_occurred(CURLM_OUT_OF_MEMORY);
+        return qn_false;
+    } // if
+
+    for (i = 0; i < cnt && ret; i += 1) {
+        if (qn_http_prewarm_is_duplicate(urls, i)) continue;
+        ret = qn_http_prewarm_add_target(multi, &tgts[i], urls[i], conn->ver, timeout_ms);
+    } // for
+
+    while (ret) {
+        if ((multi_code = curl_multi_perform(multi, &running)) != CURLM_OK || running == 0) break;
+        if ((multi_code = curl_multi_poll(multi, NULL, 0, 1000, NULL)) != CURLM_OK) break;
+    } // while
+    if (multi_code != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
+        ret = qn_false;
+    } // if
+
+    while ((msg = curl_multi_info_read(multi, &msg_cnt))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        if (msg->data.result == CURLE_OK) {
+            eff_url = NULL;
+            if (curl_easy_getinfo(msg->easy_handle, CURLINFO_EFFECTIVE_URL, &eff_url) == CURLE_OK && eff_url) qn_http_dns_record_family(eff_url, msg->easy_handle);
+            continue;
+        } // if
+        if (qn_http_check_curl_code(msg->data.result)) qn_err_3rdp_set_curl_easy_error_occurred(msg->data.result);
+        ret = qn_false;
+    } // while
+
+    for (i = 0; i < cnt; i += 1) {
+        if (tgts[i].curl) {
+            curl_multi_remove_handle(multi, tgts[i].curl);
+            qn_http_pool_check_in(tgts[i].url, tgts[i].curl);
+        } // if
+        curl_slist_free_all(tgts[i].resolves);
+        qn_str_destroy(tgts[i].url);
+    } // for
+
+    curl_multi_cleanup(multi);
+    free(tgts);
+    return ret;
+}
+
+// ---- Definition of HTTP loopback transport ----
+
+#define QN_HTTP_LPBK_CHUNK_SIZE CURL_MAX_WRITE_SIZE
+
+typedef struct _QN_HTTP_LOOPBACK
+{
+    qn_http_transport_ptr tpt_vtbl;
+
+    int code;
+    qn_string body;
+    qn_http_header_ptr hdr;
+    qn_string head;                 // The status line and headers, rendered when the response changes.
+
+    void * user_data;
+    qn_http_lpbk_handler_callback_fn handler_cb;
+
+    qn_uint64 req_cnt;
+    char buf[QN_HTTP_LPBK_CHUNK_SIZE];
+} qn_http_loopback;
+
+static qn_http_transport_st qn_http_lpbk_tpt_vtable;
+
+/***************************************************************************//**
+* @ingroup HTTP-Loopback
+*
+* Create a loopback transport, which serves requests in process. It consumes
+* request bodies and feeds responses through the same callbacks as cURL does,
+* so everything but the network is exercised. The default response is a 200
+* one with an empty JSON object as its body.
+*
+* A loopback object is not thread-safe, create one for each thread.
+*
+* @retval non-NULL The pointer to the new loopback object.
+* @retval NULL Failed in creating the object, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_http_loopback_ptr qn_http_lpbk_create(void)
+{
+    qn_http_loopback_ptr new_lpbk = calloc(1, sizeof(qn_http_loopback));
+    if (!new_lpbk) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_lpbk->hdr = qn_http_hdr_create();
+    if (!new_lpbk->hdr) {
+        free(new_lpbk);
+        return NULL;
+    } // if
+
+    new_lpbk->tpt_vtbl = &qn_http_lpbk_tpt_vtable;
+    if (!qn_http_lpbk_set_response(new_lpbk, 200, "{}", 2) || !qn_http_lpbk_set_header(new_lpbk, "Content-Type", "application/json")) {
+        qn_http_lpbk_destroy(new_lpbk);
+        return NULL;
+    } // if
+    return new_lpbk;
+}
+
+QN_SDK void qn_http_lpbk_destroy(qn_http_loopback_ptr restrict lpbk)
+{
+    if (lpbk) {
+        qn_str_destroy(lpbk->head);
+        qn_str_destroy(lpbk->body);
+        qn_http_hdr_destroy(lpbk->hdr);
+        free(lpbk);
+    } // if
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Loopback
+*
+* Set the status code and body of the response served to following requests.
+* The body is copied. Headers set before are kept.
+*
+* @param [in] lpbk The pointer to the loopback object.
+* @param [in] code The HTTP status code.
+* @param [in] body The body of the response.
+* @param [in] body_size The size of the body.
+* @retval qn_true The response is set.
+* @retval qn_false Failed in copying the body, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_lpbk_set_response(qn_http_loopback_ptr restrict lpbk, int code, const char * restrict body, qn_size body_size)
+{
+    qn_string new_body = qn_cs_clone(body, body_size);
+    if (!new_body) return qn_false;
+
+    qn_str_destroy(lpbk->body);
+    lpbk->body = new_body;
+    lpbk->code = code;
+
+    qn_str_destroy(lpbk->head);
+    lpbk->head = NULL;
+    return qn_true;
+}
+
+QN_SDK qn_bool qn_http_lpbk_set_header(qn_http_loopback_ptr restrict lpbk, const char * restrict hdr, const char * restrict val)
+{
+    if (!qn_http_hdr_set_string(lpbk->hdr, hdr, val)) return qn_false;
+
+    qn_str_destroy(lpbk->head);
+    lpbk->head = NULL;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Loopback
+*
+* Set a handler called for each request after its body is consumed and before
+* the response is served. The handler can generate the response for the
+* request by calling qn_http_lpbk_set_response() and qn_http_lpbk_set_header(),
+* or fail the request by setting an error code and returning qn_false.
+*
+* @param [in] lpbk The pointer to the loopback object.
+* @param [in] user_data The data passed to the handler.
+* @param [in] handler_cb The handler, or NULL to serve the set response.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_lpbk_set_handler(qn_http_loopback_ptr restrict lpbk, void * restrict user_data, qn_http_lpbk_handler_callback_fn handler_cb)
+{
+    lpbk->user_data = user_data;
+    lpbk->handler_cb = handler_cb;
+}
+
+QN_SDK qn_uint64 qn_http_lpbk_get_request_count(qn_http_loopback_ptr restrict lpbk)
+{
+    return lpbk->req_cnt;
+}
+
+QN_SDK qn_http_transport_itf qn_http_lpbk_to_transport(qn_http_loopback_ptr restrict lpbk)
 {
-    if (conn) {
-        curl_easy_cleanup(conn->curl);
-        free(conn);
-    } // if
+    return &lpbk->tpt_vtbl;
 }
 
-static size_t qn_http_conn_body_reader(char * ptr, size_t size, size_t nmemb, void * user_data)
+static inline qn_http_loopback_ptr qn_http_lpbk_from_transport(qn_http_transport_itf restrict itf)
 {
-    qn_http_request_ptr req = (qn_http_request_ptr) user_data;
-    return req->body_rdr_cb(req->body_rdr, ptr, size * nmemb);
+    return (qn_http_loopback_ptr)( ( (char *) itf ) - (char *)( &((qn_http_loopback_ptr)0)->tpt_vtbl ) );
 }
 
-static qn_bool qn_http_conn_do_request(qn_http_connection_ptr restrict conn, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+static const char * qn_http_lpbk_reason_phrase(int code)
 {
-    CURLcode curl_code;
-    struct curl_slist * headers = NULL;
-    struct curl_slist * headers2 = NULL;
-    qn_string entry = NULL;
-    qn_http_hdr_iterator_ptr itr;
+    switch (code) {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+    } // switch
+    return (code < 400) ? "OK" : "Error";
+}
 
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_HEADERFUNCTION, qn_http_resp_hdr_wrt_write_cfn)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-        return qn_false;
-    } // if
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_HEADERDATA, resp)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-        return qn_false;
-    } // if
+static qn_bool qn_http_lpbk_render_head(qn_http_loopback_ptr restrict lpbk)
+{
+    qn_http_hdr_iterator_ptr itr;
+    qn_string entry;
+    qn_string head;
+    qn_string new_head;
 
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_WRITEFUNCTION, qn_http_resp_body_wrt_write_cfn)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-        return qn_false;
-    } // if
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_WRITEDATA, resp)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-        return qn_false;
-    } // if
+    head = qn_cs_sprintf("HTTP/1.1 %d %s\r\nContent-Length: %d\r\n", lpbk->code, qn_http_lpbk_reason_phrase(lpbk->code), (int)qn_str_size(lpbk->body));
+    if (!head) return qn_false;
 
-    if (qn_http_hdr_count(req->hdr) > 0) {
-        itr = qn_http_hdr_itr_create(req->hdr);
-        if (!itr) {
-            curl_slist_free_all(headers);
+    if (qn_http_hdr_count(lpbk->hdr) > 0) {
+        if (!(itr = qn_http_hdr_itr_create(lpbk->hdr))) {
+            qn_str_destroy(head);
             return qn_false;
         } // if
 
         while ((entry = qn_http_hdr_itr_next_entry(itr))) {
-            headers2 = curl_slist_append(headers, entry);
-
-            if (!headers2) {
-                curl_slist_free_all(headers);
+            new_head = qn_cs_sprintf("%s%s\r\n", head, entry);
+            qn_str_destroy(head);
+            if (!(head = new_head)) {
                 qn_http_hdr_itr_destroy(itr);
                 return qn_false;
             } // if
-            headers = headers2;
         } // while
-
         qn_http_hdr_itr_destroy(itr);
     } // if
 
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_HTTPHEADER, headers)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-        return qn_false;
+    // ---- The blank line ends the head, and the header callback takes it as the last one.
+    new_head = qn_cs_sprintf("%s\r\n", head);
+    qn_str_destroy(head);
+    if (!new_head) return qn_false;
+    lpbk->head = new_head;
+    return qn_true;
+}
+
+static qn_bool qn_http_lpbk_read_part(qn_http_loopback_ptr restrict lpbk, qn_http_form_part * restrict pt, qn_uint64 * restrict bytes_up)
+{
+    qn_fsize rem = pt->size;
+    size_t size;
+    ssize_t ret;
+
+    while (rem > 0) {
+        size = (rem < sizeof(lpbk->buf)) ? rem : sizeof(lpbk->buf);
+        if (pt->kind == QN_HTTP_FORM_PART_READER) {
+            ret = qn_io_rdr_read((qn_io_reader_itf) pt->src, lpbk->buf, size);
+        } else {
+            ret = qn_http_conn_body_reader(lpbk->buf, 1, size, pt->src);
+            if ((size_t)ret > size) ret = -1;
+        } // if
+        if (ret < 0) {
+            qn_err_comm_set_transmission_failed();
+            return qn_false;
+        } // if
+        if (ret == 0) break;
+        rem -= ret;
+        *bytes_up += ret;
+    } // while
+    return qn_true;
+}
+
+// ---- Consume the body the same way cURL does, so the cost of readers and forms is counted in.
+static qn_bool qn_http_lpbk_consume_body(qn_http_loopback_ptr restrict lpbk, qn_http_request_ptr restrict req, qn_uint64 * restrict bytes_up)
+{
+    qn_http_form_part pt;
+    int i;
+
+    if (req->form) {
+        if (!qn_http_form_prepare_for_sending(req->form)) return qn_false;
+        for (i = 0; i < req->form->cnt; i += 1) {
+            if (req->form->parts[i].kind == QN_HTTP_FORM_PART_READER || req->form->parts[i].kind == QN_HTTP_FORM_PART_FILE_READER) {
+                if (!qn_http_lpbk_read_part(lpbk, &req->form->parts[i], bytes_up)) return qn_false;
+            } else {
+                *bytes_up += req->form->parts[i].size;
+            } // if
+        } // for
+    } else if (req->body_data) {
+        *bytes_up += req->body_size;
+    } else if (req->body_rdr_cb) {
+        memset(&pt, 0, sizeof(pt));
+        pt.kind = QN_HTTP_FORM_PART_FILE_READER;
+        pt.size = req->body_size;
+        pt.src = req;
+        return qn_http_lpbk_read_part(lpbk, &pt, bytes_up);
     } // if
+    return qn_true;
+}
 
-    curl_code = curl_easy_perform(conn->curl);
-    curl_slist_free_all(headers);
-    if (curl_code != CURLE_OK) {
-        switch (curl_code) {
-            case CURLE_COULDNT_CONNECT:
-            case CURLE_OPERATION_TIMEDOUT:
-                qn_err_set_try_again();
-                return qn_false;
+static qn_bool qn_http_lpbk_serve(qn_http_loopback_ptr restrict lpbk, qn_http_response_ptr restrict resp)
+{
+    const char * begin;
+    const char * end;
+    size_t size;
+    qn_size pos;
 
-            case CURLE_COULDNT_RESOLVE_HOST:
-            case CURLE_COULDNT_RESOLVE_PROXY:
-                qn_err_comm_set_dns_failed();
-                return qn_false;
+    if (!lpbk->head && !qn_http_lpbk_render_head(lpbk)) return qn_false;
 
-            case CURLE_SEND_ERROR:
-            case CURLE_RECV_ERROR:
-                qn_err_comm_set_transmission_failed();
-                return qn_false;
+    for (begin = qn_str_cstr(lpbk->head); *begin; begin = end) {
+        end = strstr(begin, "\r\n") + 2;
+        if (qn_http_resp_hdr_wrt_write_cfn((char *) begin, 1, end - begin, resp) != (size_t)(end - begin)) {
+            qn_err_http_set_invalid_header_syntax();
+            return qn_false;
+        } // if
+    } // for
+
+    for (pos = 0; pos < qn_str_size(lpbk->body); pos += size) {
+        // ---- Hand over a writable copy in chunks like cURL, since writers may parse in place.
+        size = qn_str_size(lpbk->body) - pos;
+        if (size > sizeof(lpbk->buf)) size = sizeof(lpbk->buf);
+        memcpy(lpbk->buf, qn_str_cstr(lpbk->body) + pos, size);
+        if (qn_http_resp_body_wrt_write_cfn(lpbk->buf, 1, size, resp) != size) return qn_false;
+    } // for
+    resp->timing.bytes_down = qn_str_size(lpbk->body);
+    return qn_true;
+}
 
-            // case CURLE_HTTP2:
-            // case CURLE_HTTP2_STREAM:
-            // case CURLE_SSL_CONNECT_ERROR:
-            case CURLE_PARTIAL_FILE:
-                qn_err_http_set_mismatching_file_size();
-                return qn_false;
+static qn_bool qn_http_lpbk_do_request(qn_http_loopback_ptr restrict lpbk, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, qn_bool is_post)
+{
+    qn_http_hdr_list headers;
+    qn_uint64 start = qn_tm_monotonic_microseconds();
+    qn_uint64 bytes_up = 0;
+    qn_bool ret;
 
-            default:
-                break;
-        } // switch
+    lpbk->req_cnt += 1;
+    memset(&resp->timing, 0, sizeof(resp->timing));
+
+    // ---- Build the header list as the cURL transport does, for counting its cost in.
+    if (!qn_http_hdr_list_build(req, &headers)) return qn_false;
+    qn_http_hdr_list_release(&headers);
+
+    // ---- Mark the request as sent, as retrying logic tells failures before sending by this phase.
+    resp->timing.pretransfer = qn_tm_monotonic_microseconds() - start + 1;
+
+    if (is_post && !qn_http_lpbk_consume_body(lpbk, req, &bytes_up)) return qn_false;
+    resp->timing.bytes_up = bytes_up;
+
+    if (lpbk->handler_cb && !lpbk->handler_cb(lpbk->user_data, lpbk, url, req)) return qn_false;
+
+    resp->timing.starttransfer = qn_tm_monotonic_microseconds() - start + 1;
+    ret = qn_http_lpbk_serve(lpbk, resp);
+    resp->timing.total = qn_tm_monotonic_microseconds() - start + 1;
+    return ret;
+}
+
+static qn_bool qn_http_lpbk_tpt_get_vfn(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    return qn_http_lpbk_do_request(qn_http_lpbk_from_transport(itf), url, req, resp, qn_false);
+}
+
+static qn_bool qn_http_lpbk_tpt_post_vfn(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    return qn_http_lpbk_do_request(qn_http_lpbk_from_transport(itf), url, req, resp, qn_true);
+}
+
+static qn_http_transport_st qn_http_lpbk_tpt_vtable = {
+    &qn_http_lpbk_tpt_get_vfn,
+    &qn_http_lpbk_tpt_post_vfn
+};
+
+// ---- Definition of HTTP multi ----
+
+typedef struct _QN_HTTP_MULTI_TRANSFER
+{
+    struct _QN_HTTP_MULTI_TRANSFER * prev;
+    struct _QN_HTTP_MULTI_TRANSFER * next;
+
+    CURL * curl;
+    qn_http_hdr_list headers;
+    struct curl_slist * resolves;
+    qn_string url;
+    qn_http_bw_meter meter;
+
+    // ---- Set only for a delayed transfer which waits in the deferred list.
+    qn_bool is_post;
+    qn_uint64 start_time;           // In microseconds of the monotonic clock.
+
+    qn_http_multi_result_st rs;
+} qn_http_multi_transfer, *qn_http_multi_transfer_ptr;
+
+typedef struct _QN_HTTP_MULTI
+{
+    CURLM * multi;
+    int running;
+    qn_http_version_em ver;
+    qn_bool compressed;
+    qn_http_tuning tun;
+
+    // ---- Callbacks of an external event loop, set only when driven by qn_http_multi_socket_action().
+    void * evt_data;
+    qn_http_multi_socket_callback_fn sock_cb;
+    qn_http_multi_timer_callback_fn timer_cb;
+    qn_uint64 curl_timer;           // When the timer asked by cURL expires, in microseconds, or 0 if there is none.
+
+    // ---- Transfers which have been submitted but not done yet.
+    qn_http_multi_transfer_ptr active;
+
+    // ---- Delayed transfers which are not handed to cURL yet.
+    qn_http_multi_transfer_ptr deferred;
+    int deferred_cnt;
+
+    // ---- Transfers which have been done but not completed by the caller yet, in FIFO order.
+    qn_http_multi_transfer_ptr done_first;
+    qn_http_multi_transfer_ptr done_last;
+} qn_http_multi;
+
+static void qn_http_multi_destroy_transfer(qn_http_multi_transfer_ptr restrict tx)
+{
+    qn_http_bw_leave(&tx->meter);
+    qn_http_hdr_list_release(&tx->headers);
+    curl_slist_free_all(tx->resolves);
+    if (tx->curl) qn_http_pool_check_in(tx->url, tx->curl);
+    qn_str_destroy(tx->url);
+    free(tx);
+}
+
+QN_SDK qn_http_multi_ptr qn_http_multi_create(void)
+{
+    qn_http_multi_ptr new_mt = NULL;
+
+    if (!qn_http_pool_init()) return NULL;
+
+    new_mt = calloc(1, sizeof(qn_http_multi));
+    if (!new_mt) {
+        qn_err_set_out_of_memory();
+        return NULL;
     } // if
-    return qn_true;
+
+    new_mt->multi = curl_multi_init();
+    if (!new_mt->multi) {
+        free(new_mt);
+        qn_err_3rdp_set_curl_multi_error_occurred(CURLM_OUT_OF_MEMORY);
+        return NULL;
+    } // if
+    curl_multi_setopt(new_mt->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    return new_mt;
 }
 
-QN_SDK qn_bool qn_http_conn_get(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+QN_SDK void qn_http_multi_destroy(qn_http_multi_ptr restrict mt)
 {
-    CURLcode curl_code;
+    qn_http_multi_transfer_ptr tx;
 
-    curl_easy_reset(conn->curl);
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_POST, 0)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+    if (mt) {
+        while ((tx = mt->active)) {
+            mt->active = tx->next;
+            curl_multi_remove_handle(mt->multi, tx->curl);
+            qn_http_multi_destroy_transfer(tx);
+        } // while
+        while ((tx = mt->done_first)) {
+            mt->done_first = tx->next;
+            qn_http_multi_destroy_transfer(tx);
+        } // while
+        while ((tx = mt->deferred)) {
+            mt->deferred = tx->next;
+            qn_http_multi_destroy_transfer(tx);
+        } // while
+        curl_multi_cleanup(mt->multi);
+        free(mt);
+    } // if
+}
+
+QN_SDK void qn_http_multi_set_version(qn_http_multi_ptr restrict mt, qn_http_version_em ver)
+{
+    mt->ver = ver;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Multi
+*
+* Set the tuning profile of transfers submitted afterwards, the same way as
+* qn_http_conn_set_tuning_profile() does for a connection. Bulk transfers of
+* the multi object share estimates of the bandwidth and round trip time.
+*
+* @param [in] mt The pointer to the multi object.
+* @param [in] prof The tuning profile of following transfers.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_multi_set_tuning_profile(qn_http_multi_ptr restrict mt, qn_http_tuning_profile_em prof)
+{
+    mt->tun.prof = prof;
+}
+
+QN_SDK void qn_http_multi_set_compression(qn_http_multi_ptr restrict mt, qn_bool enable)
+{
+    mt->compressed = enable;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Multi
+*
+* Set whether transfers to the same host may share one HTTP/2 connection, which
+* is enabled by default. Disable it for bulk transfers, so that each of them
+* gets its own TCP window instead of competing in one.
+*
+* @param [in] mt The pointer to the multi object.
+* @param [in] enable Whether to multiplex transfers over HTTP/2 connections.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_http_multi_set_multiplexing(qn_http_multi_ptr restrict mt, qn_bool enable)
+{
+    curl_multi_setopt(mt->multi, CURLMOPT_PIPELINING, (enable) ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+}
+
+// ---- Tell the external event loop the nearer one of the cURL timer and the first delayed transfer.
+static void qn_http_multi_arm_timer(qn_http_multi_ptr restrict mt)
+{
+    qn_http_multi_transfer_ptr tx;
+    qn_uint64 due = mt->curl_timer;
+    qn_uint64 now;
+
+    for (tx = mt->deferred; tx; tx = tx->next) {
+        if (due == 0 || tx->start_time < due) due = tx->start_time;
+    } // for
+
+    if (due == 0) {
+        mt->timer_cb(mt->evt_data, -1);
+        return;
+    } // if
+    now = qn_tm_monotonic_microseconds();
+    mt->timer_cb(mt->evt_data, (due <= now) ? 0 : (long)((due - now + 999) / 1000));
+}
+
+static int qn_http_multi_socket_cfn(CURL * easy, curl_socket_t fd, int what, void * user_data, void * socket_data)
+{
+    qn_http_multi_ptr mt = (qn_http_multi_ptr) user_data;
+    int events = 0;
+
+    switch (what) {
+        case CURL_POLL_IN: events = QN_HTTP_EVENT_IN; break;
+        case CURL_POLL_OUT: events = QN_HTTP_EVENT_OUT; break;
+        case CURL_POLL_INOUT: events = QN_HTTP_EVENT_IN | QN_HTTP_EVENT_OUT; break;
+        case CURL_POLL_REMOVE: events = QN_HTTP_EVENT_REMOVE; break;
+        default: return 0;
+    } // switch
+
+    mt->sock_cb(mt->evt_data, (int)fd, events);
+    return 0;
+}
+
+static int qn_http_multi_timer_cfn(CURLM * multi, long timeout_ms, void * user_data)
+{
+    qn_http_multi_ptr mt = (qn_http_multi_ptr) user_data;
+
+    mt->curl_timer = (timeout_ms < 0) ? 0 : qn_tm_monotonic_microseconds() + (qn_uint64)timeout_ms * 1000 + 1;
+    if (mt->deferred) {
+        qn_http_multi_arm_timer(mt);
+    } else {
+        mt->timer_cb(mt->evt_data, timeout_ms);
+    } // if
+    return 0;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Multi
+*
+* Drive the multi object from an external event loop, like epoll, instead of
+* qn_http_multi_poll(). The multi object tells which sockets to watch and when
+* to time out through the callbacks, and the loop reports activities back by
+* calling qn_http_multi_socket_action(). Finished transfers are fetched by
+* qn_http_multi_complete() as usual.
+*
+* @param [in] mt The pointer to the multi object.
+* @param [in] evt_data The user data passed to both callbacks.
+* @param [in] sock_cb The callback called when a socket should be watched for
+*                     other events, or not be watched any more.
+* @param [in] timer_cb The callback called when the single timer of the multi
+*                      object should be set to the given milliseconds, or be
+*                      deleted if it is -1. A 0 timeout means calling
+*                      qn_http_multi_socket_action() for timeout at once.
+* @retval true The callbacks are set.
+* @retval false Failed in setting callbacks, and an error code is set.
+*
+* @remark Set the callbacks before submitting any transfer, and never mix
+*         qn_http_multi_poll() with qn_http_multi_socket_action().
+*******************************************************************************/
+QN_SDK qn_bool qn_http_multi_set_event_callbacks(qn_http_multi_ptr restrict mt, void * restrict evt_data, qn_http_multi_socket_callback_fn sock_cb, qn_http_multi_timer_callback_fn timer_cb)
+{
+    CURLMcode multi_code;
+
+    mt->evt_data = evt_data;
+    mt->sock_cb = sock_cb;
+    mt->timer_cb = timer_cb;
+
+    if ((multi_code = curl_multi_setopt(mt->multi, CURLMOPT_SOCKETFUNCTION, qn_http_multi_socket_cfn)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
         return qn_false;
     } // if
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_URL, url)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+    if ((multi_code = curl_multi_setopt(mt->multi, CURLMOPT_SOCKETDATA, mt)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
+        return qn_false;
+    } // if
+    if ((multi_code = curl_multi_setopt(mt->multi, CURLMOPT_TIMERFUNCTION, qn_http_multi_timer_cfn)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
+        return qn_false;
+    } // if
+    if ((multi_code = curl_multi_setopt(mt->multi, CURLMOPT_TIMERDATA, mt)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
         return qn_false;
     } // if
-    return qn_http_conn_do_request(conn, req, resp);
+    return qn_true;
 }
 
-QN_SDK qn_bool qn_http_conn_post(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+static qn_http_multi_transfer_ptr qn_http_multi_create_transfer(const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data)
 {
-    CURLcode curl_code;
+    qn_http_multi_transfer_ptr new_tx = NULL;
 
-    curl_easy_reset(conn->curl);
+    new_tx = calloc(1, sizeof(qn_http_multi_transfer));
+    if (!new_tx) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
 
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_POST, 1)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+    new_tx->url = qn_cs_duplicate(url);
+    if (!new_tx->url) {
+        free(new_tx);
+        return NULL;
+    } // if
+
+    new_tx->rs.req = req;
+    new_tx->rs.resp = resp;
+    new_tx->rs.user_data = user_data;
+    return new_tx;
+}
+
+// ---- Hand the transfer to cURL. The caller still owns the transfer if it fails.
+static qn_bool qn_http_multi_start_transfer(qn_http_multi_ptr restrict mt, qn_http_multi_transfer_ptr restrict tx, qn_bool is_post)
+{
+    CURLMcode multi_code;
+    const char * url = qn_str_cstr(tx->url);
+
+    tx->curl = qn_http_pool_check_out(url);
+    if (!tx->curl) return qn_false;
+
+    if (!(is_post ? qn_http_set_post_options(tx->curl, url, tx->rs.req) : qn_http_set_get_options(tx->curl, url, tx->rs.req))) return qn_false;
+    if (!qn_http_set_version_options(tx->curl, mt->ver)) return qn_false;
+    if (!qn_http_set_bandwidth_options(tx->curl, &tx->meter, 0, 0)) return qn_false;
+    if (!qn_http_set_tuning_options(tx->curl, &mt->tun)) return qn_false;
+    if (!qn_http_set_encoding_options(tx->curl, mt->compressed)) return qn_false;
+    if (!qn_http_set_resolve_options(tx->curl, url, &tx->resolves)) return qn_false;
+    if (!qn_http_set_common_options(tx->curl, tx->rs.req, tx->rs.resp, &tx->headers)) return qn_false;
+    curl_easy_setopt(tx->curl, CURLOPT_PRIVATE, tx);
+
+    if ((multi_code = curl_multi_add_handle(mt->multi, tx->curl)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
         return qn_false;
     } // if
-    if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_URL, url)) != CURLE_OK) {
-        qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+
+    tx->prev = NULL;
+    tx->next = mt->active;
+    if (mt->active) mt->active->prev = tx;
+    mt->active = tx;
+    mt->running += 1;
+    return qn_true;
+}
+
+static qn_bool qn_http_multi_submit(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data, qn_bool is_post)
+{
+    qn_http_multi_transfer_ptr new_tx = qn_http_multi_create_transfer(url, req, resp, user_data);
+
+    if (!new_tx) return qn_false;
+    if (!qn_http_multi_start_transfer(mt, new_tx, is_post)) {
+        qn_http_multi_destroy_transfer(new_tx);
         return qn_false;
     } // if
+    return qn_true;
+}
 
-    if (req->form) {
-        if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_HTTPPOST, req->form->first)) != CURLE_OK) {
-            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-            return qn_false;
-        } // if
-        
-        if (req->body_rdr && req->body_rdr_cb) {
-            if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_READFUNCTION, qn_http_conn_body_reader)) != CURLE_OK) {
-                qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-                return qn_false;
-            } // if
+static void qn_http_multi_append_done(qn_http_multi_ptr restrict mt, qn_http_multi_transfer_ptr restrict tx)
+{
+    tx->prev = mt->done_last;
+    tx->next = NULL;
+    if (mt->done_last) mt->done_last->next = tx; else mt->done_first = tx;
+    mt->done_last = tx;
+}
+
+// ---- Hand delayed transfers which are due to cURL. Those failing to start are done with the error, and counted in the return value.
+static int qn_http_multi_start_deferred(qn_http_multi_ptr restrict mt)
+{
+    qn_http_multi_transfer_ptr * link = &mt->deferred;
+    qn_http_multi_transfer_ptr tx;
+    qn_uint64 now;
+    int done_cnt = 0;
+
+    if (!mt->deferred) return 0;
+
+    now = qn_tm_monotonic_microseconds();
+    while ((tx = *link)) {
+        if (tx->start_time > now) {
+            link = &tx->next;
+            continue;
         } // if
-    } else if (req->body_data) {
-        if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_POSTFIELDS, req->body_data)) != CURLE_OK) {
-            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-            return qn_false;
+
+        *link = tx->next;
+        mt->deferred_cnt -= 1;
+        if (!qn_http_multi_start_transfer(mt, tx, tx->is_post)) {
+            tx->rs.err_code = qn_err_get_code();
+            qn_http_multi_append_done(mt, tx);
+            done_cnt += 1;
         } // if
-        if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_POSTFIELDSIZE, req->body_size)) != CURLE_OK) {
-            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
-            return qn_false;
+    } // while
+    return done_cnt;
+}
+
+// ---- Cut the time to wait short, so that no delayed transfer starts late.
+static int qn_http_multi_limit_timeout(qn_http_multi_ptr restrict mt, int timeout_ms)
+{
+    qn_http_multi_transfer_ptr tx;
+    qn_uint64 now = qn_tm_monotonic_microseconds();
+    qn_uint64 wait;
+
+    for (tx = mt->deferred; tx; tx = tx->next) {
+        wait = (tx->start_time <= now) ? 0 : (tx->start_time - now + 999) / 1000;
+        if (wait < (qn_uint64)timeout_ms) timeout_ms = (int)wait;
+    } // for
+    return timeout_ms;
+}
+
+QN_SDK qn_bool qn_http_multi_submit_get(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data)
+{
+    return qn_http_multi_submit(mt, url, req, resp, user_data, qn_false);
+}
+
+QN_SDK qn_bool qn_http_multi_submit_post(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data)
+{
+    return qn_http_multi_submit(mt, url, req, resp, user_data, qn_true);
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Multi
+*
+* Submit a POST transfer which is handed to cURL only after the given delay,
+* e.g. for backing off before retrying. The delay is kept by the multi object's
+* timer instead of sleeping, so other transfers go on in the mean time.
+*
+* @param [in] mt The pointer to the multi object.
+* @param [in] url The URL to post to.
+* @param [in] req The request, which must stay alive until the transfer is
+*                 completed.
+* @param [in] resp The response, which must stay alive until the transfer is
+*                  completed.
+* @param [in] user_data The user data passed back in the result.
+* @param [in] delay_ms The delay in milliseconds, 0 for submitting at once.
+* @retval true The transfer is submitted.
+* @retval false Failed in submitting the transfer, and an error code is set.
+*
+* @remark The transfer is counted as running while waiting. If it fails to
+*         start when the delay expires, qn_http_multi_complete() returns it
+*         with the error code.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_multi_submit_post_delayed(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data, qn_uint32 delay_ms)
+{
+    qn_http_multi_transfer_ptr new_tx;
+
+    if (delay_ms == 0) return qn_http_multi_submit(mt, url, req, resp, user_data, qn_true);
+    if (!(new_tx = qn_http_multi_create_transfer(url, req, resp, user_data))) return qn_false;
+
+    new_tx->is_post = qn_true;
+    new_tx->start_time = qn_tm_monotonic_microseconds() + (qn_uint64)delay_ms * 1000;
+    new_tx->next = mt->deferred;
+    mt->deferred = new_tx;
+    mt->deferred_cnt += 1;
+
+    if (mt->timer_cb) qn_http_multi_arm_timer(mt);
+    return qn_true;
+}
+
+static int qn_http_multi_collect(qn_http_multi_ptr restrict mt)
+{
+    CURLMsg * msg;
+    int msg_cnt = 0;
+    int done_cnt = 0;
+    qn_http_multi_transfer_ptr tx;
+
+    while ((msg = curl_multi_info_read(mt->multi, &msg_cnt))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+
+        tx = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&tx);
+        curl_multi_remove_handle(mt->multi, tx->curl);
+        qn_http_bw_leave(&tx->meter);
+        qn_http_resp_capture_timing(tx->rs.resp, tx->curl);
+
+        // ---- Unlink the transfer from the active list.
+        if (tx->prev) tx->prev->next = tx->next; else mt->active = tx->next;
+        if (tx->next) tx->next->prev = tx->prev;
+
+        // ---- Record the result the same way as qn_http_conn_do_request() does.
+        tx->rs.err_code = (qn_http_check_curl_code(msg->data.result)) ? QN_ERR_SUCCEED : qn_err_get_code();
+        if (msg->data.result == CURLE_OK) {
+            qn_http_tun_measure(&mt->tun, &tx->rs.resp->timing);
+            qn_http_dns_record_family(tx->url, tx->curl);
         } // if
-    } else {
-        if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_READFUNCTION, qn_http_conn_body_reader)) != CURLE_OK) {
-            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+
+        qn_http_hdr_list_release(&tx->headers);
+        curl_slist_free_all(tx->resolves);
+        tx->resolves = NULL;
+        qn_http_pool_check_in(tx->url, tx->curl);
+        tx->curl = NULL;
+
+        // ---- Append the transfer to the done queue.
+        qn_http_multi_append_done(mt, tx);
+        done_cnt += 1;
+    } // while
+    return done_cnt;
+}
+
+QN_SDK qn_bool qn_http_multi_poll(qn_http_multi_ptr restrict mt, int timeout_ms, int * restrict running)
+{
+    CURLMcode multi_code;
+    int done_cnt = qn_http_multi_start_deferred(mt);
+
+    if ((multi_code = curl_multi_perform(mt->multi, &mt->running)) != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
+        return qn_false;
+    } // if
+
+    done_cnt += qn_http_multi_collect(mt);
+    if (done_cnt == 0 && (mt->running > 0 || mt->deferred) && timeout_ms > 0) {
+        // ---- Nothing is done yet, wait for activities on any transfer, or the first delayed one to start.
+        if ((multi_code = curl_multi_poll(mt->multi, NULL, 0, qn_http_multi_limit_timeout(mt, timeout_ms), NULL)) != CURLM_OK) {
+            qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
             return qn_false;
         } // if
-        if ((curl_code = curl_easy_setopt(conn->curl, CURLOPT_READDATA, req)) != CURLE_OK) {
-            qn_err_3rdp_set_curl_easy_error_occurred(curl_code);
+        qn_http_multi_start_deferred(mt);
+        if ((multi_code = curl_multi_perform(mt->multi, &mt->running)) != CURLM_OK) {
+            qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
             return qn_false;
         } // if
-    } // form
+        qn_http_multi_collect(mt);
+    } // if
+
+    if (running) *running = mt->running + mt->deferred_cnt;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup HTTP-Multi
+*
+* Let the multi object handle activities on a socket, or its timer expiring,
+* when it is driven by an external event loop.
+*
+* @param [in] mt The pointer to the multi object.
+* @param [in] fd The socket which is ready, or QN_HTTP_MULTI_TIMEOUT_FD if the
+*                timer expires.
+* @param [in] events The QN_HTTP_EVENT_IN, QN_HTTP_EVENT_OUT and
+*                    QN_HTTP_EVENT_ERROR bits reported by the event loop, or 0
+*                    to let the multi object find them out.
+* @param [out] running The number of transfers still running, NULL is allowed.
+* @retval true Activities are handled, and finished transfers can be fetched
+*              by qn_http_multi_complete().
+* @retval false Failed in handling activities, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_http_multi_socket_action(qn_http_multi_ptr restrict mt, int fd, int events, int * restrict running)
+{
+    CURLMcode multi_code;
+    int ev_bitmask = 0;
+
+    if (events & QN_HTTP_EVENT_IN) ev_bitmask |= CURL_CSELECT_IN;
+    if (events & QN_HTTP_EVENT_OUT) ev_bitmask |= CURL_CSELECT_OUT;
+    if (events & QN_HTTP_EVENT_ERROR) ev_bitmask |= CURL_CSELECT_ERR;
+
+    // ---- The cURL timer is used up once it expires, and cURL asks for a new one in the action if needed.
+    if (fd < 0 && mt->curl_timer != 0 && mt->curl_timer <= qn_tm_monotonic_microseconds()) mt->curl_timer = 0;
+    qn_http_multi_start_deferred(mt);
+
+    multi_code = curl_multi_socket_action(mt->multi, (fd < 0) ? CURL_SOCKET_TIMEOUT : (curl_socket_t)fd, ev_bitmask, &mt->running);
+    if (multi_code != CURLM_OK) {
+        qn_err_3rdp_set_curl_multi_error_occurred(multi_code);
+        return qn_false;
+    } // if
+
+    qn_http_multi_collect(mt);
+    if (fd < 0 && mt->deferred) qn_http_multi_arm_timer(mt);
+    if (running) *running = mt->running + mt->deferred_cnt;
+    return qn_true;
+}
+
+QN_SDK qn_bool qn_http_multi_complete(qn_http_multi_ptr restrict mt, qn_http_multi_result_ptr restrict rs)
+{
+    qn_http_multi_transfer_ptr tx = mt->done_first;
+
+    if (!tx) {
+        // ---- No transfer is done, call qn_http_multi_poll() and try again.
+        qn_err_set_try_again();
+        return qn_false;
+    } // if
 
-    return qn_http_conn_do_request(conn, req, resp);
+    mt->done_first = tx->next;
+    if (!mt->done_first) mt->done_last = NULL;
+
+    *rs = tx->rs;
+    qn_http_multi_destroy_transfer(tx);
+    return qn_true;
 }
 
 #ifdef __cplusplus
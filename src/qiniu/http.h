@@ -2,6 +2,7 @@
 #define __QN_HTTP_H__
 
 #include "qiniu/base/string.h"
+#include "qiniu/base/errors.h"
 #include "qiniu/base/json.h"
 #include "qiniu/http_header.h"
 #include "qiniu/os/file.h"
@@ -52,6 +53,7 @@ static inline qn_bool qn_http_form_add_string(qn_http_form_ptr restrict form, co
 
 QN_SDK extern qn_bool qn_http_form_add_file(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict fname_utf8, qn_fsize fsize, const char * restrict mime_type);
 QN_SDK extern qn_bool qn_http_form_add_file_reader(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict fname_utf8, qn_fsize fsize, const char * restrict mime_type, void * restrict req);
+QN_SDK extern qn_bool qn_http_form_add_reader(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname_utf8, qn_io_reader_itf restrict rdr, const char * restrict mime_type);
 QN_SDK extern qn_bool qn_http_form_add_buffer(qn_http_form_ptr restrict form, const char * restrict field, const char * restrict fname, const char * restrict buf, qn_size buf_size, const char * restrict mime_type);
 
 // ---- Declaration of HTTP request ----
@@ -59,6 +61,9 @@ QN_SDK extern qn_bool qn_http_form_add_buffer(qn_http_form_ptr restrict form, co
 struct _QN_HTTP_REQUEST;
 typedef struct _QN_HTTP_REQUEST * qn_http_request_ptr;
 
+struct _QN_HTTP_REQ_TEMPLATE;
+typedef struct _QN_HTTP_REQ_TEMPLATE * qn_http_req_template_ptr;
+
 QN_SDK extern qn_http_request_ptr qn_http_req_create(void);
 QN_SDK extern void qn_http_req_destroy(qn_http_request_ptr restrict req);
 QN_SDK extern void qn_http_req_reset(qn_http_request_ptr restrict req);
@@ -84,8 +89,31 @@ QN_SDK extern void qn_http_req_set_body_reader(qn_http_request_ptr restrict req,
 QN_SDK extern const char * qn_http_req_body_data(qn_http_request_ptr restrict req);
 QN_SDK extern qn_fsize qn_http_req_body_size(qn_http_request_ptr restrict req);
 
+// ---- Declaration of HTTP request template ----
+
+QN_SDK extern qn_http_req_template_ptr qn_http_req_tmpl_create(void);
+QN_SDK extern void qn_http_req_tmpl_destroy(qn_http_req_template_ptr restrict tmpl);
+
+QN_SDK extern qn_bool qn_http_req_tmpl_set_header(qn_http_req_template_ptr restrict tmpl, const char * restrict hdr, const char * restrict val);
+
+QN_SDK extern void qn_http_req_set_template(qn_http_request_ptr restrict req, qn_http_req_template_ptr restrict tmpl);
+
 // ---- Declaration of HTTP response ----
 
+typedef struct _QN_HTTP_TIMING
+{
+    // ---- Durations in microseconds from the start of the request to the end of each phase.
+    qn_uint64 namelookup;
+    qn_uint64 connect;
+    qn_uint64 appconnect;
+    qn_uint64 pretransfer;
+    qn_uint64 starttransfer;
+    qn_uint64 total;
+
+    qn_uint64 bytes_up;
+    qn_uint64 bytes_down;
+} qn_http_timing_st, *qn_http_timing_ptr;
+
 struct _QN_HTTP_RESPONSE;
 typedef struct _QN_HTTP_RESPONSE * qn_http_response_ptr;
 
@@ -97,6 +125,7 @@ QN_SDK extern void qn_http_resp_reset(qn_http_response_ptr restrict resp);
 
 QN_SDK extern int qn_http_resp_get_code(qn_http_response_ptr restrict resp);
 QN_SDK extern int qn_http_resp_get_writer_retcode(qn_http_response_ptr restrict resp);
+QN_SDK extern const qn_http_timing_st * qn_http_resp_get_timing(qn_http_response_ptr restrict resp);
 
 // ----
 
@@ -109,6 +138,72 @@ QN_SDK extern void qn_http_resp_unset_header(qn_http_response_ptr restrict resp,
 // ----
 
 QN_SDK extern void qn_http_resp_set_data_writer(qn_http_response_ptr restrict resp, void * restrict body_writer, qn_http_data_writer_callback_fn body_writer_cb);
+QN_SDK extern void qn_http_resp_set_stream_writer(qn_http_response_ptr restrict resp, qn_io_writer_itf restrict body_stm);
+QN_SDK extern void qn_http_resp_set_file_writer(qn_http_response_ptr restrict resp, qn_fl_writer_ptr restrict fl_wrt);
+
+// ---- Declaration of HTTP DNS cache ----
+
+QN_SDK extern qn_bool qn_http_dns_resolve(const char * restrict url, int ttl);
+QN_SDK extern qn_bool qn_http_dns_add_host(const char * restrict url, int ttl);
+QN_SDK extern void qn_http_dns_reset(void);
+
+// ---- Declaration of HTTP TLS session cache ----
+
+QN_SDK extern qn_bool qn_http_ssls_load(const char * restrict fname);
+QN_SDK extern qn_bool qn_http_ssls_save(const char * restrict fname);
+
+// ---- Declaration of HTTP connection pool ----
+
+QN_SDK extern qn_bool qn_http_pool_init(void);
+QN_SDK extern void qn_http_pool_cleanup(void);
+
+// ---- Declaration of HTTP bandwidth limiter ----
+
+QN_SDK extern void qn_http_bw_set_global_limits(qn_uint64 up_bps, qn_uint64 down_bps);
+
+// ---- Declaration of HTTP version ----
+
+typedef enum _QN_HTTP_VERSION
+{
+    QN_HTTP_VERSION_DEFAULT = 0,            // Let cURL decide, usually HTTP/1.1.
+    QN_HTTP_VERSION_1_1 = 1,
+    QN_HTTP_VERSION_2 = 2,                  // HTTP/2 over TLS, fall back to HTTP/1.1 for plain HTTP.
+    QN_HTTP_VERSION_2_PRIOR_KNOWLEDGE = 3   // HTTP/2 without upgrade, for h2c servers.
+} qn_http_version_em;
+
+// ---- Declaration of HTTP tuning profile ----
+
+typedef enum _QN_HTTP_TUNING_PROFILE
+{
+    QN_HTTP_TUNING_DEFAULT = 0,         // Leave buffers and socket options to cURL.
+    QN_HTTP_TUNING_INTERACTIVE = 1,     // Small buffers for short API calls, e.g. stat or list.
+    QN_HTTP_TUNING_BULK = 2             // Large buffers sized from the measured throughput, for file data.
+} qn_http_tuning_profile_em;
+
+// ---- Declaration of HTTP transport ----
+
+struct _QN_HTTP_TRANSPORT;
+typedef struct _QN_HTTP_TRANSPORT * qn_http_transport_ptr;
+typedef qn_http_transport_ptr * qn_http_transport_itf;
+
+typedef qn_bool (*qn_http_tpt_get_virtual_fn)(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp);
+typedef qn_bool (*qn_http_tpt_post_virtual_fn)(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp);
+
+typedef struct _QN_HTTP_TRANSPORT
+{
+    qn_http_tpt_get_virtual_fn get;
+    qn_http_tpt_post_virtual_fn post;
+} qn_http_transport_st;
+
+static inline qn_bool qn_http_tpt_get(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    return (*itf)->get(itf, url, req, resp);
+}
+
+static inline qn_bool qn_http_tpt_post(qn_http_transport_itf restrict itf, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp)
+{
+    return (*itf)->post(itf, url, req, resp);
+}
 
 // ---- Declaration of HTTP connection ----
 
@@ -118,9 +213,80 @@ typedef struct _QN_HTTP_CONNECTION * qn_http_connection_ptr;
 QN_SDK extern qn_http_connection_ptr qn_http_conn_create(void);
 QN_SDK extern void qn_http_conn_destroy(qn_http_connection_ptr restrict conn);
 
+QN_SDK extern void qn_http_conn_set_version(qn_http_connection_ptr restrict conn, qn_http_version_em ver);
+QN_SDK extern void qn_http_conn_set_bandwidth_limits(qn_http_connection_ptr restrict conn, qn_uint64 up_bps, qn_uint64 down_bps);
+QN_SDK extern void qn_http_conn_set_transport(qn_http_connection_ptr restrict conn, qn_http_transport_itf restrict tpt);
+QN_SDK extern void qn_http_conn_set_tuning_profile(qn_http_connection_ptr restrict conn, qn_http_tuning_profile_em prof);
+QN_SDK extern void qn_http_conn_set_compression(qn_http_connection_ptr restrict conn, qn_bool enable);
+
 QN_SDK extern qn_bool qn_http_conn_get(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp);
 QN_SDK extern qn_bool qn_http_conn_post(qn_http_connection_ptr restrict conn, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp);
 
+QN_SDK extern qn_bool qn_http_conn_prewarm(qn_http_connection_ptr restrict conn, const char ** restrict urls, int cnt, int timeout_ms);
+
+// ---- Declaration of HTTP loopback transport ----
+
+struct _QN_HTTP_LOOPBACK;
+typedef struct _QN_HTTP_LOOPBACK * qn_http_loopback_ptr;
+
+typedef qn_bool (*qn_http_lpbk_handler_callback_fn)(void * restrict user_data, qn_http_loopback_ptr restrict lpbk, const char * restrict url, qn_http_request_ptr restrict req);
+
+QN_SDK extern qn_http_loopback_ptr qn_http_lpbk_create(void);
+QN_SDK extern void qn_http_lpbk_destroy(qn_http_loopback_ptr restrict lpbk);
+
+QN_SDK extern qn_bool qn_http_lpbk_set_response(qn_http_loopback_ptr restrict lpbk, int code, const char * restrict body, qn_size body_size);
+QN_SDK extern qn_bool qn_http_lpbk_set_header(qn_http_loopback_ptr restrict lpbk, const char * restrict hdr, const char * restrict val);
+QN_SDK extern void qn_http_lpbk_set_handler(qn_http_loopback_ptr restrict lpbk, void * restrict user_data, qn_http_lpbk_handler_callback_fn handler_cb);
+
+QN_SDK extern qn_uint64 qn_http_lpbk_get_request_count(qn_http_loopback_ptr restrict lpbk);
+QN_SDK extern qn_http_transport_itf qn_http_lpbk_to_transport(qn_http_loopback_ptr restrict lpbk);
+
+// ---- Declaration of HTTP multi ----
+
+struct _QN_HTTP_MULTI;
+typedef struct _QN_HTTP_MULTI * qn_http_multi_ptr;
+
+typedef struct _QN_HTTP_MULTI_RESULT
+{
+    qn_http_request_ptr req;
+    qn_http_response_ptr resp;
+    void * user_data;
+
+    // ---- QN_ERR_SUCCEED if the transfer is done, or the error code the blocking API would set.
+    qn_err_code_em err_code;
+} qn_http_multi_result_st, *qn_http_multi_result_ptr;
+
+enum
+{
+    QN_HTTP_EVENT_IN = 0x1,
+    QN_HTTP_EVENT_OUT = 0x2,
+    QN_HTTP_EVENT_ERROR = 0x4,          // Only reported by the event loop.
+    QN_HTTP_EVENT_REMOVE = 0x8,         // Only asked by the multi object, stop watching the socket.
+
+    QN_HTTP_MULTI_TIMEOUT_FD = -1
+};
+
+typedef void (*qn_http_multi_socket_callback_fn)(void * restrict evt_data, int fd, int events);
+typedef void (*qn_http_multi_timer_callback_fn)(void * restrict evt_data, long timeout_ms);
+
+QN_SDK extern qn_http_multi_ptr qn_http_multi_create(void);
+QN_SDK extern void qn_http_multi_destroy(qn_http_multi_ptr restrict mt);
+
+QN_SDK extern void qn_http_multi_set_version(qn_http_multi_ptr restrict mt, qn_http_version_em ver);
+QN_SDK extern void qn_http_multi_set_compression(qn_http_multi_ptr restrict mt, qn_bool enable);
+QN_SDK extern void qn_http_multi_set_tuning_profile(qn_http_multi_ptr restrict mt, qn_http_tuning_profile_em prof);
+QN_SDK extern void qn_http_multi_set_multiplexing(qn_http_multi_ptr restrict mt, qn_bool enable);
+
+QN_SDK extern qn_bool qn_http_multi_submit_get(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data);
+QN_SDK extern qn_bool qn_http_multi_submit_post(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data);
+QN_SDK extern qn_bool qn_http_multi_submit_post_delayed(qn_http_multi_ptr restrict mt, const char * restrict url, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, void * restrict user_data, qn_uint32 delay_ms);
+
+QN_SDK extern qn_bool qn_http_multi_poll(qn_http_multi_ptr restrict mt, int timeout_ms, int * restrict running);
+
+QN_SDK extern qn_bool qn_http_multi_set_event_callbacks(qn_http_multi_ptr restrict mt, void * restrict evt_data, qn_http_multi_socket_callback_fn sock_cb, qn_http_multi_timer_callback_fn timer_cb);
+QN_SDK extern qn_bool qn_http_multi_socket_action(qn_http_multi_ptr restrict mt, int fd, int events, int * restrict running);
+QN_SDK extern qn_bool qn_http_multi_complete(qn_http_multi_ptr restrict mt, qn_http_multi_result_ptr restrict rs);
+
 #ifdef __cplusplus
 }
 #endif
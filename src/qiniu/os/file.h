@@ -39,9 +39,12 @@ QN_SDK extern ssize_t qn_fl_read(qn_file_ptr restrict fl, char * restrict buf, s
 QN_SDK extern qn_bool qn_fl_seek(qn_file_ptr restrict fl, qn_foffset offset);
 QN_SDK extern qn_bool qn_fl_advance(qn_file_ptr restrict fl, qn_foffset delta);
 QN_SDK extern ssize_t qn_fl_write(qn_file_ptr restrict fl, char * restrict buf, size_t buf_size);
+QN_SDK extern void qn_fl_prefetch(qn_file_ptr restrict fl, qn_foffset offset, size_t size);
 
 QN_SDK extern size_t qn_fl_reader_read_cfn(void * restrict user_data, char * restrict buf, size_t buf_size);
 
+QN_SDK extern qn_bool qn_fl_sync_directory(const char * restrict fname);
+
 // ---- Declaration of file info ----
 
 struct _QN_FL_INFO;
@@ -68,9 +71,37 @@ QN_SDK extern ssize_t qn_fl_sec_peek(qn_fl_section_ptr restrict fs, char * restr
 QN_SDK extern ssize_t qn_fl_sec_read(qn_fl_section_ptr restrict fs, char * restrict buf, size_t buf_size);
 QN_SDK extern qn_bool qn_fl_sec_seek(qn_fl_section_ptr restrict fs, qn_foffset offset);
 QN_SDK extern qn_bool qn_fl_sec_advance(qn_fl_section_ptr restrict fs, qn_foffset delta);
+QN_SDK extern void qn_fl_sec_prefetch(qn_fl_section_ptr restrict fs, qn_foffset offset, size_t size);
 
 QN_SDK extern size_t qn_fl_sec_reader_read_cfn(void * restrict user_data, char * restrict buf, size_t buf_size);
 
+// ---- Declaration of file writer ----
+
+struct _QN_FL_WRITER;
+typedef struct _QN_FL_WRITER * qn_fl_writer_ptr;
+
+enum
+{
+    QN_FL_WRT_TRUNCATE = 0x1
+};
+
+QN_SDK extern qn_fl_writer_ptr qn_fl_wrt_open(const char * restrict fname, qn_fsize fsize, qn_foffset offset, int flags);
+QN_SDK extern void qn_fl_wrt_close(qn_fl_writer_ptr restrict wrt);
+
+QN_SDK extern qn_fl_writer_ptr qn_fl_wrt_duplicate(qn_fl_writer_ptr restrict wrt);
+
+QN_SDK extern qn_io_writer_itf qn_fl_wrt_to_io_writer(qn_fl_writer_ptr restrict wrt);
+
+QN_SDK extern qn_foffset qn_fl_wrt_offset(qn_fl_writer_ptr restrict wrt);
+QN_SDK extern qn_bool qn_fl_wrt_seek(qn_fl_writer_ptr restrict wrt, qn_foffset offset);
+QN_SDK extern ssize_t qn_fl_wrt_write(qn_fl_writer_ptr restrict wrt, const char * restrict buf, size_t buf_size);
+QN_SDK extern qn_bool qn_fl_wrt_flush(qn_fl_writer_ptr restrict wrt);
+QN_SDK extern qn_bool qn_fl_wrt_sync(qn_fl_writer_ptr restrict wrt);
+
+QN_SDK extern qn_bool qn_fl_wrt_reserve(qn_fl_writer_ptr restrict wrt, qn_fsize fsize);
+QN_SDK extern qn_bool qn_fl_wrt_set_direct_io(qn_fl_writer_ptr restrict wrt, qn_bool enable);
+QN_SDK extern void qn_fl_wrt_set_sync_interval(qn_fl_writer_ptr restrict wrt, qn_fsize intv);
+
 #ifdef __cplusplus
 }
 #endif
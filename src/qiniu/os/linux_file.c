@@ -4,6 +4,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdio.h>
+#include <string.h>
 
 #if defined(QN_CFG_LARGE_FILE_SUPPORT_AWARE)
 #include <dlfcn.h>
@@ -176,6 +178,11 @@ static qn_io_reader_itf qn_fl_rdr_section_vfn(qn_io_reader_itf restrict itf, qn_
     return qn_fl_sec_to_io_reader(new_file);
 }
 
+static void qn_fl_rdr_prefetch_vfn(qn_io_reader_itf restrict itf, qn_foffset offset, size_t size)
+{
+    qn_fl_prefetch(qn_fl_from_io_reader(itf), offset, size);
+}
+
 static qn_io_reader_st qn_fl_rdr_vtable = {
     &qn_fl_rdr_close_vfn,
     &qn_fl_rdr_peek_vfn,
@@ -185,7 +192,8 @@ static qn_io_reader_st qn_fl_rdr_vtable = {
     &qn_fl_rdr_duplicate_vfn,
     &qn_fl_rdr_section_vfn,
     &qn_fl_rdr_name_vfn,
-    &qn_fl_rdr_size_vfn
+    &qn_fl_rdr_size_vfn,
+    &qn_fl_rdr_prefetch_vfn
 };
 
 QN_SDK qn_file_ptr qn_fl_open(const char * restrict fname, qn_fl_open_extra_ptr restrict extra)
@@ -307,6 +315,16 @@ QN_SDK ssize_t qn_fl_write(qn_file_ptr restrict fl, char * restrict buf, size_t
     return ret;
 }
 
+QN_SDK void qn_fl_prefetch(qn_file_ptr restrict fl, qn_foffset offset, size_t size)
+{
+    // ---- Only a hint, the kernel starts reading the range into the page cache and returns without waiting for it.
+#if defined(QN_CFG_LARGE_FILE_SUPPORT)
+    posix_fadvise64(fl->fd, offset, size, POSIX_FADV_WILLNEED);
+#else
+    posix_fadvise(fl->fd, (off_t)offset, size, POSIX_FADV_WILLNEED);
+#endif
+}
+
 QN_SDK qn_fl_section_ptr qn_fl_section(qn_file_ptr restrict fl, qn_foffset offset, size_t sec_size)
 {
     qn_fl_section_ptr new_sec = qn_fl_sec_create(fl, offset, sec_size);
@@ -320,6 +338,48 @@ QN_SDK size_t qn_fl_reader_read_cfn(void * restrict user_data, char * restrict b
     return qn_fl_read(fl, buf, buf_size);
 }
 
+/***************************************************************************//**
+* @ingroup File
+*
+* Sync the directory holding the given file, so that a file created in it, or
+* renamed into it, is still there after a crash.
+*
+* @param [in] fname The name of the file, whose directory is synced.
+* @retval true The directory entries are on the disk.
+* @retval false Failed in syncing, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_fl_sync_directory(const char * restrict fname)
+{
+    const char * slash = strrchr(fname, '/');
+    qn_string dname;
+    int fd;
+    int ret;
+
+    if (!slash) {
+        dname = qn_cs_duplicate(".");
+    } else if (slash == fname) {
+        dname = qn_cs_duplicate("/");
+    } else {
+        dname = qn_cs_clone(fname, slash - fname);
+    } // if
+    if (!dname) return qn_false;
+
+    fd = open(qn_str_cstr(dname), O_RDONLY | O_DIRECTORY);
+    qn_str_destroy(dname);
+    if (fd < 0) {
+        qn_err_fl_set_opening_file_failed();
+        return qn_false;
+    } // if
+
+    ret = fsync(fd);
+    close(fd);
+    if (ret < 0) {
+        qn_err_fl_set_writing_file_failed();
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
 // ---- Definition of file info depends on operating system ----
 
 QN_SDK qn_fl_info_ptr qn_fl_info_stat(const char * restrict fname)
@@ -403,6 +463,11 @@ static qn_io_reader_itf qn_fl_sec_rdr_section_vfn(qn_io_reader_itf restrict itf,
     return qn_fl_sec_to_io_reader(new_section);
 }
 
+static void qn_fl_sec_rdr_prefetch_vfn(qn_io_reader_itf restrict itf, qn_foffset offset, size_t size)
+{
+    qn_fl_sec_prefetch(qn_fl_sec_from_io_reader(itf), offset, size);
+}
+
 static qn_io_reader_st qn_fl_sec_rdr_vtable = {
     &qn_fl_sec_rdr_close_vfn,
     &qn_fl_sec_rdr_peek_vfn,
@@ -410,19 +475,34 @@ static qn_io_reader_st qn_fl_sec_rdr_vtable = {
     &qn_fl_sec_rdr_seek_vfn,
     &qn_fl_sec_rdr_advance_vfn,
     &qn_fl_sec_rdr_duplicate_vfn,
-    &qn_fl_sec_rdr_section_vfn
+    &qn_fl_sec_rdr_section_vfn,
+    NULL, // NAME
+    NULL, // SIZE
+    &qn_fl_sec_rdr_prefetch_vfn
 };
 
 QN_SDK qn_fl_section_ptr qn_fl_sec_create(qn_file_ptr restrict fl, qn_foffset offset, size_t sec_size)
 {
-    qn_fl_section_ptr new_section = calloc(1, sizeof(qn_fl_section_st));
+    qn_fl_section_ptr new_section;
+
+    if (qn_fl_fsize(fl) <= offset) {
+        qn_err_set_out_of_range();
+        return NULL;
+    } // if
+
+    new_section = calloc(1, sizeof(qn_fl_section_st));
     if (!new_section) {
         qn_err_set_out_of_memory();
         return NULL;
     } // if
 
+    // ---- Sections read by position and never move the file offset, so sharing the fd only saves a dup().
 #if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
     new_section->file = qn_fl_duplicate(fl);
+    if (!new_section->file) {
+        free(new_section);
+        return NULL;
+    } // if
 #else
     new_section->file = fl;
 #endif
@@ -431,16 +511,6 @@ QN_SDK qn_fl_section_ptr qn_fl_sec_create(qn_file_ptr restrict fl, qn_foffset of
     new_section->sec_size = sec_size;
     new_section->rem_size = sec_size;
 
-    if (qn_fl_fsize(fl) <= offset) {
-        qn_err_set_out_of_range();
-        return NULL;
-    } // if
-
-    if (! qn_fl_sec_seek(new_section, offset)) {
-        qn_fl_sec_destroy(new_section);
-        return NULL;
-    } // if
-
     new_section->rdr_vtbl = &qn_fl_sec_rdr_vtable;
     return new_section;
 }
@@ -470,10 +540,6 @@ QN_SDK void qn_fl_sec_destroy(qn_fl_section_ptr restrict fs)
 
 QN_SDK qn_bool qn_fl_sec_reset(qn_fl_section_ptr restrict fs)
 {
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-    if (! qn_fl_seek(fs->file, fs->offset)) return qn_false;
-#endif
-
     fs->rem_size = fs->sec_size;
     return qn_true;
 }
@@ -492,19 +558,11 @@ QN_SDK ssize_t qn_fl_sec_peek(qn_fl_section_ptr restrict fs, char * restrict buf
 
     read_size = (buf_size < fs->rem_size) ? buf_size : fs->rem_size;
 
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-    ret = read(fs->file->fd, buf, read_size); 
-    if (ret > 0 && !qn_fl_sec_advance(fs, -read_size)) return QN_IO_RDR_READING_FAILED;
-#else
     ret = pread(fs->file->fd, buf, read_size, fs->offset + (fs->sec_size - fs->rem_size));
-#endif
-
     if (ret < 0) {
         qn_err_fl_set_reading_file_failed();
         return QN_IO_RDR_READING_FAILED;
     } // if
-
-    fs->rem_size -= ret;
     return ret;
 }
 
@@ -517,11 +575,8 @@ QN_SDK ssize_t qn_fl_sec_read(qn_fl_section_ptr restrict fs, char * restrict buf
 
     read_size = (buf_size < fs->rem_size) ? buf_size : fs->rem_size;
 
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-    ret = read(fs->file->fd, buf, read_size); 
-#else
+    // ---- Read by position, since descriptors duplicated by dup() share one file offset, and sections of a file may be read in turn.
     ret = pread(fs->file->fd, buf, read_size, fs->offset + (fs->sec_size - fs->rem_size));
-#endif
 
     if (ret < 0) {
         qn_err_fl_set_reading_file_failed();
@@ -532,22 +587,21 @@ QN_SDK ssize_t qn_fl_sec_read(qn_fl_section_ptr restrict fs, char * restrict buf
     return ret;
 }
 
+QN_SDK void qn_fl_sec_prefetch(qn_fl_section_ptr restrict fs, qn_foffset offset, size_t size)
+{
+    // ---- The offset is relative to the beginning of the section, and the range never goes beyond its end.
+    if (offset < 0 || fs->sec_size <= offset) return;
+    if (fs->sec_size - offset < size) size = fs->sec_size - offset;
+    qn_fl_prefetch(fs->file, fs->offset + offset, size);
+}
+
 QN_SDK qn_bool qn_fl_sec_seek(qn_fl_section_ptr restrict fs, qn_foffset offset)
 {
     if (offset < fs->offset) {
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-        if (! qn_fl_seek(fs->file, fs->offset)) return qn_false;
-#endif
         fs->rem_size = fs->sec_size;
     } else if (offset > fs->offset + fs->sec_size) {
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-        if (! qn_fl_seek(fs->file, fs->offset + fs->sec_size)) return qn_false;
-#endif
         fs->rem_size = 0;
     } else {
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-        if (! qn_fl_seek(fs->file, offset)) return qn_false;
-#endif
         fs->rem_size = fs->offset + fs->sec_size - offset;
     } // if
     return qn_true;
@@ -556,14 +610,8 @@ QN_SDK qn_bool qn_fl_sec_seek(qn_fl_section_ptr restrict fs, qn_foffset offset)
 QN_SDK qn_bool qn_fl_sec_advance(qn_fl_section_ptr restrict fs, qn_foffset delta)
 {
     if (delta <= fs->rem_size) {
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-        if (! qn_fl_advance(fs->file, delta)) return qn_false;
-#endif
         fs->rem_size -= delta;
     } else {
-#if ! defined(QN_CFG_SHARED_FD_FOR_SECTIONS)
-        if (! qn_fl_advance(fs->file, fs->rem_size)) return qn_false;
-#endif
         fs->rem_size = 0;
     } // if
     return qn_true;
@@ -577,6 +625,457 @@ QN_SDK size_t qn_fl_sec_reader_read_cfn(void * restrict user_data, char * restri
     return ret;
 }
 
+// ---- Definition of file writer depends on operating system ----
+
+#define QN_FL_WRT_DIRECT_ALIGNMENT 4096
+#define QN_FL_WRT_DIRECT_BUFFER_SIZE (1024 * 1024)
+
+typedef struct _QN_FL_WRITER
+{
+    qn_io_writer_ptr wrt_vtbl;
+    int fd;
+    qn_foffset offset;              // Where the next byte lands, including bytes still in the direct buffer.
+
+    // ---- Direct I/O, aligned blocks go through a separate O_DIRECT descriptor.
+    int dio_fd;
+    char * dio_buf;
+    size_t dio_used;
+
+    // ---- Write-back control, in bytes of sequential writes.
+    qn_fsize sync_intv;
+    qn_foffset sync_begin;          // The start of the range not scheduled for write-back yet.
+    qn_foffset prev_begin;          // The range scheduled last time, dropped from the page cache next time.
+    qn_fsize prev_size;
+} qn_fl_writer_st;
+
+static inline qn_fl_writer_ptr qn_fl_wrt_from_io_writer(qn_io_writer_itf restrict itf)
+{
+    return (qn_fl_writer_ptr)( ( (char *) itf ) - (char *)( &((qn_fl_writer_ptr)0)->wrt_vtbl ) );
+}
+
+static void qn_fl_wrt_wrt_close_vfn(qn_io_writer_itf restrict itf)
+{
+    qn_fl_wrt_close(qn_fl_wrt_from_io_writer(itf));
+}
+
+static ssize_t qn_fl_wrt_wrt_write_vfn(qn_io_writer_itf restrict itf, const char * restrict buf, size_t buf_size)
+{
+    return qn_fl_wrt_write(qn_fl_wrt_from_io_writer(itf), buf, buf_size);
+}
+
+static qn_io_writer_itf qn_fl_wrt_wrt_duplicate_vfn(qn_io_writer_itf restrict itf)
+{
+    qn_fl_writer_ptr new_wrt = qn_fl_wrt_duplicate(qn_fl_wrt_from_io_writer(itf));
+    if (!new_wrt) return NULL;
+    return qn_fl_wrt_to_io_writer(new_wrt);
+}
+
+static qn_io_writer_st qn_fl_wrt_wrt_vtable = {
+    &qn_fl_wrt_wrt_close_vfn,
+    &qn_fl_wrt_wrt_write_vfn,
+    &qn_fl_wrt_wrt_duplicate_vfn
+};
+
+static inline ssize_t qn_fl_pwrite_wrapper(int fd, const char * restrict buf, size_t buf_size, qn_foffset offset)
+{
+#if defined(QN_CFG_LARGE_FILE_SUPPORT)
+    return pwrite64(fd, buf, buf_size, offset);
+#else
+    if (sizeof(off_t) < sizeof(offset) && 0x7FFFFFFFL < offset) {
+        errno = EINVAL;
+        return -1;
+    } // if
+    return pwrite(fd, buf, buf_size, (off_t)offset);
+#endif
+}
+
+static inline int qn_fl_sync_file_range_wrapper(int fd, qn_foffset offset, qn_fsize size, unsigned int flags)
+{
+    return sync_file_range(fd, (off64_t)offset, (off64_t)size, flags);
+}
+
+static inline int qn_fl_fadvise_wrapper(int fd, qn_foffset offset, qn_fsize size, int advice)
+{
+#if defined(QN_CFG_LARGE_FILE_SUPPORT)
+    return posix_fadvise64(fd, offset, size, advice);
+#else
+    if (sizeof(off_t) < sizeof(offset) && 0x7FFFFFFFL < offset + size) return 0;
+    return posix_fadvise(fd, (off_t)offset, (off_t)size, advice);
+#endif
+}
+
+// ---- Keep the file size, so that an interrupted transfer doesn't leave a file which looks complete but ends with zeros.
+static inline int qn_fl_fallocate_wrapper(int fd, qn_fsize fsize)
+{
+#if defined(QN_CFG_LARGE_FILE_SUPPORT)
+    return fallocate64(fd, FALLOC_FL_KEEP_SIZE, 0, fsize);
+#else
+    if (sizeof(off_t) < sizeof(fsize) && 0x7FFFFFFFL < fsize) {
+        errno = EINVAL;
+        return -1;
+    } // if
+    return fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)fsize);
+#endif
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Open a file for writing at given offsets, creating it if it does not exist.
+* Existing content is kept unless QN_FL_WRT_TRUNCATE is given, so that several
+* writers can fill different ranges of the same file. Pass QN_FL_WRT_TRUNCATE
+* when writing a whole file from scratch, otherwise stale bytes beyond the new
+* end are left behind.
+*
+* @param [in] fname The file name.
+* @param [in] fsize The final size of the file. If it is larger than zero, the
+*                   space is allocated up front to avoid fragmentation and
+*                   repeated metadata updates while the file grows.
+* @param [in] offset The offset where the first write lands.
+* @param [in] flags QN_FL_WRT_TRUNCATE to empty an existing file, or 0.
+* @retval non-NULL The pointer to a new writer.
+* @retval NULL Failed in opening the file, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_fl_writer_ptr qn_fl_wrt_open(const char * restrict fname, qn_fsize fsize, qn_foffset offset, int flags)
+{
+    qn_fl_writer_ptr new_wrt = calloc(1, sizeof(qn_fl_writer_st));
+    if (!new_wrt) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_wrt->dio_fd = -1;
+    new_wrt->fd = open(fname, O_WRONLY | O_CREAT | ((flags & QN_FL_WRT_TRUNCATE) ? O_TRUNC : 0), 0644);
+    if (new_wrt->fd < 0) {
+        free(new_wrt);
+        qn_err_fl_set_opening_file_failed();
+        return NULL;
+    } // if
+
+    if (!qn_fl_wrt_reserve(new_wrt, fsize)) {
+        close(new_wrt->fd);
+        free(new_wrt);
+        return NULL;
+    } // if
+
+    new_wrt->offset = offset;
+    new_wrt->sync_begin = offset;
+    new_wrt->wrt_vtbl = &qn_fl_wrt_wrt_vtable;
+    return new_wrt;
+}
+
+QN_SDK qn_fl_writer_ptr qn_fl_wrt_duplicate(qn_fl_writer_ptr restrict wrt)
+{
+    qn_fl_writer_ptr new_wrt = calloc(1, sizeof(qn_fl_writer_st));
+    if (!new_wrt) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_wrt->dio_fd = -1;
+    new_wrt->fd = dup(wrt->fd);
+    if (new_wrt->fd < 0) {
+        free(new_wrt);
+        qn_err_fl_set_duplicating_file_failed();
+        return NULL;
+    } // if
+
+    if (wrt->dio_fd >= 0) {
+        // ---- The new writer has its own buffer, bytes buffered by the old one are still written by it.
+        new_wrt->dio_fd = dup(wrt->dio_fd);
+        if (new_wrt->dio_fd < 0 || posix_memalign((void **)&new_wrt->dio_buf, QN_FL_WRT_DIRECT_ALIGNMENT, QN_FL_WRT_DIRECT_BUFFER_SIZE) != 0) {
+            if (new_wrt->dio_fd >= 0) close(new_wrt->dio_fd);
+            close(new_wrt->fd);
+            free(new_wrt);
+            qn_err_fl_set_duplicating_file_failed();
+            return NULL;
+        } // if
+    } // if
+
+    new_wrt->offset = wrt->offset;
+    new_wrt->sync_intv = wrt->sync_intv;
+    new_wrt->sync_begin = new_wrt->offset;
+    new_wrt->wrt_vtbl = &qn_fl_wrt_wrt_vtable;
+    return new_wrt;
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Close the writer. Bytes left in the direct I/O buffer are written first, but
+* errors can not be reported here, so call qn_fl_wrt_flush() before closing if
+* they matter.
+*
+* @param [in] wrt The pointer to the writer.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_fl_wrt_close(qn_fl_writer_ptr restrict wrt)
+{
+    if (wrt) {
+        qn_fl_wrt_flush(wrt);
+        if (wrt->dio_fd >= 0) close(wrt->dio_fd);
+        free(wrt->dio_buf);
+        close(wrt->fd);
+        free(wrt);
+    } // if
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Allocate space of the file up front, to avoid fragmentation and repeated
+* metadata updates while the file grows. The file size is not changed, it
+* grows as data is written.
+*
+* @param [in] wrt The pointer to the writer.
+* @param [in] fsize The final size of the file, 0 does nothing.
+* @retval true The space is allocated, or the file system can not preallocate
+*              space and writes will allocate it as usual.
+* @retval false Failed in allocating space, e.g. the disk is full, and an
+*               error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_fl_wrt_reserve(qn_fl_writer_ptr restrict wrt, qn_fsize fsize)
+{
+    if (fsize > 0 && qn_fl_fallocate_wrapper(wrt->fd, fsize) < 0) {
+        // ---- Some file systems cannot preallocate space, writes still work there.
+        if (errno != EOPNOTSUPP && errno != ENOSYS) {
+            qn_err_fl_set_writing_file_failed();
+            return qn_false;
+        } // if
+    } // if
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Write through direct I/O, bypassing the page cache. Data is gathered in an
+* aligned buffer and written in whole blocks, while unaligned heads and tails
+* go through the page cache.
+*
+* @param [in] wrt The pointer to the writer.
+* @param [in] enable Use direct I/O or not. Disabling it flushes the buffer.
+* @retval true The mode is switched.
+* @retval false The file system does not support direct I/O, or flushing the
+*               buffer failed, and an error code is set. The writer keeps
+*               working in its previous mode.
+*******************************************************************************/
+QN_SDK qn_bool qn_fl_wrt_set_direct_io(qn_fl_writer_ptr restrict wrt, qn_bool enable)
+{
+    char path[64];
+    int dio_fd;
+
+    if (!enable) {
+        if (wrt->dio_fd < 0) return qn_true;
+        if (!qn_fl_wrt_flush(wrt)) return qn_false;
+        close(wrt->dio_fd);
+        free(wrt->dio_buf);
+        wrt->dio_fd = -1;
+        wrt->dio_buf = NULL;
+        return qn_true;
+    } // if
+
+    if (wrt->dio_fd >= 0) return qn_true;
+
+    // ---- Open another description of the same file, so the O_DIRECT flag never changes under the buffered descriptor.
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", wrt->fd);
+    dio_fd = open(path, O_WRONLY | O_DIRECT);
+    if (dio_fd < 0) {
+        qn_err_fl_set_opening_file_failed();
+        return qn_false;
+    } // if
+
+    if (posix_memalign((void **)&wrt->dio_buf, QN_FL_WRT_DIRECT_ALIGNMENT, QN_FL_WRT_DIRECT_BUFFER_SIZE) != 0) {
+        close(dio_fd);
+        wrt->dio_buf = NULL;
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+
+    wrt->dio_fd = dio_fd;
+    wrt->dio_used = 0;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Push written data to the disk every given number of bytes, and drop it from
+* the page cache once it is on the disk, so long sequential writes do not
+* evict cached data of other processes.
+*
+* @param [in] wrt The pointer to the writer.
+* @param [in] intv The interval in bytes, or 0 to leave write-back to the
+*                  kernel.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_fl_wrt_set_sync_interval(qn_fl_writer_ptr restrict wrt, qn_fsize intv)
+{
+    wrt->sync_intv = intv;
+    wrt->sync_begin = wrt->offset;
+    wrt->prev_size = 0;
+}
+
+QN_SDK qn_io_writer_itf qn_fl_wrt_to_io_writer(qn_fl_writer_ptr restrict wrt)
+{
+    return &wrt->wrt_vtbl;
+}
+
+QN_SDK qn_foffset qn_fl_wrt_offset(qn_fl_writer_ptr restrict wrt)
+{
+    return wrt->offset;
+}
+
+static qn_bool qn_fl_wrt_write_all(int fd, const char * restrict buf, size_t buf_size, qn_foffset offset)
+{
+    ssize_t ret;
+
+    // ---- Write at the given offset, so writers duplicated from the same file never share a file position.
+    while (buf_size > 0) {
+        ret = qn_fl_pwrite_wrapper(fd, buf, buf_size, offset);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            qn_err_fl_set_writing_file_failed();
+            return qn_false;
+        } // if
+        buf += ret;
+        buf_size -= ret;
+        offset += ret;
+    } // while
+    return qn_true;
+}
+
+static qn_bool qn_fl_wrt_write_back(qn_fl_writer_ptr restrict wrt)
+{
+    qn_fsize size;
+
+    if (wrt->offset < wrt->sync_begin) wrt->sync_begin = wrt->offset;
+    size = wrt->offset - wrt->sync_begin;
+    if (size < wrt->sync_intv) return qn_true;
+
+    // ---- Start writing back the new range without waiting, and wait for the previous one which is likely done.
+    if (qn_fl_sync_file_range_wrapper(wrt->fd, wrt->sync_begin, size, SYNC_FILE_RANGE_WRITE) < 0 && errno == EIO) {
+        qn_err_fl_set_writing_file_failed();
+        return qn_false;
+    } // if
+    if (wrt->prev_size > 0) {
+        if (qn_fl_sync_file_range_wrapper(wrt->fd, wrt->prev_begin, wrt->prev_size, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) < 0 && errno == EIO) {
+            qn_err_fl_set_writing_file_failed();
+            return qn_false;
+        } // if
+        qn_fl_fadvise_wrapper(wrt->fd, wrt->prev_begin, wrt->prev_size, POSIX_FADV_DONTNEED);
+    } // if
+
+    wrt->prev_begin = wrt->sync_begin;
+    wrt->prev_size = size;
+    wrt->sync_begin = wrt->offset;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Write bytes left in the direct I/O buffer to the file.
+*
+* @param [in] wrt The pointer to the writer.
+* @retval true All bytes are written.
+* @retval false Failed in writing, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_fl_wrt_flush(qn_fl_writer_ptr restrict wrt)
+{
+    qn_foffset begin;
+    size_t aligned;
+
+    if (wrt->dio_used == 0) return qn_true;
+
+    begin = wrt->offset - wrt->dio_used;
+    aligned = wrt->dio_used & ~((size_t)QN_FL_WRT_DIRECT_ALIGNMENT - 1);
+    if (aligned > 0 && !qn_fl_wrt_write_all(wrt->dio_fd, wrt->dio_buf, aligned, begin)) return qn_false;
+    if (aligned < wrt->dio_used && !qn_fl_wrt_write_all(wrt->fd, wrt->dio_buf + aligned, wrt->dio_used - aligned, begin + aligned)) return qn_false;
+    wrt->dio_used = 0;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Write bytes left in the direct I/O buffer, and wait until all written data
+* is on the disk.
+*
+* @param [in] wrt The pointer to the writer.
+* @retval true All written data is on the disk.
+* @retval false Failed in writing or syncing, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_fl_wrt_sync(qn_fl_writer_ptr restrict wrt)
+{
+    if (!qn_fl_wrt_flush(wrt)) return qn_false;
+    if (fdatasync(wrt->fd) < 0) {
+        qn_err_fl_set_writing_file_failed();
+        return qn_false;
+    } // if
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup File-Writer
+*
+* Move the writer to another offset. Bytes left in the direct I/O buffer belong
+* to the old offset, so they are written first.
+*
+* @param [in] wrt The pointer to the writer.
+* @param [in] offset The offset where the next write lands.
+* @retval true The writer is moved.
+* @retval false Failed in writing the buffered bytes, and an error code is set.
+*               The writer stays at the old offset with the bytes still
+*               buffered, so the caller can try again or give up the file.
+*******************************************************************************/
+QN_SDK qn_bool qn_fl_wrt_seek(qn_fl_writer_ptr restrict wrt, qn_foffset offset)
+{
+    if (!qn_fl_wrt_flush(wrt)) return qn_false;
+    wrt->offset = offset;
+    wrt->sync_begin = offset;
+    wrt->prev_size = 0;
+    return qn_true;
+}
+
+static ssize_t qn_fl_wrt_write_direct(qn_fl_writer_ptr restrict wrt, const char * restrict buf, size_t buf_size)
+{
+    size_t rem_size = buf_size;
+    size_t size;
+
+    while (rem_size > 0) {
+        if (wrt->dio_used == 0 && wrt->offset % QN_FL_WRT_DIRECT_ALIGNMENT != 0) {
+            // ---- Bring the offset to a block boundary through the page cache, so the buffer always starts aligned.
+            size = QN_FL_WRT_DIRECT_ALIGNMENT - wrt->offset % QN_FL_WRT_DIRECT_ALIGNMENT;
+            if (size > rem_size) size = rem_size;
+            if (!qn_fl_wrt_write_all(wrt->fd, buf, size, wrt->offset)) return QN_IO_WRT_WRITING_FAILED;
+        } else {
+            size = QN_FL_WRT_DIRECT_BUFFER_SIZE - wrt->dio_used;
+            if (size > rem_size) size = rem_size;
+            memcpy(wrt->dio_buf + wrt->dio_used, buf, size);
+            wrt->dio_used += size;
+        } // if
+
+        buf += size;
+        rem_size -= size;
+        wrt->offset += size;
+
+        if (wrt->dio_used == QN_FL_WRT_DIRECT_BUFFER_SIZE && !qn_fl_wrt_flush(wrt)) return QN_IO_WRT_WRITING_FAILED;
+    } // while
+    return buf_size;
+}
+
+QN_SDK ssize_t qn_fl_wrt_write(qn_fl_writer_ptr restrict wrt, const char * restrict buf, size_t buf_size)
+{
+    if (wrt->dio_fd >= 0) return qn_fl_wrt_write_direct(wrt, buf, buf_size);
+
+    if (!qn_fl_wrt_write_all(wrt->fd, buf, buf_size, wrt->offset)) return QN_IO_WRT_WRITING_FAILED;
+    wrt->offset += buf_size;
+
+    if (wrt->sync_intv > 0 && !qn_fl_wrt_write_back(wrt)) return QN_IO_WRT_WRITING_FAILED;
+    return buf_size;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,3 +33,24 @@ QN_SDK qn_ssize qn_tm_format_timestamp(qn_time tm, char * restrict buf, qn_size
 
     return qn_cs_snprintf(buf, buf_size, "%04d-%02d-%02d %02d:%02d:%02d", brk_tm.tm_year + 1900, brk_tm.tm_mon + 1,brk_tm.tm_mday, brk_tm.tm_hour, brk_tm.tm_min, brk_tm.tm_sec);
 }
+
+QN_SDK qn_uint64 qn_tm_monotonic_microseconds(void)
+{
+    struct timespec now;
+
+    // ---- Unlike the wall clock, the monotonic clock never jumps when the system time is adjusted.
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (qn_uint64)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+QN_SDK void qn_tm_sleep_milliseconds(qn_uint32 ms)
+{
+    struct timespec req;
+    struct timespec rem;
+
+    req.tv_sec = ms / 1000;
+    req.tv_nsec = (ms % 1000) * 1000000L;
+
+    // ---- Sleep out the remaining time if interrupted by signals.
+    while (nanosleep(&req, &rem) < 0 && errno == EINTR) req = rem;
+}
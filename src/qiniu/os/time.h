@@ -17,6 +17,9 @@ QN_SDK extern qn_time qn_tm_time(void);
 QN_SDK extern qn_string qn_tm_to_string(qn_time tm);
 QN_SDK extern qn_ssize qn_tm_format_timestamp(qn_time tm, char * restrict buf, qn_size buf_size);
 
+QN_SDK extern qn_uint64 qn_tm_monotonic_microseconds(void);
+QN_SDK extern void qn_tm_sleep_milliseconds(qn_uint32 ms);
+
 #ifdef __cplusplus
 }
 #endif
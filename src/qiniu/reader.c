@@ -79,6 +79,11 @@ static qn_fsize qn_rdr_rdr_size_vfn(qn_io_reader_itf restrict itf)
     return qn_rdr_size(qn_rdr_from_io_reader(itf));
 }
 
+static void qn_rdr_rdr_prefetch_vfn(qn_io_reader_itf restrict itf, qn_foffset offset, size_t size)
+{
+    qn_io_rdr_prefetch(qn_rdr_from_io_reader(itf)->src_rdr, offset, size);
+}
+
 static qn_io_reader_st qn_rdr_rdr_vtable = {
     &qn_rdr_rdr_close_vfn,
     &qn_rdr_rdr_peek_vfn,
@@ -88,7 +93,8 @@ static qn_io_reader_st qn_rdr_rdr_vtable = {
     &qn_rdr_rdr_duplicate_vfn,
     &qn_rdr_rdr_section_vfn,
     &qn_rdr_rdr_name_vfn,
-    &qn_rdr_rdr_size_vfn
+    &qn_rdr_rdr_size_vfn,
+    &qn_rdr_rdr_prefetch_vfn
 };
 
 QN_SDK qn_reader_ptr qn_rdr_create(qn_io_reader_itf src_rdr, qn_rdr_pos filter_num)
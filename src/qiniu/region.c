@@ -408,6 +408,18 @@ QN_SDK qn_bool qn_rgn_tbl_set_default_region(qn_rgn_table_ptr restrict rtbl, con
     return qn_rgn_tbl_set_region(rtbl, "default", rgn);
 }
 
+static qn_rgn_host_ptr qn_rgn_get_service_host(qn_region_ptr restrict rgn, int svc)
+{
+    switch (svc) {
+        case QN_RGN_SVC_UP: return qn_rgn_get_up_host(rgn);
+        case QN_RGN_SVC_IO: return qn_rgn_get_io_host(rgn);
+        case QN_RGN_SVC_RS: return qn_rgn_get_rs_host(rgn);
+        case QN_RGN_SVC_RSF: return qn_rgn_get_rsf_host(rgn);
+        case QN_RGN_SVC_API: return qn_rgn_get_api_host(rgn);
+    } // switch
+    return NULL;
+}
+
 QN_SDK void qn_rgn_tbl_choose_first_entry(qn_rgn_table_ptr restrict rtbl, int svc, const char * restrict name, qn_rgn_entry_ptr * restrict entry)
 {
     qn_region_ptr rgn;
@@ -416,32 +428,28 @@ QN_SDK void qn_rgn_tbl_choose_first_entry(qn_rgn_table_ptr restrict rtbl, int sv
     if (!*entry && name) {
         rgn = qn_rgn_tbl_get_region(rtbl, name);
         if (rgn) {
-            switch (svc) {
-                case QN_RGN_SVC_UP: host = qn_rgn_get_up_host(rgn); break;
-                case QN_RGN_SVC_IO: host = qn_rgn_get_io_host(rgn); break;
-                case QN_RGN_SVC_RS: host = qn_rgn_get_rs_host(rgn); break;
-                case QN_RGN_SVC_RSF: host = qn_rgn_get_rsf_host(rgn); break;
-                case QN_RGN_SVC_API: host = qn_rgn_get_api_host(rgn); break;
-            } // switch
-
+            host = qn_rgn_get_service_host(rgn, svc);
             if (host) *entry = qn_rgn_host_get_entry(host, 0);
         } // if
     } // if
 
     if (!*entry) {
-        rgn = qn_rgn_tbl_get_default_region(rtbl);
-        switch (svc) {
-            case QN_RGN_SVC_UP: host = qn_rgn_get_up_host(rgn); break;
-            case QN_RGN_SVC_IO: host = qn_rgn_get_io_host(rgn); break;
-            case QN_RGN_SVC_RS: host = qn_rgn_get_rs_host(rgn); break;
-            case QN_RGN_SVC_RSF: host = qn_rgn_get_rsf_host(rgn); break;
-            case QN_RGN_SVC_API: host = qn_rgn_get_api_host(rgn); break;
-        } // switch
-
+        host = qn_rgn_get_service_host(qn_rgn_tbl_get_default_region(rtbl), svc);
         *entry = qn_rgn_host_get_entry(host, 0);
     } // if
 }
 
+// ---- The host holds all alternative entries of the service, e.g. for sending duplicate requests to another entry.
+QN_SDK qn_rgn_host_ptr qn_rgn_tbl_choose_first_host(qn_rgn_table_ptr restrict rtbl, int svc, const char * restrict name)
+{
+    qn_region_ptr rgn;
+    qn_rgn_host_ptr host = NULL;
+
+    if (name && (rgn = qn_rgn_tbl_get_region(rtbl, name))) host = qn_rgn_get_service_host(rgn, svc);
+    if (!host || qn_rgn_host_entry_count(host) == 0) host = qn_rgn_get_service_host(qn_rgn_tbl_get_default_region(rtbl), svc);
+    return host;
+}
+
 // ---- Definition of Region Interator ----
 
 typedef struct _QN_RGN_ITERATOR
@@ -560,7 +568,7 @@ static qn_bool qn_rgn_svc_parse_and_add_entry(qn_string txt, qn_rgn_host_ptr hos
         hostname_size = end - hostname;
 
         base_url = strstr(end, "http");
-        base_url_size = qn_str_cstr(txt) + qn_str_size(txt) - hostname;
+        base_url_size = qn_str_cstr(txt) + qn_str_size(txt) - base_url;
     } else {
         base_url = qn_str_cstr(txt);
         while (isspace(*base_url)) base_url++;
@@ -634,68 +642,211 @@ static qn_bool qn_rgn_svc_extract_and_add_entries(qn_json_object_ptr root, qn_re
     return qn_true;
 }
 
-QN_SDK qn_bool qn_rgn_svc_grab_bucket_region(qn_rgn_service_ptr restrict svc, qn_rgn_auth_ptr restrict auth, const char * restrict bucket, qn_rgn_table_ptr restrict rtbl)
+static void qn_rgn_svc_add_host_entries(qn_rgn_host_ptr restrict host, int ttl)
+{
+    int i;
+
+    // ---- Failures are not fatal since cURL will resolve the host itself.
+    for (i = 0; i < host->cnt; i += 1) qn_http_dns_add_host(qn_str_cstr(host->entries[i].base_url), ttl);
+}
+
+static qn_string qn_rgn_svc_make_query_url(qn_rgn_auth_ptr restrict auth, const char * restrict bucket)
 {
-    qn_bool ret;
     qn_string url;
     qn_string encoded_bucket;
-    qn_json_object_ptr root;
-    qn_region_ptr new_rgn;
 
-    // ---- Prepare the query URL
     encoded_bucket = qn_cs_percent_encode(bucket, strlen(bucket));
-    if (!encoded_bucket) return qn_false;
+    if (!encoded_bucket) return NULL;
 
     url = qn_cs_sprintf("%s/v1/query?ak=%s&bucket=%s", "http://uc.qbox.me", auth->server_end.access_key, qn_str_cstr(encoded_bucket));
     qn_str_destroy(encoded_bucket);
-    if (!url) return qn_false;
+    return url;
+}
 
-    // ---- Prepare the request and response object
-    qn_http_req_reset(svc->req);
-    qn_http_resp_reset(svc->resp);
+static qn_bool qn_rgn_svc_prepare_query(qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, qn_http_json_writer_ptr restrict resp_json_wrt, qn_json_object_ptr * restrict root)
+{
+    qn_http_req_reset(req);
+    qn_http_resp_reset(resp);
 
-    if (!qn_http_req_set_header(svc->req, "Expect", "")) {
-        qn_str_destroy(url);
-        return qn_false;
-    } // if
-    if (!qn_http_req_set_header(svc->req, "Transfer-Encoding", "")) {
-        qn_str_destroy(url);
+    if (!qn_http_req_set_header(req, "Expect", "")) return qn_false;
+    if (!qn_http_req_set_header(req, "Transfer-Encoding", "")) return qn_false;
+    if (! qn_http_req_set_header(req, "User-Agent", qn_ver_get_full_string())) return qn_false;
+
+    qn_http_req_set_body_data(req, "", 0);
+
+    *root = NULL;
+    qn_http_json_wrt_prepare(resp_json_wrt, root, NULL);
+    qn_http_resp_set_data_writer(resp, resp_json_wrt, &qn_http_json_wrt_write_cfn);
+    return qn_true;
+}
+
+static qn_bool qn_rgn_svc_set_bucket_region(const char * restrict bucket, qn_json_object_ptr restrict root, qn_rgn_table_ptr restrict rtbl)
+{
+    qn_bool ret;
+    qn_region_ptr new_rgn;
+
+    if (! (new_rgn = qn_rgn_create(bucket))) return qn_false;
+
+    if (!qn_rgn_svc_extract_and_add_entries(root, new_rgn)) {
+        qn_rgn_destroy(new_rgn);
         return qn_false;
     } // if
-    if (! qn_http_req_set_header(svc->req, "User-Agent", qn_ver_get_full_string())) {
+
+    // ---- Add the hosts to the DNS cache without resolving them here, so grabbing regions never waits for lookups.
+    qn_rgn_svc_add_host_entries(new_rgn->up, new_rgn->time_to_live);
+    qn_rgn_svc_add_host_entries(new_rgn->io, new_rgn->time_to_live);
+
+    ret = qn_rgn_tbl_set_region(rtbl, bucket, new_rgn);
+    qn_rgn_destroy(new_rgn);
+    return ret;
+}
+
+QN_SDK qn_bool qn_rgn_svc_grab_bucket_region(qn_rgn_service_ptr restrict svc, qn_rgn_auth_ptr restrict auth, const char * restrict bucket, qn_rgn_table_ptr restrict rtbl)
+{
+    qn_bool ret;
+    qn_string url;
+    qn_json_object_ptr root;
+
+    // ---- Prepare the query URL
+    url = qn_rgn_svc_make_query_url(auth, bucket);
+    if (!url) return qn_false;
+
+    // ---- Prepare the request and response object
+    if (!qn_rgn_svc_prepare_query(svc->req, svc->resp, svc->resp_json_wrt, &root)) {
         qn_str_destroy(url);
         return qn_false;
     } // if
 
-    qn_http_req_set_body_data(svc->req, "", 0);
-
-    root = NULL;
-    qn_http_json_wrt_prepare(svc->resp_json_wrt, &root, NULL);
-    qn_http_resp_set_data_writer(svc->resp, svc->resp_json_wrt, &qn_http_json_wrt_write_cfn);
-
     ret = qn_http_conn_get(svc->conn, url, svc->req, svc->resp);
     qn_str_destroy(url);
 
     // ---- Grab the region info of the givan bucket
+    if (ret) ret = qn_rgn_svc_set_bucket_region(bucket, root, rtbl);
+    // TODO: Deal with the case that API return no value.
+    qn_json_obj_destroy(root);
+    return ret;
+}
+
+typedef struct _QN_RGN_SVC_QUERY
+{
+    qn_http_request_ptr req;
+    qn_http_response_ptr resp;
+    qn_http_json_writer_ptr resp_json_wrt;
+    qn_json_object_ptr root;
+    qn_bool done;
+} qn_rgn_svc_query;
+
+static void qn_rgn_svc_release_queries(qn_rgn_svc_query * restrict qrys, int cnt)
+{
+    int i;
+
+    for (i = 0; i < cnt; i += 1) {
+        if (qrys[i].root) qn_json_obj_destroy(qrys[i].root);
+        if (qrys[i].resp_json_wrt) qn_http_json_wrt_destroy(qrys[i].resp_json_wrt);
+        qn_http_resp_destroy(qrys[i].resp);
+        qn_http_req_destroy(qrys[i].req);
+    } // for
+    free(qrys);
+}
+
+/***************************************************************************//**
+* @ingroup Region-Service
+*
+* Grab region info of several buckets in parallel, and put them into the
+* region table under the names of the buckets. It saves the serial round trips
+* of calling qn_rgn_svc_grab_bucket_region() once for each bucket, e.g. when a
+* short-lived job starts.
+*
+* @param [in] svc The pointer to the region service.
+* @param [in] auth The authorization information.
+* @param [in] buckets The names of the buckets.
+* @param [in] cnt The number of buckets.
+* @param [in] rtbl The region table to put region info into.
+* @retval qn_true Region info of all buckets is grabbed.
+* @retval qn_false Failed in grabbing region info of some buckets, and the
+*                  error code of the last failure is set. A query answered
+*                  with a status other than 200 fails with
+*                  QN_ERR_STOR_API_RETURN_NO_VALUE. Region info of the other
+*                  buckets is still put into the table.
+*******************************************************************************/
+QN_SDK qn_bool qn_rgn_svc_grab_bucket_regions(qn_rgn_service_ptr restrict svc, qn_rgn_auth_ptr restrict auth, const char ** restrict buckets, int cnt, qn_rgn_table_ptr restrict rtbl)
+{
+    qn_bool ret = qn_true;
+    qn_bool failed = qn_false;
+    qn_string url;
+    qn_http_multi_ptr mt;
+    qn_http_multi_result_st rs;
+    qn_rgn_svc_query * qrys;
+    qn_rgn_svc_query * qry;
+    qn_err_code_em err_code = QN_ERR_SUCCEED;
+    int pending = 0;
+    int i;
+
+    if (cnt <= 0) return qn_true;
+
+    if (!(qrys = calloc(cnt, sizeof(qn_rgn_svc_query)))) {
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+    if (!(mt = qn_http_multi_create())) {
+        free(qrys);
+        return qn_false;
+    } // if
 
-    if (ret) {
-        if (! (new_rgn = qn_rgn_create(bucket))) {
-            qn_json_obj_destroy(root);
-            return qn_false;
+    for (i = 0; i < cnt; i += 1) {
+        if (!(qrys[i].req = qn_http_req_create()) || !(qrys[i].resp = qn_http_resp_create()) || !(qrys[i].resp_json_wrt = qn_http_json_wrt_create())) {
+            ret = qn_false;
+            break;
+        } // if
+        if (!qn_rgn_svc_prepare_query(qrys[i].req, qrys[i].resp, qrys[i].resp_json_wrt, &qrys[i].root)) {
+            ret = qn_false;
+            break;
+        } // if
+        if (!(url = qn_rgn_svc_make_query_url(auth, buckets[i]))) {
+            ret = qn_false;
+            break;
         } // if
+        ret = qn_http_multi_submit_get(mt, url, qrys[i].req, qrys[i].resp, &qrys[i]);
+        qn_str_destroy(url);
+        if (!ret) break;
+        pending += 1;
+    } // for
 
-        if (!qn_rgn_svc_extract_and_add_entries(root, new_rgn)) {
-            qn_rgn_destroy(new_rgn);
-            qn_json_obj_destroy(root);
-            return qn_false;
+    while (ret && pending > 0) {
+        if (!qn_http_multi_poll(mt, 1000, NULL)) {
+            ret = qn_false;
+            break;
         } // if
+        // ---- The last call finds no done transfer and sets the try-again code, so keep the failure in a local.
+        while (qn_http_multi_complete(mt, &rs)) {
+            pending -= 1;
+            qry = (qn_rgn_svc_query *) rs.user_data;
+            if (rs.err_code != QN_ERR_SUCCEED) {
+                err_code = rs.err_code;
+            } else if (qn_http_resp_get_code(qry->resp) != 200) {
+                // ---- An error body is parsed as well, but carries no region info.
+                err_code = QN_ERR_STOR_API_RETURN_NO_VALUE;
+            } else {
+                qry->done = qn_true;
+            } // if
+        } // while
+    } // while
 
-        ret = qn_rgn_tbl_set_region(rtbl, bucket, new_rgn);
-        qn_rgn_destroy(new_rgn);
+    // ---- Destroying the multi object cancels transfers left behind by a failure.
+    qn_http_multi_destroy(mt);
+
+    if (err_code != QN_ERR_SUCCEED) {
+        qn_err_set_code(err_code, 0, __FILE__, __LINE__);
+        failed = qn_true;
     } // if
-    // TODO: Deal with the case that API return no value.
-    qn_json_obj_destroy(root);
-    return ret;
+
+    for (i = 0; i < cnt; i += 1) {
+        if (!qrys[i].done || !qrys[i].root) continue;
+        if (!qn_rgn_svc_set_bucket_region(buckets[i], qrys[i].root, rtbl)) failed = qn_true;
+    } // for
+
+    qn_rgn_svc_release_queries(qrys, cnt);
+    return ret && !failed;
 }
 
 #ifdef __cplusplus
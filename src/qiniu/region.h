@@ -80,6 +80,7 @@ enum
 };
 
 QN_SDK extern void qn_rgn_tbl_choose_first_entry(qn_rgn_table_ptr restrict rtbl, int svc, const char * restrict name, qn_rgn_entry_ptr * restrict entry);
+QN_SDK extern qn_rgn_host_ptr qn_rgn_tbl_choose_first_host(qn_rgn_table_ptr restrict rtbl, int svc, const char * restrict name);
 
 // ---- Declaration of Region Interator ----
 
@@ -108,6 +109,7 @@ QN_SDK extern qn_rgn_service_ptr qn_rgn_svc_create(void);
 QN_SDK extern void qn_rgn_svc_destroy(qn_rgn_service_ptr restrict svc);
 
 QN_SDK extern qn_bool qn_rgn_svc_grab_bucket_region(qn_rgn_service_ptr restrict svc, qn_rgn_auth_ptr restrict auth, const char * restrict bucket, qn_rgn_table_ptr restrict rtbl);
+QN_SDK extern qn_bool qn_rgn_svc_grab_bucket_regions(qn_rgn_service_ptr restrict svc, qn_rgn_auth_ptr restrict auth, const char ** restrict buckets, int cnt, qn_rgn_table_ptr restrict rtbl);
 
 #ifdef __cplusplus
 }
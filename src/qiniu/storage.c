@@ -1,10 +1,16 @@
 #include <assert.h>
+#include <stdio.h>
 #include <curl/curl.h>
 
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+#include <pthread.h>
+#endif
+
 #include "qiniu/base/errors.h"
 #include "qiniu/base/json_parser.h"
 #include "qiniu/base/json_formatter.h"
 #include "qiniu/os/types_conv.h"
+#include "qiniu/os/time.h"
 #include "qiniu/version.h"
 #include "qiniu/http.h"
 #include "qiniu/http_query.h"
@@ -24,8 +30,18 @@ typedef struct _QN_STORAGE
     qn_http_response_ptr resp;
     qn_http_connection_ptr conn;
     qn_http_json_writer_ptr resp_json_wrt;
+    qn_http_req_template_ptr tmpl;
     qn_json_object_ptr obj_body;
     qn_json_array_ptr arr_body;
+
+    qn_stor_retry_policy_ptr rtp;
+    qn_uint32 rtp_seed;
+    qn_stor_chunk_policy_ptr chp;
+
+    qn_http_version_em ver;
+    qn_http_transport_itf tpt;      // NULL for the default transport built on cURL.
+    qn_uint32 hdg_delay;            // In milliseconds, 0 disables hedging.
+    struct _QN_STOR_HEDGE * hdg;
 } qn_storage;
 
 QN_SDK qn_storage_ptr qn_stor_create(void)
@@ -68,14 +84,40 @@ QN_SDK qn_storage_ptr qn_stor_create(void)
         return NULL;
     } // if
 
+    // ---- Headers shared by all requests are compiled once.
+    new_stor->tmpl = qn_http_req_tmpl_create();
+    if (!new_stor->tmpl) {
+        qn_http_json_wrt_destroy(new_stor->resp_json_wrt);
+        qn_http_conn_destroy(new_stor->conn);
+        qn_http_resp_destroy(new_stor->resp);
+        qn_http_req_destroy(new_stor->req);
+        free(new_stor);
+        return NULL;
+    } // if
+
+    if (!qn_http_req_tmpl_set_header(new_stor->tmpl, "Expect", "") || !qn_http_req_tmpl_set_header(new_stor->tmpl, "Transfer-Encoding", "") || !qn_http_req_tmpl_set_header(new_stor->tmpl, "User-Agent", qn_ver_get_full_string())) {
+        qn_http_req_tmpl_destroy(new_stor->tmpl);
+        qn_http_json_wrt_destroy(new_stor->resp_json_wrt);
+        qn_http_conn_destroy(new_stor->conn);
+        qn_http_resp_destroy(new_stor->resp);
+        qn_http_req_destroy(new_stor->req);
+        free(new_stor);
+        return NULL;
+    } // if
+
+    new_stor->rtp_seed = (qn_uint32)qn_tm_time() ^ (qn_uint32)(size_t)new_stor;
     return new_stor;
 }
 
+static void qn_stor_hdg_destroy(struct _QN_STOR_HEDGE * restrict hdg);
+
 QN_SDK void qn_stor_destroy(qn_storage_ptr restrict stor)
 {
     if (stor) {
+        qn_stor_hdg_destroy(stor->hdg);
         if (stor->obj_body) qn_json_obj_destroy(stor->obj_body);
         if (stor->arr_body) qn_json_arr_destroy(stor->arr_body);
+        qn_http_req_tmpl_destroy(stor->tmpl);
         qn_http_json_wrt_destroy(stor->resp_json_wrt);
         qn_http_conn_destroy(stor->conn);
         qn_http_resp_destroy(stor->resp);
@@ -84,6 +126,66 @@ QN_SDK void qn_stor_destroy(qn_storage_ptr restrict stor)
     } // if
 }
 
+QN_SDK void qn_stor_set_http_version(qn_storage_ptr restrict stor, qn_http_version_em ver)
+{
+    stor->ver = ver;
+    qn_http_conn_set_version(stor->conn, ver);
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Object
+*
+* Send requests of the storage object through another transport, e.g. a
+* loopback one created by qn_http_lpbk_create() for profiling the SDK without
+* network. Hedged requests are not sent while a transport is set, since they
+* need concurrent transfers of cURL.
+*
+* @param [in] stor The pointer to the storage object.
+* @param [in] tpt The transport to use, or NULL to restore the default one.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_set_transport(qn_storage_ptr restrict stor, qn_http_transport_itf restrict tpt)
+{
+    stor->tpt = tpt;
+    qn_http_conn_set_transport(stor->conn, tpt);
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Object
+*
+* Open connections to the first up, rs and rsf entries of a region in parallel
+* ahead of time, so that the first calls to storage APIs pay no DNS, TCP or TLS
+* latency. Call qn_rgn_svc_grab_bucket_regions() before it to fetch region
+* info of buckets in parallel, and pass bucket names as region names.
+*
+* @param [in] stor The pointer to the storage object.
+* @param [in] rtbl The region table, or NULL for the global one.
+* @param [in] name The name of the region, or NULL for the default region.
+* @param [in] timeout_ms The time limit of each connection in milliseconds, or
+*                        0 for no limit.
+* @retval qn_true All entries are connected, or a transport other than cURL is
+*                 set.
+* @retval qn_false Failed in connecting some of the entries, and an error code
+*                  is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_stor_prewarm(qn_storage_ptr restrict stor, qn_rgn_table_ptr restrict rtbl, const char * restrict name, int timeout_ms)
+{
+    static const int svcs[] = {QN_RGN_SVC_UP, QN_RGN_SVC_RS, QN_RGN_SVC_RSF};
+    const char * urls[sizeof(svcs) / sizeof(svcs[0])];
+    qn_rgn_entry_ptr entry;
+    int cnt = 0;
+    int i;
+
+    if (stor->tpt) return qn_true;
+
+    for (i = 0; i < sizeof(svcs) / sizeof(svcs[0]); i += 1) {
+        entry = NULL;
+        qn_rgn_tbl_choose_first_entry(rtbl, svcs[i], name, &entry);
+        if (entry) urls[cnt++] = qn_str_cstr(entry->base_url);
+    } // for
+    return qn_http_conn_prewarm(stor->conn, urls, cnt, timeout_ms);
+}
+
 QN_SDK qn_json_object_ptr qn_stor_get_object_body(const qn_storage_ptr restrict stor)
 {
     return stor->obj_body;
@@ -101,12 +203,30 @@ QN_SDK qn_http_hdr_iterator_ptr qn_stor_resp_get_header_iterator(const qn_storag
 
 static qn_bool qn_stor_prepare_common_request_headers(qn_storage_ptr restrict stor)
 {
-    if (!qn_http_req_set_header(stor->req, "Expect", "")) return qn_false;
-    if (!qn_http_req_set_header(stor->req, "Transfer-Encoding", "")) return qn_false;
-    if (!qn_http_req_set_header(stor->req, "User-Agent", qn_ver_get_full_string())) return qn_false;
+    qn_http_req_set_template(stor->req, stor->tmpl);
     return qn_true;
 }
 
+static void qn_stor_set_response_info(qn_storage_ptr restrict stor)
+{
+    const qn_http_timing_st * tm = qn_http_resp_get_timing(stor->resp);
+
+    // ---- A batch response is an array, which is moved into a fake object body only after sending.
+    if (! stor->obj_body) return;
+
+    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+
+    // ---- Timings are in microseconds.
+    qn_json_obj_set_integer(stor->obj_body, "fn-namelookup-time", tm->namelookup);
+    qn_json_obj_set_integer(stor->obj_body, "fn-connect-time", tm->connect);
+    qn_json_obj_set_integer(stor->obj_body, "fn-appconnect-time", tm->appconnect);
+    qn_json_obj_set_integer(stor->obj_body, "fn-pretransfer-time", tm->pretransfer);
+    qn_json_obj_set_integer(stor->obj_body, "fn-starttransfer-time", tm->starttransfer);
+    qn_json_obj_set_integer(stor->obj_body, "fn-total-time", tm->total);
+    qn_json_obj_set_integer(stor->obj_body, "fn-bytes-up", tm->bytes_up);
+    qn_json_obj_set_integer(stor->obj_body, "fn-bytes-down", tm->bytes_down);
+}
+
 static inline void qn_stor_reset(qn_storage_ptr restrict stor)
 {
     qn_http_req_reset(stor->req);
@@ -122,12 +242,411 @@ static inline void qn_stor_reset(qn_storage_ptr restrict stor)
     } // if
 }
 
+// -------- Retry Policy (abbreviation: rtp) --------
+
+enum
+{
+    QN_STOR_RTP_DEFAULT_MAX_ATTEMPTS = 3,
+    QN_STOR_RTP_DEFAULT_BASE_DELAY = 200,   // In milliseconds.
+    QN_STOR_RTP_DEFAULT_MAX_DELAY = 5000    // In milliseconds.
+};
+
+typedef struct _QN_STOR_RETRY_POLICY
+{
+    int max_attempts;
+    qn_uint32 base_delay;
+    qn_uint32 max_delay;
+    qn_bool retry_non_idempotent;
+} qn_stor_retry_policy_st;
+
+QN_SDK qn_stor_retry_policy_ptr qn_stor_rtp_create(void)
+{
+    qn_stor_retry_policy_ptr new_rtp = calloc(1, sizeof(qn_stor_retry_policy_st));
+    if (! new_rtp) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_rtp->max_attempts = QN_STOR_RTP_DEFAULT_MAX_ATTEMPTS;
+    new_rtp->base_delay = QN_STOR_RTP_DEFAULT_BASE_DELAY;
+    new_rtp->max_delay = QN_STOR_RTP_DEFAULT_MAX_DELAY;
+    return new_rtp;
+}
+
+QN_SDK void qn_stor_rtp_destroy(qn_stor_retry_policy_ptr restrict rtp)
+{
+    if (rtp) {
+        free(rtp);
+    } // if
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Retry-Policy
+*
+* Set how many times at most an API call is attempted, including the first one.
+*
+* @param [in] rtp The pointer to the retry policy.
+* @param [in] max_attempts The maximum number of attempts. Values less than 1
+*                          are treated as 1, which disables retrying.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_rtp_set_max_attempts(qn_stor_retry_policy_ptr restrict rtp, int max_attempts)
+{
+    rtp->max_attempts = (max_attempts < 1) ? 1 : max_attempts;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Retry-Policy
+*
+* Set the delay before retrying. The delay doubles after each failed attempt
+* until it reaches the maximum, and a random jitter of up to half the delay is
+* taken off to keep clients failing together from retrying together.
+*
+* @param [in] rtp The pointer to the retry policy.
+* @param [in] base_ms The delay in milliseconds before the first retry.
+* @param [in] max_ms The upper bound of the delay in milliseconds.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_rtp_set_backoff(qn_stor_retry_policy_ptr restrict rtp, qn_uint32 base_ms, qn_uint32 max_ms)
+{
+    rtp->base_delay = base_ms;
+    rtp->max_delay = (max_ms < base_ms) ? base_ms : max_ms;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Retry-Policy
+*
+* Allow retrying non-idempotent APIs (copy, move, delete, fetch and uploads)
+* even if the server may have received the failed request. By default they are
+* retried only when the request surely did not leave the client, e.g. the
+* connection could not be made. Requests streamed from readers, batch
+* operations and the mkfile API are never resent.
+*
+* @param [in] rtp The pointer to the retry policy.
+* @param [in] enable Whether to retry non-idempotent APIs after sending.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_rtp_set_retrying_non_idempotent(qn_stor_retry_policy_ptr restrict rtp, qn_bool enable)
+{
+    rtp->retry_non_idempotent = enable;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Retry-Policy
+*
+* Attach a retry policy to the storage object. The policy is not copied and can
+* be shared by storage objects.
+*
+* @param [in] stor The pointer to the storage object.
+* @param [in] rtp The pointer to the retry policy, or NULL to disable retrying.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_set_retry_policy(qn_storage_ptr restrict stor, qn_stor_retry_policy_ptr restrict rtp)
+{
+    stor->rtp = rtp;
+}
+
+enum
+{
+    QN_STOR_API_IDEMPOTENT = 0x1,   // Sending the request again does no harm.
+    QN_STOR_API_RESENDABLE = 0x2,   // The request body and the result object can be rebuilt for another attempt.
+    QN_STOR_API_BULK = 0x4          // The request or the response carries file data.
+};
+
+static qn_bool qn_stor_rtp_is_transient_error(void)
+{
+    return qn_err_is_try_again() || qn_err_comm_is_transmission_failed() || qn_err_comm_is_dns_failed();
+}
+
+static inline qn_bool qn_stor_rtp_is_transient_status(int code)
+{
+    // ---- 579 means the file is stored but the callback failed, so uploading again won't help.
+    return 500 <= code && code != 579;
+}
+
+static qn_bool qn_stor_rtp_is_transient_code(qn_json_object_ptr restrict ret)
+{
+    qn_json_integer code = 0;
+
+    if (! qn_json_obj_get_integer(ret, "fn-code", &code)) return qn_false;
+    return qn_stor_rtp_is_transient_status((int) code);
+}
+
+// ---- Get the delay in milliseconds before the attempt after the given one.
+static qn_uint32 qn_stor_rtp_delay(qn_storage_ptr restrict stor, int attempt)
+{
+    qn_uint32 delay = stor->rtp->base_delay;
+    qn_uint32 half;
+
+    while (--attempt > 0 && delay < stor->rtp->max_delay) delay <<= 1;
+    if (delay > stor->rtp->max_delay) delay = stor->rtp->max_delay;
+
+    // ---- Take a random jitter off by a xorshift generator seeded per storage object.
+    stor->rtp_seed ^= stor->rtp_seed << 13;
+    stor->rtp_seed ^= stor->rtp_seed >> 17;
+    stor->rtp_seed ^= stor->rtp_seed << 5;
+    half = delay / 2;
+    return delay - ((half > 0) ? stor->rtp_seed % (half + 1) : 0);
+}
+
+static void qn_stor_rtp_wait(qn_storage_ptr restrict stor, int attempt)
+{
+    qn_tm_sleep_milliseconds(qn_stor_rtp_delay(stor, attempt));
+}
+
+// -------- Chunk Policy (abbreviation: chp) --------
+
+enum
+{
+    QN_STOR_CHP_DEFAULT_MIN_SIZE = (1024 * 64),
+    QN_STOR_CHP_DEFAULT_TARGET_TIME = 1000,     // In milliseconds.
+    QN_STOR_CHP_ALIGNMENT = (1024 * 16)
+};
+
+#define QN_STOR_CHP_LOSSY_RATE 0.05
+
+typedef struct _QN_STOR_CHUNK_POLICY
+{
+    qn_uint min_size;
+    qn_uint max_size;
+    qn_uint32 target_time;
+    qn_uint chk_size;               // The size of the next chunk.
+
+    // ---- Decaying sums over recent chunks, so that the throughput weighs chunks by size and follows the link.
+    double sent_bytes;
+    double sent_time;               // In microseconds.
+    double err_rate;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    pthread_mutex_t lock;           // Storage objects in different threads may share the policy.
+#endif
+} qn_stor_chunk_policy_st;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+#define qn_stor_chp_lock(chp) pthread_mutex_lock(&(chp)->lock)
+#define qn_stor_chp_unlock(chp) pthread_mutex_unlock(&(chp)->lock)
+#else
+#define qn_stor_chp_lock(chp)
+#define qn_stor_chp_unlock(chp)
+#endif
+
+QN_SDK qn_stor_chunk_policy_ptr qn_stor_chp_create(void)
+{
+    qn_stor_chunk_policy_ptr new_chp = calloc(1, sizeof(qn_stor_chunk_policy_st));
+    if (! new_chp) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_chp->min_size = QN_STOR_CHP_DEFAULT_MIN_SIZE;
+    new_chp->max_size = QN_STOR_RU_BLOCK_MAX_SIZE;
+    new_chp->target_time = QN_STOR_CHP_DEFAULT_TARGET_TIME;
+    new_chp->chk_size = QN_STOR_RU_CHUNK_DEFAULT_SIZE;
+
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    pthread_mutex_init(&new_chp->lock, NULL);
+#endif
+    return new_chp;
+}
+
+QN_SDK void qn_stor_chp_destroy(qn_stor_chunk_policy_ptr restrict chp)
+{
+    if (chp) {
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+        pthread_mutex_destroy(&chp->lock);
+#endif
+        free(chp);
+    } // if
+}
+
+static qn_uint qn_stor_chp_clamp(qn_stor_chunk_policy_ptr restrict chp, double size)
+{
+    qn_uint ret;
+
+    if (size >= chp->max_size) return chp->max_size;
+    ret = (qn_uint)size & ~((qn_uint)QN_STOR_CHP_ALIGNMENT - 1);
+    return (ret < chp->min_size) ? chp->min_size : ret;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Chunk-Policy
+*
+* Set the range within which the chunk size is adapted.
+*
+* @param [in] chp The pointer to the chunk policy.
+* @param [in] min_size The smallest chunk size, at least 16KB.
+* @param [in] max_size The largest chunk size, at most and by default the
+*                      block size. Passing 0 uses the block size.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_chp_set_size_range(qn_stor_chunk_policy_ptr restrict chp, qn_uint min_size, qn_uint max_size)
+{
+    if (max_size == 0 || max_size > QN_STOR_RU_BLOCK_MAX_SIZE) max_size = QN_STOR_RU_BLOCK_MAX_SIZE;
+    if (min_size < QN_STOR_CHP_ALIGNMENT) min_size = QN_STOR_CHP_ALIGNMENT;
+    if (min_size > max_size) min_size = max_size;
+
+    qn_stor_chp_lock(chp);
+    chp->min_size = min_size;
+    chp->max_size = max_size;
+    chp->chk_size = qn_stor_chp_clamp(chp, chp->chk_size);
+    qn_stor_chp_unlock(chp);
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Chunk-Policy
+*
+* Set how long putting one chunk should take. Chunks are sized to take about
+* this long at the measured throughput, which bounds the data to resend after
+* a failure. The default is 1000 milliseconds.
+*
+* @param [in] chp The pointer to the chunk policy.
+* @param [in] target_ms The target time in milliseconds.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_chp_set_target_time(qn_stor_chunk_policy_ptr restrict chp, qn_uint32 target_ms)
+{
+    qn_stor_chp_lock(chp);
+    chp->target_time = (target_ms > 0) ? target_ms : 1;
+    qn_stor_chp_unlock(chp);
+}
+
+QN_SDK qn_uint qn_stor_chp_get_chunk_size(qn_stor_chunk_policy_ptr restrict chp)
+{
+    qn_uint chk_size;
+
+    qn_stor_chp_lock(chp);
+    chk_size = chp->chk_size;
+    qn_stor_chp_unlock(chp);
+    return chk_size;
+}
+
+static qn_uint qn_stor_chp_get_max_size(qn_stor_chunk_policy_ptr restrict chp)
+{
+    qn_uint max_size;
+
+    qn_stor_chp_lock(chp);
+    max_size = chp->max_size;
+    qn_stor_chp_unlock(chp);
+    return max_size;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Chunk-Policy
+*
+* Attach a chunk policy to the storage object. Resumable uploads through the
+* object take the size of each chunk from the policy instead of the fixed size
+* passed in, and report how each chunk went back to it. The policy is not
+* copied and can be shared by storage objects using the same link. Sharing it
+* across threads is safe only if the SDK is built with
+* QN_CFG_SUPPORT_MULTITHREAD, which guards the policy with a lock.
+*
+* @param [in] stor The pointer to the storage object.
+* @param [in] chp The pointer to the chunk policy, or NULL to use fixed chunks.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_set_chunk_policy(qn_storage_ptr restrict stor, qn_stor_chunk_policy_ptr restrict chp)
+{
+    stor->chp = chp;
+}
+
+static void qn_stor_chp_record(qn_stor_chunk_policy_ptr restrict chp, qn_uint size, qn_uint64 elapsed, qn_bool ok)
+{
+    double next;
+
+    qn_stor_chp_lock(chp);
+    chp->err_rate = chp->err_rate * 7 / 8 + ((ok) ? 0.0 : 1.0 / 8);
+    if (! ok) {
+        // ---- Halve the chunk after a failure, so that a lossy link resends less.
+        next = chp->chk_size / 2;
+    } else {
+        chp->sent_bytes = chp->sent_bytes * 7 / 8 + size;
+        chp->sent_time = chp->sent_time * 7 / 8 + ((elapsed > 0) ? elapsed : 1);
+
+        // ---- Aim at the target time at the measured throughput, but at most double per chunk, and never grow while losses are frequent.
+        next = chp->sent_bytes / chp->sent_time * chp->target_time * 1000.0;
+        if (next > chp->chk_size * 2.0) next = chp->chk_size * 2.0;
+        if (next > chp->chk_size && chp->err_rate > QN_STOR_CHP_LOSSY_RATE) next = chp->chk_size;
+    } // if
+    chp->chk_size = qn_stor_chp_clamp(chp, next);
+    qn_stor_chp_unlock(chp);
+}
+
+// ---- Tell the policy how a chunk went. Failures which say nothing about the link, e.g. an invalid token, are left out.
+static void qn_stor_chp_sample(qn_stor_chunk_policy_ptr restrict chp, qn_uint size, qn_uint64 begin, qn_json_object_ptr restrict up_ret)
+{
+    qn_json_integer code = 0;
+
+    if (! chp) return;
+    if (up_ret && qn_json_obj_get_integer(up_ret, "fn-code", &code) && code == 200) {
+        qn_stor_chp_record(chp, size, qn_tm_monotonic_microseconds() - begin, qn_true);
+    } else if ((up_ret) ? qn_stor_rtp_is_transient_code(up_ret) : qn_stor_rtp_is_transient_error()) {
+        qn_stor_chp_record(chp, size, qn_tm_monotonic_microseconds() - begin, qn_false);
+    } // if
+}
+
+static qn_bool qn_stor_rtp_reprepare_result(qn_storage_ptr restrict stor)
+{
+    qn_json_object_ptr new_obj_body;
+
+    if (! (new_obj_body = qn_json_obj_create())) return qn_false;
+    if (! qn_json_obj_set_integer(new_obj_body, "fn-code", 0) || ! qn_json_obj_set_cstr(new_obj_body, "fn-error", "OK")) {
+        qn_json_obj_destroy(new_obj_body);
+        return qn_false;
+    } // if
+
+    if (stor->obj_body) qn_json_obj_destroy(stor->obj_body);
+    stor->obj_body = new_obj_body;
+
+    qn_http_resp_reset(stor->resp);
+    qn_http_json_wrt_prepare(stor->resp_json_wrt, &stor->obj_body, NULL);
+    qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
+    return qn_true;
+}
+
+// ---- Send the prepared request, and retry according to the retry policy and the API's class.
+static qn_bool qn_stor_send(qn_storage_ptr restrict stor, int api_cls, const char * restrict url, qn_bool post)
+{
+    qn_bool ret;
+    qn_bool sent;
+    int attempt = 0;
+
+    qn_http_conn_set_tuning_profile(stor->conn, (api_cls & QN_STOR_API_BULK) ? QN_HTTP_TUNING_BULK : QN_HTTP_TUNING_INTERACTIVE);
+
+    // ---- JSON results like listings compress well, while file data is often compressed already or requested by range.
+    qn_http_conn_set_compression(stor->conn, ! (api_cls & QN_STOR_API_BULK));
+
+    while (1) {
+        attempt += 1;
+        ret = (post) ? qn_http_conn_post(stor->conn, url, stor->req, stor->resp) : qn_http_conn_get(stor->conn, url, stor->req, stor->resp);
+
+        if (! stor->rtp || attempt >= stor->rtp->max_attempts) return ret;
+        if (ret) {
+            // ---- Decide by the status code, since the body may be an array which has no room for it.
+            if (! qn_stor_rtp_is_transient_status(qn_http_resp_get_code(stor->resp))) return ret;
+        } else if (! qn_stor_rtp_is_transient_error()) {
+            return ret;
+        } // if
+
+        // ---- Nothing left the client if cURL failed before starting the transfer, so any API can be sent again as is.
+        sent = (ret || qn_http_resp_get_timing(stor->resp)->pretransfer > 0);
+        if (sent) {
+            if (! (api_cls & QN_STOR_API_RESENDABLE)) return ret;
+            if (! (api_cls & QN_STOR_API_IDEMPOTENT) && ! stor->rtp->retry_non_idempotent) return ret;
+            if (! qn_stor_rtp_reprepare_result(stor)) return qn_false;
+        } // if
+
+        qn_stor_rtp_wait(stor, attempt);
+    } // while
+    return ret;
+}
+
 // -------- Management Extra (abbreviation: mne) --------
 
 typedef struct _QN_STOR_MANAGEMENT_EXTRA
 {
     unsigned int force:1;
     qn_rgn_entry_ptr rgn_entry;
+    qn_rgn_host_ptr rgn_host;
 } qn_stor_management_extra_st;
 
 QN_SDK qn_stor_management_extra_ptr qn_stor_mne_create(void)
@@ -162,54 +681,362 @@ QN_SDK void qn_stor_mne_set_region_entry(qn_stor_management_extra_ptr restrict m
     mne->rgn_entry = entry;
 }
 
+QN_SDK void qn_stor_mne_set_region_host(qn_stor_management_extra_ptr restrict mne, qn_rgn_host_ptr restrict host)
+{
+    mne->rgn_host = host;
+}
+
 // -------- Management Functions (abbreviation: mn) --------
 
-static qn_bool qn_stor_mn_prepare(qn_storage_ptr restrict stor, const qn_string restrict url, const qn_string restrict hostname, const qn_mac_ptr restrict mac)
+static qn_bool qn_stor_mn_prepare_request(qn_storage_ptr restrict stor, qn_http_request_ptr restrict req, const char * restrict url, const qn_string restrict hostname, const qn_mac_ptr restrict mac)
 {
     qn_bool ret;
     qn_string auth_header;
     qn_string new_acctoken;
 
-    if (!qn_stor_prepare_common_request_headers(stor)) return qn_false;
-    if (hostname && !qn_http_req_set_header(stor->req, "Host", qn_str_cstr(hostname))) return qn_false;
+    qn_http_req_set_template(req, stor->tmpl);
+    if (hostname && !qn_http_req_set_header(req, "Host", qn_str_cstr(hostname))) return qn_false;
 
-    new_acctoken = qn_mac_make_acctoken(mac, url, qn_http_req_body_data(stor->req), qn_http_req_body_size(stor->req));
+    new_acctoken = qn_mac_make_acctoken(mac, url, qn_http_req_body_data(req), qn_http_req_body_size(req));
     if (!new_acctoken) return qn_false;
 
     auth_header = qn_cs_sprintf("QBox %s", new_acctoken);
     qn_str_destroy(new_acctoken);
     if (!auth_header) return qn_false;
 
-    ret = qn_http_req_set_header(stor->req, "Authorization", auth_header);
+    ret = qn_http_req_set_header(req, "Authorization", auth_header);
     qn_str_destroy(auth_header);
     return ret;
 }
 
-static const qn_string qn_stor_mn_make_stat_op(const char * restrict bucket, const char * restrict key)
+static inline qn_bool qn_stor_mn_prepare(qn_storage_ptr restrict stor, const qn_string restrict url, const qn_string restrict hostname, const qn_mac_ptr restrict mac)
 {
-    qn_string op;
-    qn_string encoded_uri;
+    return qn_stor_mn_prepare_request(stor, stor->req, url, hostname, mac);
+}
 
-    encoded_uri = qn_misc_encode_uri(bucket, key);
-    if (!encoded_uri) return NULL;
+// -------- Hedged Requests (abbreviation: hdg) --------
 
-    op = qn_cs_sprintf("stat/%s", qn_str_cstr(encoded_uri));
-    qn_str_destroy(encoded_uri);
-    return op;
+// ---- The duplicate lane, which has the same layout of request and response objects as the storage object.
+typedef struct _QN_STOR_HEDGE
+{
+    qn_http_request_ptr req;
+    qn_http_response_ptr resp;
+    qn_http_json_writer_ptr resp_json_wrt;
+    qn_json_object_ptr obj_body;
+    qn_json_object_ptr fake_obj_body;   // Holds the array body of a batch response.
+    qn_json_array_ptr arr_body;         // Owned by the fake object body if any.
+} qn_stor_hedge;
+
+static void qn_stor_hdg_reset(qn_stor_hedge * restrict hdg)
+{
+    qn_http_req_reset(hdg->req);
+    qn_http_resp_reset(hdg->resp);
+
+    if (hdg->obj_body) {
+        qn_json_obj_destroy(hdg->obj_body);
+        hdg->obj_body = NULL;
+    } // if
+    if (hdg->fake_obj_body) {
+        qn_json_obj_destroy(hdg->fake_obj_body);
+        hdg->fake_obj_body = NULL;
+    } // if
+    hdg->arr_body = NULL;
+}
+
+static void qn_stor_hdg_destroy(qn_stor_hedge * restrict hdg)
+{
+    if (hdg) {
+        qn_stor_hdg_reset(hdg);
+        qn_http_json_wrt_destroy(hdg->resp_json_wrt);
+        qn_http_resp_destroy(hdg->resp);
+        qn_http_req_destroy(hdg->req);
+        free(hdg);
+    } // if
+}
+
+static qn_stor_hedge * qn_stor_hdg_create(void)
+{
+    qn_stor_hedge * new_hdg = calloc(1, sizeof(qn_stor_hedge));
+    if (!new_hdg) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    if (!(new_hdg->req = qn_http_req_create()) || !(new_hdg->resp = qn_http_resp_create()) || !(new_hdg->resp_json_wrt = qn_http_json_wrt_create())) {
+        qn_stor_hdg_destroy(new_hdg);
+        return NULL;
+    } // if
+    return new_hdg;
 }
 
 /***************************************************************************//**
-* @ingroup Storage-Management
+* @ingroup Storage-Object
 *
-* Retrieve the meta information of a file.
+* Enable hedged requests for the stat, list and stat-only batch APIs. If the
+* first region entry has not answered within the delay, a duplicate request is
+* sent to the next entry of the region host, and whichever answers first wins.
+* Set the delay around the p95 latency of the APIs, so that only slow requests
+* are duplicated.
+*
+* A completed response, even with a 5xx code, wins over a network failure of
+* the other request. Both requests are sent again according to the retry
+* policy if neither of them gets an answer. With a transport set by
+* qn_stor_set_transport(), which blocks, the duplicate is sent only after the
+* first entry has failed.
 *
 * @param [in] stor The pointer to the storage object.
-* @param [in] auth The pointer to the authorization information. The function
-*                  uses its content to archieve or generate appropriate access
-*                  token.
-* @param [in] bucket The pointer to a string specifies the bucket where the file
-*                    resides.
-* @param [in] key The pointer to a string specifies the file itself.
+* @param [in] delay_ms The delay in milliseconds, or 0 to disable hedging.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_set_hedging_delay(qn_storage_ptr restrict stor, qn_uint32 delay_ms)
+{
+    stor->hdg_delay = delay_ms;
+}
+
+// ---- Choose the host whose entries the request may go to, or NULL if an explicit entry is set.
+static qn_rgn_host_ptr qn_stor_hdg_choose_host(qn_rgn_entry_ptr restrict entry, qn_rgn_host_ptr restrict host, int svc)
+{
+    if (host) return host;
+    if (entry) return NULL;
+    return qn_rgn_tbl_choose_first_host(NULL, svc, NULL);
+}
+
+static inline qn_bool qn_stor_hdg_is_enabled(qn_storage_ptr restrict stor, qn_rgn_host_ptr restrict host)
+{
+    return stor->hdg_delay > 0 && host && qn_rgn_host_entry_count(host) >= 2;
+}
+
+static qn_bool qn_stor_hdg_prepare(qn_storage_ptr restrict stor, qn_rgn_entry_ptr restrict entry, const char * restrict path, const qn_mac_ptr restrict mac, qn_bool post, qn_bool with_arr, qn_string * restrict url)
+{
+    qn_stor_hedge * hdg;
+
+    if (!stor->hdg && !(stor->hdg = qn_stor_hdg_create())) return qn_false;
+    hdg = stor->hdg;
+    qn_stor_hdg_reset(hdg);
+
+    if (!(*url = qn_cs_sprintf("%s%s", qn_str_cstr(entry->base_url), path))) return qn_false;
+
+    // ---- The body data is shared with the primary request, which stays alive until the race is over.
+    if (post) qn_http_req_set_body_data(hdg->req, qn_http_req_body_data(stor->req), qn_http_req_body_size(stor->req));
+    if (!qn_stor_mn_prepare_request(stor, hdg->req, *url, entry->hostname, mac)) goto QN_STOR_HDG_PREPARE_ERROR;
+
+    if (with_arr) {
+        if (!(hdg->fake_obj_body = qn_json_obj_create())) goto QN_STOR_HDG_PREPARE_ERROR;
+        if (!qn_json_obj_set_integer(hdg->fake_obj_body, "fn-code", 0) || !qn_json_obj_set_cstr(hdg->fake_obj_body, "fn-error", "OK")) goto QN_STOR_HDG_PREPARE_ERROR;
+        if (!(hdg->arr_body = qn_json_obj_set_new_empty_array(hdg->fake_obj_body, "items"))) goto QN_STOR_HDG_PREPARE_ERROR;
+        qn_http_json_wrt_prepare(hdg->resp_json_wrt, &hdg->obj_body, &hdg->arr_body);
+    } else {
+        if (!(hdg->obj_body = qn_json_obj_create())) goto QN_STOR_HDG_PREPARE_ERROR;
+        if (!qn_json_obj_set_integer(hdg->obj_body, "fn-code", 0) || !qn_json_obj_set_cstr(hdg->obj_body, "fn-error", "OK")) goto QN_STOR_HDG_PREPARE_ERROR;
+        qn_http_json_wrt_prepare(hdg->resp_json_wrt, &hdg->obj_body, NULL);
+    } // if
+    qn_http_resp_set_data_writer(hdg->resp, hdg->resp_json_wrt, &qn_http_json_wrt_write_cfn);
+    return qn_true;
+
+QN_STOR_HDG_PREPARE_ERROR:
+    qn_str_destroy(*url);
+    *url = NULL;
+    return qn_false;
+}
+
+// ---- Make the duplicate lane's answer the storage object's, as if it came through the primary lane.
+static void qn_stor_hdg_swap(qn_storage_ptr restrict stor, qn_json_object_ptr * restrict fake_obj_body)
+{
+    qn_stor_hedge * hdg = stor->hdg;
+    qn_http_request_ptr req = stor->req;
+    qn_http_response_ptr resp = stor->resp;
+    qn_http_json_writer_ptr resp_json_wrt = stor->resp_json_wrt;
+    qn_json_object_ptr obj_body = stor->obj_body;
+    qn_json_array_ptr arr_body = stor->arr_body;
+
+    stor->req = hdg->req;
+    stor->resp = hdg->resp;
+    stor->resp_json_wrt = hdg->resp_json_wrt;
+    stor->obj_body = hdg->obj_body;
+    stor->arr_body = hdg->arr_body;
+
+    hdg->req = req;
+    hdg->resp = resp;
+    hdg->resp_json_wrt = resp_json_wrt;
+    hdg->obj_body = obj_body;
+    hdg->arr_body = arr_body;
+
+    if (fake_obj_body) {
+        obj_body = *fake_obj_body;
+        *fake_obj_body = hdg->fake_obj_body;
+        hdg->fake_obj_body = obj_body;
+    } // if
+}
+
+// ---- The outcome of a race between the primary lane and the duplicate one.
+typedef struct _QN_STOR_HEDGE_RESULT
+{
+    qn_http_request_ptr winner;
+    qn_http_response_ptr resp;
+    qn_err_code_em err_code;
+    qn_bool answered;
+} qn_stor_hedge_result;
+
+// ---- An answer below 5xx wins at once, otherwise a completed response beats a failure, and the earlier one beats the later.
+static void qn_stor_hdg_pick(qn_stor_hedge_result * restrict hr, qn_http_request_ptr restrict req, qn_http_response_ptr restrict resp, qn_err_code_em err_code)
+{
+    if (err_code == QN_ERR_SUCCEED && qn_http_resp_get_code(resp) < 500) {
+        hr->answered = qn_true;
+    } else if (hr->winner && (hr->err_code == QN_ERR_SUCCEED || err_code != QN_ERR_SUCCEED)) {
+        return;
+    } // if
+    hr->winner = req;
+    hr->resp = resp;
+    hr->err_code = err_code;
+}
+
+// ---- Race both lanes on a multi object, and send a duplicate to the second entry if the first one is late or fails.
+static qn_bool qn_stor_hdg_race(qn_storage_ptr restrict stor, qn_rgn_host_ptr restrict host, const char * restrict url, const char * restrict path, const qn_mac_ptr restrict mac, qn_bool post, qn_bool with_arr, qn_stor_hedge_result * restrict hr)
+{
+    qn_http_multi_ptr mt;
+    qn_http_multi_result_st rs;
+    qn_string hdg_url = NULL;
+    qn_uint64 deadline;
+    qn_uint64 now;
+    int pending = 0;
+    int wait_ms;
+    qn_bool hedged = qn_false;
+
+    if (!(mt = qn_http_multi_create())) return qn_false;
+    qn_http_multi_set_version(mt, stor->ver);
+    qn_http_multi_set_compression(mt, qn_true);
+    qn_http_multi_set_tuning_profile(mt, QN_HTTP_TUNING_INTERACTIVE);
+
+    if (!(post ? qn_http_multi_submit_post : qn_http_multi_submit_get)(mt, url, stor->req, stor->resp, NULL)) {
+        qn_http_multi_destroy(mt);
+        return qn_false;
+    } // if
+    pending += 1;
+    deadline = qn_tm_monotonic_microseconds() + (qn_uint64)stor->hdg_delay * 1000;
+
+    while (!hr->answered && (pending > 0 || !hedged)) {
+        if (!hedged) {
+            now = qn_tm_monotonic_microseconds();
+            wait_ms = (now < deadline && pending > 0) ? (int)((deadline - now + 999) / 1000) : 0;
+            if (wait_ms == 0) {
+                // ---- The first entry is late or has failed, so ask the next one.
+                hedged = qn_true;
+                if (qn_stor_hdg_prepare(stor, qn_rgn_host_get_entry(host, 1), path, mac, post, with_arr, &hdg_url)) {
+                    if ((post ? qn_http_multi_submit_post : qn_http_multi_submit_get)(mt, hdg_url, stor->hdg->req, stor->hdg->resp, NULL)) pending += 1;
+                    qn_str_destroy(hdg_url);
+                } // if
+                if (pending == 0) break;
+                continue;
+            } // if
+        } else {
+            wait_ms = 1000;
+        } // if
+
+        if (!qn_http_multi_poll(mt, wait_ms, NULL)) break;
+        while (!hr->answered && qn_http_multi_complete(mt, &rs)) {
+            pending -= 1;
+            qn_stor_hdg_pick(hr, rs.req, rs.resp, rs.err_code);
+        } // while
+    } // while
+
+    // ---- Destroying the multi object cancels the losing request.
+    qn_http_multi_destroy(mt);
+    return hr->winner != NULL;
+}
+
+// ---- A custom transport is blocking, so the duplicate is sent only after the first entry has failed.
+static qn_bool qn_stor_hdg_fail_over(qn_storage_ptr restrict stor, qn_rgn_host_ptr restrict host, const char * restrict url, const char * restrict path, const qn_mac_ptr restrict mac, qn_bool post, qn_bool with_arr, qn_stor_hedge_result * restrict hr)
+{
+    qn_string hdg_url = NULL;
+    qn_bool ret;
+
+    ret = (post) ? qn_http_conn_post(stor->conn, url, stor->req, stor->resp) : qn_http_conn_get(stor->conn, url, stor->req, stor->resp);
+    qn_stor_hdg_pick(hr, stor->req, stor->resp, (ret) ? QN_ERR_SUCCEED : qn_err_get_code());
+    if (hr->answered) return qn_true;
+
+    if (qn_stor_hdg_prepare(stor, qn_rgn_host_get_entry(host, 1), path, mac, post, with_arr, &hdg_url)) {
+        ret = (post) ? qn_http_conn_post(stor->conn, hdg_url, stor->hdg->req, stor->hdg->resp) : qn_http_conn_get(stor->conn, hdg_url, stor->hdg->req, stor->hdg->resp);
+        qn_stor_hdg_pick(hr, stor->hdg->req, stor->hdg->resp, (ret) ? QN_ERR_SUCCEED : qn_err_get_code());
+        qn_str_destroy(hdg_url);
+    } // if
+    return qn_true;
+}
+
+// ---- Make the primary lane ready for another race, including the array of a batch response.
+static qn_bool qn_stor_hdg_reprepare_result(qn_storage_ptr restrict stor, qn_json_object_ptr * restrict fake_obj_body)
+{
+    if (!fake_obj_body) return qn_stor_rtp_reprepare_result(stor);
+
+    if (stor->obj_body) {
+        qn_json_obj_destroy(stor->obj_body);
+        stor->obj_body = NULL;
+    } // if
+    if (!(stor->arr_body = qn_json_obj_set_new_empty_array(*fake_obj_body, "items"))) return qn_false;
+
+    qn_http_resp_reset(stor->resp);
+    qn_http_json_wrt_prepare(stor->resp_json_wrt, &stor->obj_body, &stor->arr_body);
+    qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
+    return qn_true;
+}
+
+// ---- Send the prepared request to the first entry of the host, and a duplicate to the second one if it is late or fails.
+static qn_bool qn_stor_hdg_send(qn_storage_ptr restrict stor, qn_rgn_host_ptr restrict host, const char * restrict url, const char * restrict path, const qn_mac_ptr restrict mac, qn_bool post, qn_json_object_ptr * restrict fake_obj_body)
+{
+    qn_stor_hedge_result hr;
+    qn_bool ret;
+    int attempt = 0;
+
+    qn_http_conn_set_tuning_profile(stor->conn, QN_HTTP_TUNING_INTERACTIVE);
+    qn_http_conn_set_compression(stor->conn, qn_true);
+
+    while (1) {
+        attempt += 1;
+        memset(&hr, 0, sizeof(hr));
+        ret = (stor->tpt) ? qn_stor_hdg_fail_over(stor, host, url, path, mac, post, fake_obj_body != NULL, &hr) : qn_stor_hdg_race(stor, host, url, path, mac, post, fake_obj_body != NULL, &hr);
+        if (!ret) return qn_false;
+        if (hr.err_code != QN_ERR_SUCCEED) qn_err_set_code(hr.err_code, 0, __FILE__, __LINE__);
+
+        // ---- Hedged APIs are idempotent, so both lanes race again as long as the retry policy allows.
+        if (hr.answered || ! stor->rtp || attempt >= stor->rtp->max_attempts) break;
+        if (hr.err_code == QN_ERR_SUCCEED) {
+            if (! qn_stor_rtp_is_transient_status(qn_http_resp_get_code(hr.resp))) break;
+        } else if (! qn_stor_rtp_is_transient_error()) {
+            break;
+        } // if
+
+        if (! qn_stor_hdg_reprepare_result(stor, fake_obj_body)) return qn_false;
+        qn_stor_rtp_wait(stor, attempt);
+    } // while
+
+    if (hr.winner != stor->req) qn_stor_hdg_swap(stor, fake_obj_body);
+    return hr.err_code == QN_ERR_SUCCEED;
+}
+
+static const qn_string qn_stor_mn_make_stat_op(const char * restrict bucket, const char * restrict key)
+{
+    qn_string op;
+    qn_string encoded_uri;
+
+    encoded_uri = qn_misc_encode_uri(bucket, key);
+    if (!encoded_uri) return NULL;
+
+    op = qn_cs_sprintf("stat/%s", qn_str_cstr(encoded_uri));
+    qn_str_destroy(encoded_uri);
+    return op;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Management
+*
+* Retrieve the meta information of a file.
+*
+* @param [in] stor The pointer to the storage object.
+* @param [in] auth The pointer to the authorization information. The function
+*                  uses its content to archieve or generate appropriate access
+*                  token.
+* @param [in] bucket The pointer to a string specifies the bucket where the file
+*                    resides.
+* @param [in] key The pointer to a string specifies the file itself.
 * @param [in] ext The pointer to an extra option structure. The function uses
 *                 options set in it to tune actual behaviors.
 *
@@ -239,6 +1066,13 @@ static const qn_string qn_stor_mn_make_stat_op(const char * restrict bucket, con
 *         if the HTTP response returns successfully, no matter the API's operation
 *         succeeds or not.
 *
+*         The `fn-namelookup-time`, `fn-connect-time`, `fn-appconnect-time`,
+*         `fn-pretransfer-time`, `fn-starttransfer-time` and `fn-total-time`
+*         fields hold the elapsed microseconds from the start of the request
+*         to the end of each phase, and the `fn-bytes-up` and `fn-bytes-down`
+*         fields hold the bytes sent and received. They are returned along with
+*         the `fn-code` field.
+*
 *         Other fields are returned only in the case that the API's operation
 *         succeeds.
 *
@@ -272,7 +1106,9 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_stat(qn_storage_ptr restrict stor, cons
     qn_bool ret;
     qn_string op;
     qn_string url;
+    qn_string path;
     qn_rgn_entry_ptr rgn_entry;
+    qn_rgn_host_ptr rgn_host;
 
     assert(stor);
     assert(mac);
@@ -287,34 +1123,47 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_stat(qn_storage_ptr restrict stor, cons
         qn_rgn_tbl_choose_first_entry(NULL, QN_RGN_SVC_RS, NULL, &rgn_entry);
     } // if
 
+    rgn_host = qn_stor_hdg_choose_host((mne) ? mne->rgn_entry : NULL, (mne) ? mne->rgn_host : NULL, QN_RGN_SVC_RS);
+    if (rgn_host && qn_rgn_host_entry_count(rgn_host) > 0) rgn_entry = qn_rgn_host_get_entry(rgn_host, 0);
+
     // ---- Prepare the stat URL.
     op = qn_stor_mn_make_stat_op(bucket, key);
     if (!op) return NULL;
 
-    url = qn_cs_sprintf("%s/%s", qn_str_cstr(rgn_entry->base_url), qn_str_cstr(op));
+    path = qn_cs_sprintf("/%s", qn_str_cstr(op));
     qn_str_destroy(op);
-    if (!url) return NULL;
+    if (!path) return NULL;
+
+    url = qn_cs_sprintf("%s%s", qn_str_cstr(rgn_entry->base_url), qn_str_cstr(path));
+    if (!url) {
+        qn_str_destroy(path);
+        return NULL;
+    } // if
 
     // ---- Prepare the request and response.
     qn_stor_reset(stor);
 
     if (! qn_stor_mn_prepare(stor, url, rgn_entry->hostname, mac)) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
     if (! (stor->obj_body = qn_json_obj_create())) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
     if (! (qn_json_obj_set_integer(stor->obj_body, "fn-code", 0))) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
     if (! (qn_json_obj_set_cstr(stor->obj_body, "fn-error", "OK"))) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
@@ -322,11 +1171,16 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_stat(qn_storage_ptr restrict stor, cons
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the stat action.
-    ret = qn_http_conn_get(stor->conn, url, stor->req, stor->resp);
+    if (qn_stor_hdg_is_enabled(stor, rgn_host)) {
+        ret = qn_stor_hdg_send(stor, rgn_host, url, path, mac, qn_false, NULL);
+    } else {
+        ret = qn_stor_send(stor, QN_STOR_API_IDEMPOTENT | QN_STOR_API_RESENDABLE, url, qn_false);
+    } // if
     qn_str_destroy(url);
+    qn_str_destroy(path);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -488,11 +1342,11 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_copy(qn_storage_ptr restrict stor, cons
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the copy action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_RESENDABLE, url, qn_true);
     qn_str_destroy(url);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -643,11 +1497,11 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_move(qn_storage_ptr restrict stor, cons
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the move action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_RESENDABLE, url, qn_true);
     qn_str_destroy(url);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -782,11 +1636,11 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_delete(qn_storage_ptr restrict stor, co
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the delete action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_RESENDABLE, url, qn_true);
     qn_str_destroy(url);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -917,11 +1771,11 @@ QN_SDK qn_json_object_ptr qn_stor_mn_api_chgm(qn_storage_ptr restrict stor, cons
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the change mime action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_IDEMPOTENT | QN_STOR_API_RESENDABLE, url, qn_true);
     qn_str_destroy(url);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -933,6 +1787,7 @@ typedef struct _QN_STOR_BATCH
     qn_string * ops;
     int cnt;
     int cap;
+    int writes; // The number of operations that change files, which must not be sent twice.
 } qn_stor_batch;
 
 QN_SDK qn_stor_batch_ptr qn_stor_bt_create(void)
@@ -965,6 +1820,7 @@ QN_SDK void qn_stor_bt_destroy(qn_stor_batch_ptr restrict bt)
 QN_SDK void qn_stor_bt_reset(qn_stor_batch_ptr restrict bt)
 {
     while (bt->cnt > 0) qn_str_destroy(bt->ops[--bt->cnt]);
+    bt->writes = 0;
 }
 
 static qn_bool qn_stor_bt_augment(qn_stor_batch_ptr restrict bt)
@@ -1023,6 +1879,7 @@ QN_SDK qn_bool qn_stor_bt_add_copy_op(qn_stor_batch_ptr restrict bt, const char
     if (!op) return qn_false;
 
     ret = qn_stor_bt_add_op(bt, op);
+    if (ret) bt->writes += 1;
     qn_str_destroy(op);
     return ret;
 }
@@ -1036,6 +1893,7 @@ QN_SDK qn_bool qn_stor_bt_add_move_op(qn_stor_batch_ptr restrict bt, const char
     if (!op) return qn_false;
 
     ret = qn_stor_bt_add_op(bt, op);
+    if (ret) bt->writes += 1;
     qn_str_destroy(op);
     return ret;
 }
@@ -1049,6 +1907,7 @@ QN_SDK qn_bool qn_stor_bt_add_delete_op(qn_stor_batch_ptr restrict bt, const cha
     if (!op) return qn_false;
 
     ret = qn_stor_bt_add_op(bt, op);
+    if (ret) bt->writes += 1;
     qn_str_destroy(op);
     return ret;
 }
@@ -1062,6 +1921,7 @@ QN_SDK qn_json_object_ptr qn_stor_bt_api_batch(qn_storage_ptr restrict stor, con
     qn_string url;
     qn_json_object_ptr fake_obj_body;
     qn_rgn_entry_ptr rgn_entry;
+    qn_rgn_host_ptr rgn_host;
 
     assert(stor);
     assert(mac);
@@ -1075,6 +1935,11 @@ QN_SDK qn_json_object_ptr qn_stor_bt_api_batch(qn_storage_ptr restrict stor, con
         qn_rgn_tbl_choose_first_entry(NULL, QN_RGN_SVC_RS, NULL, &rgn_entry);
     } // if
 
+    // ---- Only batches of stat operations are safe to send twice.
+    rgn_host = qn_stor_hdg_choose_host((mne) ? mne->rgn_entry : NULL, (mne) ? mne->rgn_host : NULL, QN_RGN_SVC_RS);
+    if (rgn_host && qn_rgn_host_entry_count(rgn_host) > 0) rgn_entry = qn_rgn_host_get_entry(rgn_host, 0);
+    if (bt->writes > 0) rgn_host = NULL;
+
     // ---- Prepare the batch URL.
     body = qn_str_join_list("&", bt->ops, bt->cnt);
     if (!body) return NULL;
@@ -1125,7 +1990,11 @@ QN_SDK qn_json_object_ptr qn_stor_bt_api_batch(qn_storage_ptr restrict stor, con
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the batch action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    if (qn_stor_hdg_is_enabled(stor, rgn_host)) {
+        ret = qn_stor_hdg_send(stor, rgn_host, url, "/batch", mac, qn_true, &fake_obj_body);
+    } else {
+        ret = qn_stor_send(stor, 0, url, qn_true);
+    } // if
     qn_str_destroy(url);
     qn_str_destroy(body);
     stor->arr_body = NULL; // Keep from destroying the array twice.
@@ -1139,7 +2008,7 @@ QN_SDK qn_json_object_ptr qn_stor_bt_api_batch(qn_storage_ptr restrict stor, con
         stor->obj_body = fake_obj_body;
     } // if
 
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -1155,6 +2024,7 @@ typedef struct _QN_STOR_LIST_EXTRA
 
     qn_http_query_ptr qry;
     qn_rgn_entry_ptr rgn_entry;
+    qn_rgn_host_ptr rgn_host;
 } qn_stor_list_extra_st;
 
 QN_SDK qn_stor_list_extra_ptr qn_stor_lse_create(void)
@@ -1190,6 +2060,7 @@ QN_SDK void qn_stor_lse_reset(qn_stor_list_extra_ptr restrict lse)
     lse->marker = NULL;
     lse->limit = 1000;
     lse->rgn_entry = NULL;
+    lse->rgn_host = NULL;
 }
 
 QN_SDK void qn_stor_lse_set_prefix(qn_stor_list_extra_ptr restrict lse, const char * restrict prefix, const char * restrict delimiter)
@@ -1208,6 +2079,11 @@ QN_SDK void qn_stor_lse_set_limit(qn_stor_list_extra_ptr restrict lse, qn_uint32
     lse->limit = limit;
 }
 
+QN_SDK void qn_stor_lse_set_region_host(qn_stor_list_extra_ptr restrict lse, qn_rgn_host_ptr restrict host)
+{
+    lse->rgn_host = host;
+}
+
 // -------- List Functions (abbreviation: ls) --------
 
 /***************************************************************************//**
@@ -1306,9 +2182,11 @@ QN_SDK qn_json_object_ptr qn_stor_ls_api_list(qn_storage_ptr restrict stor, cons
 {
     qn_bool ret;
     qn_string url;
+    qn_string path;
     qn_string qry_str;
     qn_http_query_ptr qry;
     qn_rgn_entry_ptr rgn_entry;
+    qn_rgn_host_ptr rgn_host;
     int limit = 1000;
 
     assert(stor);
@@ -1348,10 +2226,19 @@ QN_SDK qn_json_object_ptr qn_stor_ls_api_list(qn_storage_ptr restrict stor, cons
     if (! lse) qn_http_qry_destroy(qry);
     if (! qry_str) return NULL;
 
-    // ---- Prepare the copy URL.
-    url = qn_cs_sprintf("%s/list?%s", qn_str_cstr(rgn_entry->base_url), qn_str_cstr(qry_str));
+    rgn_host = qn_stor_hdg_choose_host((lse) ? lse->rgn_entry : NULL, (lse) ? lse->rgn_host : NULL, QN_RGN_SVC_RSF);
+    if (rgn_host && qn_rgn_host_entry_count(rgn_host) > 0) rgn_entry = qn_rgn_host_get_entry(rgn_host, 0);
+
+    // ---- Prepare the list URL.
+    path = qn_cs_sprintf("/list?%s", qn_str_cstr(qry_str));
     qn_str_destroy(qry_str);
-    if (! url) return NULL;
+    if (! path) return NULL;
+
+    url = qn_cs_sprintf("%s%s", qn_str_cstr(rgn_entry->base_url), qn_str_cstr(path));
+    if (! url) {
+        qn_str_destroy(path);
+        return NULL;
+    } // if
 
     // ---- Prepare the request and response.
     qn_stor_reset(stor);
@@ -1360,21 +2247,25 @@ QN_SDK qn_json_object_ptr qn_stor_ls_api_list(qn_storage_ptr restrict stor, cons
 
     if (! qn_stor_mn_prepare(stor, url, rgn_entry->hostname, mac)) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
     if (! (stor->obj_body = qn_json_obj_create())) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
     if (! (qn_json_obj_set_integer(stor->obj_body, "fn-code", 0))) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
     if (! (qn_json_obj_set_cstr(stor->obj_body, "fn-error", "OK"))) {
         qn_str_destroy(url);
+        qn_str_destroy(path);
         return NULL;
     } // if
 
@@ -1382,11 +2273,16 @@ QN_SDK qn_json_object_ptr qn_stor_ls_api_list(qn_storage_ptr restrict stor, cons
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the list action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    if (qn_stor_hdg_is_enabled(stor, rgn_host)) {
+        ret = qn_stor_hdg_send(stor, rgn_host, url, path, mac, qn_true, NULL);
+    } else {
+        ret = qn_stor_send(stor, QN_STOR_API_IDEMPOTENT | QN_STOR_API_RESENDABLE, url, qn_true);
+    } // if
     qn_str_destroy(url);
+    qn_str_destroy(path);
     if (! ret) return NULL;
 
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (! qn_json_obj_rename(stor->obj_body, "error", "fn-error") && ! qn_err_is_no_such_entry()) return NULL;
     return stor->obj_body;
 }
@@ -1573,11 +2469,11 @@ QN_SDK qn_json_object_ptr qn_stor_ft_api_fetch(qn_storage_ptr restrict stor, con
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the fetch action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_RESENDABLE, url, qn_true);
     qn_str_destroy(url);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -1713,11 +2609,11 @@ QN_SDK qn_json_object_ptr qn_stor_ft_api_prefetch(qn_storage_ptr restrict stor,
     qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
 
     // ---- Do the prefetch action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_IDEMPOTENT | QN_STOR_API_RESENDABLE, url, qn_true);
     qn_str_destroy(url);
 
     if (!ret) return NULL;
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -2202,10 +3098,10 @@ QN_SDK qn_json_object_ptr qn_stor_up_api_upload_file(qn_storage_ptr restrict sto
     if (rgn_entry->hostname && !qn_http_req_set_header(stor->req, "Host", qn_str_cstr(rgn_entry->hostname))) return NULL;
 
     // ----
-    ret = qn_http_conn_post(stor->conn, qn_str_cstr(rgn_entry->base_url), stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_RESENDABLE | QN_STOR_API_BULK, qn_str_cstr(rgn_entry->base_url), qn_true);
     if (!ret) return NULL;
 
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -2239,10 +3135,10 @@ QN_SDK qn_json_object_ptr qn_stor_up_api_upload_buffer(qn_storage_ptr restrict s
 
     // ----
     if (rgn_entry->hostname && !qn_http_req_set_header(stor->req, "Host", qn_str_cstr(rgn_entry->hostname))) return NULL;
-    ret = qn_http_conn_post(stor->conn, qn_str_cstr(rgn_entry->base_url), stor->req, stor->resp);
+    ret = qn_stor_send(stor, QN_STOR_API_RESENDABLE | QN_STOR_API_BULK, qn_str_cstr(rgn_entry->base_url), qn_true);
     if (!ret) return NULL;
 
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -2257,16 +3153,11 @@ static size_t qn_stor_upload_cfn(void * user_data, char * buf, size_t size)
     return ret;
 }
 
-QN_SDK qn_json_object_ptr qn_stor_up_api_upload(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_upload_extra_ptr restrict upe)
+static qn_rgn_entry_ptr qn_stor_up_prepare_upload(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_upload_extra_ptr restrict upe)
 {
     const char * mime_type = NULL;
-    qn_bool ret;
     qn_rgn_entry_ptr rgn_entry;
 
-    assert(stor);
-    assert(uptoken);
-    assert(data_rdr);
-
     if (upe) {
         if (! (rgn_entry = upe->rgn_entry)) qn_rgn_tbl_choose_first_entry(NULL, QN_RGN_SVC_UP, NULL, &rgn_entry);
         mime_type = upe->mime_type;
@@ -2276,35 +3167,90 @@ QN_SDK qn_json_object_ptr qn_stor_up_api_upload(qn_storage_ptr restrict stor, co
     } // if
 
     if (! qn_stor_up_prepare_for_upload(stor, uptoken, upe)) return NULL;
-
-    ret = qn_http_form_add_file_reader(qn_http_req_get_form(stor->req), "file", qn_str_cstr(qn_io_rdr_name(data_rdr)), NULL, qn_io_rdr_size(data_rdr), mime_type, stor->req);
-    if (! ret) return NULL;
-
-    qn_http_req_set_body_reader(stor->req, data_rdr, qn_stor_upload_cfn, qn_io_rdr_size(data_rdr));
+    if (! qn_http_form_add_reader(qn_http_req_get_form(stor->req), "file", NULL, data_rdr, mime_type)) return NULL;
 
     // ----
     if (rgn_entry->hostname && !qn_http_req_set_header(stor->req, "Host", qn_str_cstr(rgn_entry->hostname))) return NULL;
-    ret = qn_http_conn_post(stor->conn, qn_str_cstr(rgn_entry->base_url), stor->req, stor->resp);
+    return rgn_entry;
+}
+
+QN_SDK qn_json_object_ptr qn_stor_up_api_upload(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_bool ret;
+    qn_rgn_entry_ptr rgn_entry;
+
+    assert(stor);
+    assert(uptoken);
+    assert(data_rdr);
+
+    if (! (rgn_entry = qn_stor_up_prepare_upload(stor, uptoken, data_rdr, upe))) return NULL;
+    ret = qn_stor_send(stor, QN_STOR_API_BULK, qn_str_cstr(rgn_entry->base_url), qn_true);
     if (! ret) return NULL;
 
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (! qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
 
 // -------- Resumable Upload Object (abbreviation: ru) --------
 
+enum
+{
+    QN_STOR_RU_ARENA_PAGE_SIZE = (1024 * 64)
+};
+
+// ---- Contexts of all blocks are packed into pages which never move, so that blocks can point into them.
+typedef struct _QN_STOR_RU_ARENA_PAGE
+{
+    struct _QN_STOR_RU_ARENA_PAGE * next;
+    qn_uint32 used;
+    qn_uint32 cap;
+    char data[];
+} qn_stor_ru_arena_page_st, *qn_stor_ru_arena_page_ptr;
+
+typedef struct _QN_STOR_RU_BLOCK
+{
+    char * ctx;                     // Not NUL-terminated, NULL if the block has never been put.
+    qn_string host;                 // Shared by all blocks put to the same host.
+    qn_uint32 crc32;
+    qn_uint16 ctx_size;
+    qn_uint16 ctx_cap;
+    int offset;
+    int bsize;
+} qn_stor_ru_block_st;
+
 typedef struct _QN_STOR_RESUMABLE_UPLOAD
 {
     qn_io_reader_ptr rdr_vtbl;
-    qn_json_object_ptr progress;
     qn_io_reader_itf src_rdr;
+
+    qn_stor_ru_block_ptr blks;
     int blk_cnt;
+    int blk_used;                   // Number of blocks in the table, which grows block by block only if the file size is unknown.
+    int blk_cap;
+
+    qn_string * hosts;
+    int host_cnt;
+    qn_stor_ru_arena_page_ptr arena;
+
     int ctx_idx;
-    int ctx_pos:16;
-    int need_comma:1;
+    int ctx_pos;
+    qn_bool need_comma;
+    qn_fsize ctx_total;             // Sum of the sizes of all contexts.
+
     qn_fsize fsize;
     qn_fsize uploaded_fsize;
+
+    // ---- Checkpoint journal.
+    qn_fl_writer_ptr jnl;
+    qn_string jnl_fname;
+    qn_uint64 jnl_sync_time;        // When the journal was synced last time, in microseconds.
+    qn_uint32 jnl_sync_ms;
+    qn_uint32 jnl_sync_bytes;
+    qn_uint32 jnl_unsynced;         // Bytes of records appended since the last sync.
+    int jnl_rec_cnt;                // Records appended since the journal was rewritten.
+    qn_bool jnl_broken;             // An append failed half way, so the journal must be rewritten before going on.
+    int jnl_host_cnt;               // Hosts written into the journal.
 } qn_stor_resumable_upload_st;
 
 static inline qn_stor_resumable_upload_ptr qn_stor_ru_ctx_from_io_reader(qn_io_reader_itf restrict itf)
@@ -2314,46 +3260,37 @@ static inline qn_stor_resumable_upload_ptr qn_stor_ru_ctx_from_io_reader(qn_io_r
 
 static ssize_t qn_stor_ru_ctx_rdr_read_vfn(qn_io_reader_itf restrict itf, char * restrict buf, size_t buf_size)
 {
-    qn_json_array_ptr blk_arr;
-    qn_json_object_ptr blk_info = NULL;
-    qn_string ctx;
+    qn_stor_ru_block_ptr blk;
     qn_stor_resumable_upload_ptr ru = qn_stor_ru_ctx_from_io_reader(itf);
     char * pos = buf;
     size_t rem_size = buf_size;
     int copy_bytes;
 
-    blk_arr = NULL;
-    if (! qn_json_obj_get_array(ru->progress, "blocks", &blk_arr)) return -1;
+    while (rem_size > 0 && ru->ctx_idx < ru->blk_used) {
+        blk = &ru->blks[ru->ctx_idx];
+        if (! blk->ctx) {
+            qn_err_stor_set_lack_of_block_context();
+            return -1;
+        } // if
 
-    while (rem_size > 0 && ru->ctx_idx < qn_json_arr_size(blk_arr)) {
         if (ru->need_comma) {
             *pos++ = ',';
             rem_size -= 1;
+            ru->need_comma = qn_false;
         } // if
 
-        if (! qn_json_arr_get_object(blk_arr, ru->ctx_idx, &blk_info)) return -1;
-
-        ctx = NULL;
-        if (! qn_json_obj_get_string(blk_info, "ctx", &ctx)) return -1;
-        if (! ctx) {
-            qn_err_stor_set_lack_of_block_context();
-            return -1;
-        } // if
-
-        copy_bytes = qn_str_size(ctx) - ru->ctx_pos;
+        copy_bytes = blk->ctx_size - ru->ctx_pos;
         if (rem_size < copy_bytes) copy_bytes = rem_size;
 
-        if (copy_bytes > 0) {
-            memcpy(pos, qn_str_cstr(ctx) + ru->ctx_pos, copy_bytes);
-            pos += copy_bytes;
-            rem_size -= copy_bytes;
-            ru->ctx_pos += copy_bytes;
+        memcpy(pos, blk->ctx + ru->ctx_pos, copy_bytes);
+        pos += copy_bytes;
+        rem_size -= copy_bytes;
+        ru->ctx_pos += copy_bytes;
 
-            if (ru->ctx_pos == qn_str_size(ctx)) {
-                ru->need_comma = 1;
-                ru->ctx_pos = 0;
-                ru->ctx_idx += 1;
-            } // if
+        if (ru->ctx_pos == blk->ctx_size) {
+            ru->need_comma = qn_true;
+            ru->ctx_pos = 0;
+            ru->ctx_idx += 1;
         } // if
     } // while
     return buf_size - rem_size;
@@ -2361,30 +3298,8 @@ static ssize_t qn_stor_ru_ctx_rdr_read_vfn(qn_io_reader_itf restrict itf, char *
 
 static qn_fsize qn_stor_ru_ctx_rdr_size_vfn(qn_io_reader_itf restrict itf)
 {
-    qn_json_array_ptr blk_arr;
-    qn_json_object_ptr blk_info = NULL;
-    qn_string ctx;
-    int i;
-    qn_fsize size;
     qn_stor_resumable_upload_ptr ru = qn_stor_ru_ctx_from_io_reader(itf);
-
-    blk_arr = NULL;
-    if (! qn_json_obj_get_array(ru->progress, "blocks", &blk_arr)) return 0;
-
-    size = 0;
-    for (i = 0; i < qn_json_arr_size(blk_arr); i += 1) {
-        if (! qn_json_arr_get_object(blk_arr, i, &blk_info)) return 0;
-        ctx = NULL;
-        if (! qn_json_obj_get_string(blk_info, "ctx", &ctx)) return 0;
-        if (! ctx) {
-            qn_err_stor_set_lack_of_block_context();
-            return 0;
-        } // if
-        size += qn_str_size(ctx);
-    } // if
-
-    size += qn_json_arr_size(blk_arr) - 1;
-    return size;
+    return (ru->blk_used > 0) ? ru->ctx_total + ru->blk_used - 1 : 0;
 }
 
 static qn_io_reader_st qn_stor_ru_ctx_rdr_vtable = {
@@ -2396,7 +3311,8 @@ static qn_io_reader_st qn_stor_ru_ctx_rdr_vtable = {
     NULL, // DUPLICATE
     NULL, // SECTION
     NULL, // NAME
-    &qn_stor_ru_ctx_rdr_size_vfn  // SIZE
+    &qn_stor_ru_ctx_rdr_size_vfn, // SIZE
+    NULL // PREFETCH
 };
 
 static inline int qn_stor_ru_calculate_block_count(qn_fsize fsize)
@@ -2404,6 +3320,104 @@ static inline int qn_stor_ru_calculate_block_count(qn_fsize fsize)
     return (fsize + QN_STOR_RU_BLOCK_MAX_SIZE - 1) / QN_STOR_RU_BLOCK_MAX_SIZE;
 }
 
+static inline int qn_stor_ru_calculate_block_size(qn_stor_resumable_upload_ptr restrict ru, int blk_idx)
+{
+    int blk_size;
+
+    // -- The size of the source reader is unknown, or the block is not the last one.
+    if (ru->blk_cnt == 0 || blk_idx < ru->blk_cnt - 1) return QN_STOR_RU_BLOCK_MAX_SIZE;
+
+    blk_size = (int)(ru->fsize & (QN_STOR_RU_BLOCK_MAX_SIZE - 1));
+    return (blk_size == 0) ? QN_STOR_RU_BLOCK_MAX_SIZE : blk_size;
+}
+
+static qn_bool qn_stor_ru_reserve_blocks(qn_stor_resumable_upload_ptr restrict ru, int cnt)
+{
+    int new_cap;
+    qn_stor_ru_block_ptr new_blks;
+
+    if (cnt <= ru->blk_cap) return qn_true;
+
+    new_cap = (ru->blk_cap > 0) ? ru->blk_cap + (ru->blk_cap >> 1) : 8;
+    if (new_cap < cnt) new_cap = cnt;
+
+    new_blks = realloc(ru->blks, sizeof(qn_stor_ru_block_st) * new_cap);
+    if (! new_blks) {
+        qn_err_set_out_of_memory();
+        return qn_false;
+    } // if
+
+    memset(new_blks + ru->blk_cap, 0, sizeof(qn_stor_ru_block_st) * (new_cap - ru->blk_cap));
+    ru->blks = new_blks;
+    ru->blk_cap = new_cap;
+    return qn_true;
+}
+
+// ---- Fill the table up to the block count, so that the table never moves once the file size is known.
+static qn_bool qn_stor_ru_init_blocks(qn_stor_resumable_upload_ptr restrict ru)
+{
+    if (! qn_stor_ru_reserve_blocks(ru, ru->blk_cnt)) return qn_false;
+    for (; ru->blk_used < ru->blk_cnt; ru->blk_used += 1) {
+        ru->blks[ru->blk_used].bsize = qn_stor_ru_calculate_block_size(ru, ru->blk_used);
+    } // for
+    return qn_true;
+}
+
+static qn_bool qn_stor_ru_set_block_context(qn_stor_resumable_upload_ptr restrict ru, qn_stor_ru_block_ptr restrict blk, const char * restrict ctx, qn_size ctx_size)
+{
+    qn_stor_ru_arena_page_ptr page;
+
+    if (ctx_size > 0xFFFF) {
+        qn_err_stor_set_invalid_upload_result();
+        return qn_false;
+    } // if
+
+    // ---- Each chunk put brings a new context of the same size in practice, so overwrite the old one if it fits.
+    if (ctx_size > blk->ctx_cap) {
+        page = ru->arena;
+        if (! page || page->cap - page->used < ctx_size) {
+            page = malloc(sizeof(qn_stor_ru_arena_page_st) + QN_STOR_RU_ARENA_PAGE_SIZE);
+            if (! page) {
+                qn_err_set_out_of_memory();
+                return qn_false;
+            } // if
+            page->next = ru->arena;
+            page->used = 0;
+            page->cap = QN_STOR_RU_ARENA_PAGE_SIZE;
+            ru->arena = page;
+        } // if
+
+        blk->ctx = page->data + page->used;
+        blk->ctx_cap = ctx_size;
+        page->used += ctx_size;
+    } // if
+
+    memcpy(blk->ctx, ctx, ctx_size);
+    ru->ctx_total += (qn_fsize)ctx_size - blk->ctx_size;
+    blk->ctx_size = ctx_size;
+    return qn_true;
+}
+
+static qn_string qn_stor_ru_intern_host(qn_stor_resumable_upload_ptr restrict ru, const char * restrict host)
+{
+    int i;
+    qn_string * new_hosts;
+
+    for (i = 0; i < ru->host_cnt; i += 1) {
+        if (qn_str_compare_raw(ru->hosts[i], host) == 0) return ru->hosts[i];
+    } // for
+
+    new_hosts = realloc(ru->hosts, sizeof(qn_string) * (ru->host_cnt + 1));
+    if (! new_hosts) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+    ru->hosts = new_hosts;
+
+    if (! (ru->hosts[ru->host_cnt] = qn_cs_duplicate(host))) return NULL;
+    return ru->hosts[ru->host_cnt++];
+}
+
 QN_SDK qn_stor_resumable_upload_ptr qn_stor_ru_create(qn_io_reader_itf restrict data_rdr)
 {
     qn_stor_resumable_upload_ptr ru;
@@ -2416,29 +3430,17 @@ QN_SDK qn_stor_resumable_upload_ptr qn_stor_ru_create(qn_io_reader_itf restrict
         return NULL;
     } // if
 
-    ru->progress = qn_json_obj_create();
-    if (! ru->progress) {
-        free(ru);
-        return NULL;
-    } // if
-
     ru->fsize = qn_io_rdr_size(data_rdr);
     ru->blk_cnt = qn_stor_ru_calculate_block_count(ru->fsize);
 
-    if (! qn_json_obj_set_integer(ru->progress, "bcount", ru->blk_cnt)) {
-        qn_json_obj_destroy(ru->progress);
-        free(ru);
-        return NULL;
-    } // if
-    if (! qn_json_obj_set_new_empty_array(ru->progress, "blocks")) {
-        qn_json_obj_destroy(ru->progress);
+    if (! qn_stor_ru_init_blocks(ru)) {
         free(ru);
         return NULL;
     } // if
 
     ru->src_rdr = qn_io_rdr_duplicate(data_rdr);
     if (! ru->src_rdr) {
-        qn_json_obj_destroy(ru->progress);
+        free(ru->blks);
         free(ru);
         return NULL;
     } // if
@@ -2449,35 +3451,134 @@ QN_SDK qn_stor_resumable_upload_ptr qn_stor_ru_create(qn_io_reader_itf restrict
 
 QN_SDK void qn_stor_ru_destroy(qn_stor_resumable_upload_ptr restrict ru)
 {
+    qn_stor_ru_arena_page_ptr page;
+
     if (ru) {
-        qn_json_obj_destroy(ru->progress);
-        qn_io_rdr_close(ru->src_rdr);
+        qn_stor_ru_close_journal(ru);
+        while ((page = ru->arena)) {
+            ru->arena = page->next;
+            free(page);
+        } // while
+        while (ru->host_cnt > 0) qn_str_destroy(ru->hosts[--ru->host_cnt]);
+        free(ru->hosts);
+        free(ru->blks);
+        if (ru->src_rdr) qn_io_rdr_close(ru->src_rdr);
         free(ru);
     } // if
 }
 
 QN_SDK qn_string qn_stor_ru_to_string(qn_stor_resumable_upload_ptr restrict ru)
 {
+    int i;
     qn_bool ret;
+    qn_string str = NULL;
     qn_string fsize_str;
+    qn_json_object_ptr progress;
+    qn_json_object_ptr blk_obj;
+    qn_json_array_ptr blk_arr;
+    qn_stor_ru_block_ptr blk;
 
-    fsize_str = qn_type_fsize_to_string(ru->fsize);
-    ret = qn_json_obj_set_text(ru->progress, "fsize", qn_str_cstr(fsize_str), qn_str_size(fsize_str));
+    assert(ru);
+
+    if (! (progress = qn_json_obj_create())) return NULL;
+    if (! qn_json_obj_set_integer(progress, "bcount", ru->blk_cnt)) goto QN_STOR_RU_TO_STRING_CLEAN;
+
+    fsize_str = qn_type_fsize_to_string(ru->fsize);
+    ret = qn_json_obj_set_text(progress, "fsize", qn_str_cstr(fsize_str), qn_str_size(fsize_str));
     qn_str_destroy(fsize_str);
-    if (! ret) return NULL;
+    if (! ret) goto QN_STOR_RU_TO_STRING_CLEAN;
 
     fsize_str = qn_type_fsize_to_string(ru->uploaded_fsize);
-    ret = qn_json_obj_set_text(ru->progress, "uploaded_fsize", qn_str_cstr(fsize_str), qn_str_size(fsize_str));
+    ret = qn_json_obj_set_text(progress, "uploaded_fsize", qn_str_cstr(fsize_str), qn_str_size(fsize_str));
     qn_str_destroy(fsize_str);
-    if (! ret) return NULL;
+    if (! ret) goto QN_STOR_RU_TO_STRING_CLEAN;
+
+    if (! (blk_arr = qn_json_obj_set_new_empty_array(progress, "blocks"))) goto QN_STOR_RU_TO_STRING_CLEAN;
+    for (i = 0; i < ru->blk_used; i += 1) {
+        blk = &ru->blks[i];
+        if (! (blk_obj = qn_json_arr_push_new_empty_object(blk_arr))) goto QN_STOR_RU_TO_STRING_CLEAN;
+        if (! qn_json_obj_set_integer(blk_obj, "bsize", blk->bsize)) goto QN_STOR_RU_TO_STRING_CLEAN;
+        if (! blk->ctx) continue;
+
+        if (! qn_json_obj_set_text(blk_obj, "ctx", blk->ctx, blk->ctx_size)) goto QN_STOR_RU_TO_STRING_CLEAN;
+        if (! qn_json_obj_set_cstr(blk_obj, "host", qn_str_cstr(blk->host))) goto QN_STOR_RU_TO_STRING_CLEAN;
+        if (! qn_json_obj_set_integer(blk_obj, "crc32", blk->crc32)) goto QN_STOR_RU_TO_STRING_CLEAN;
+        if (! qn_json_obj_set_integer(blk_obj, "offset", blk->offset)) goto QN_STOR_RU_TO_STRING_CLEAN;
+    } // for
+
+    str = qn_json_object_to_string(progress);
+
+QN_STOR_RU_TO_STRING_CLEAN:
+    qn_json_obj_destroy(progress);
+    return str;
+}
+
+static void qn_stor_ru_release_string(qn_string restrict str)
+{
+#if defined(QN_CFG_SUPPORT_MULTITHREAD)
+    // ---- In multithread builds qn_json_obj_get_string() returns a duplicate owned by the caller.
+    qn_str_destroy(str);
+#else
+    (void) str;
+#endif
+}
+
+static qn_bool qn_stor_ru_load_block(qn_stor_resumable_upload_ptr restrict ru, qn_stor_ru_block_ptr restrict blk, qn_json_object_ptr restrict blk_obj)
+{
+    qn_bool ret;
+    qn_string ctx;
+    qn_string host;
+    qn_json_integer crc32;
+    qn_json_integer offset;
+    qn_json_integer blk_size;
+
+    blk_size = -1;
+    if (! qn_json_obj_get_integer(blk_obj, "bsize", &blk_size)) return qn_false;
+    if (blk_size <= 0 || blk_size > QN_STOR_RU_BLOCK_MAX_SIZE) {
+        qn_err_stor_set_lack_of_block_info();
+        return qn_false;
+    } // if
+    blk->bsize = blk_size;
+
+    // ---- A block which has never been put carries no context.
+    ctx = NULL;
+    if (! qn_json_obj_get_string(blk_obj, "ctx", &ctx)) return qn_err_is_no_such_entry();
+
+    ret = qn_false;
+    host = NULL;
+    if (! qn_json_obj_get_string(blk_obj, "host", &host)) goto QN_STOR_RU_LOAD_BLOCK_CLEAN;
+
+    crc32 = -1;
+    if (! qn_json_obj_get_integer(blk_obj, "crc32", &crc32)) goto QN_STOR_RU_LOAD_BLOCK_CLEAN;
+
+    offset = -1;
+    if (! qn_json_obj_get_integer(blk_obj, "offset", &offset)) goto QN_STOR_RU_LOAD_BLOCK_CLEAN;
+
+    if (! ctx || ! host || crc32 < 0 || offset <= 0 || offset > blk_size) {
+        qn_err_stor_set_lack_of_block_info();
+        goto QN_STOR_RU_LOAD_BLOCK_CLEAN;
+    } // if
 
-    return qn_json_object_to_string(ru->progress);
+    if (! qn_stor_ru_set_block_context(ru, blk, qn_str_cstr(ctx), qn_str_size(ctx))) goto QN_STOR_RU_LOAD_BLOCK_CLEAN;
+    if (! (blk->host = qn_stor_ru_intern_host(ru, qn_str_cstr(host)))) goto QN_STOR_RU_LOAD_BLOCK_CLEAN;
+    blk->crc32 = crc32;
+    blk->offset = offset;
+    ret = qn_true;
+
+QN_STOR_RU_LOAD_BLOCK_CLEAN:
+    qn_stor_ru_release_string(host);
+    qn_stor_ru_release_string(ctx);
+    return ret;
 }
 
 QN_SDK qn_stor_resumable_upload_ptr qn_stor_ru_from_string(const char * restrict str, qn_size str_len)
 {
+    int i;
     qn_json_integer cnt = 0;
     qn_string fsize_str;
+    qn_json_object_ptr progress;
+    qn_json_object_ptr blk_obj;
+    qn_json_array_ptr blk_arr;
     qn_stor_resumable_upload_ptr ru;
 
     assert(str && str_len > 0);
@@ -2488,61 +3589,494 @@ QN_SDK qn_stor_resumable_upload_ptr qn_stor_ru_from_string(const char * restrict
         return NULL;
     } // if
 
-    ru->progress = qn_json_object_from_string(str, str_len);
-    if (! ru->progress) {
+    progress = qn_json_object_from_string(str, str_len);
+    if (! progress) {
         free(ru);
         return NULL;
     } // if
 
     fsize_str = NULL;
-    if (! qn_json_obj_get_string(ru->progress, "fsize", &fsize_str)) {
-        qn_json_obj_destroy(ru->progress);
-        free(ru);
-        return NULL;
-    }
-
+    if (! qn_json_obj_get_string(progress, "fsize", &fsize_str)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
     if (! fsize_str) {
-        qn_json_obj_destroy(ru->progress);
-        free(ru);
         qn_err_stor_set_lack_of_file_size();
-        return NULL;
+        goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
     } // if
     ru->fsize = atoll(qn_str_cstr(fsize_str));
+    qn_stor_ru_release_string(fsize_str);
 
     fsize_str = NULL;
-    if (! qn_json_obj_get_string(ru->progress, "uploaded_fsize", &fsize_str)) {
-        qn_json_obj_destroy(ru->progress);
-        free(ru);
-        return NULL;
-    }
-
+    if (! qn_json_obj_get_string(progress, "uploaded_fsize", &fsize_str)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
     if (! fsize_str) {
-        qn_json_obj_destroy(ru->progress);
-        free(ru);
         qn_err_stor_set_lack_of_file_size();
-        return NULL;
+        goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
     } // if
     ru->uploaded_fsize = atoll(qn_str_cstr(fsize_str));
+    qn_stor_ru_release_string(fsize_str);
 
     cnt = 0;
-    if (! qn_json_obj_get_integer(ru->progress, "bcount", &cnt)) {
-        qn_json_obj_destroy(ru->progress);
-        free(ru);
-        return NULL;
-    }
+    if (! qn_json_obj_get_integer(progress, "bcount", &cnt)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
     ru->blk_cnt = cnt;
+    if (ru->blk_cnt == 0 && ru->fsize > 0) ru->blk_cnt = qn_stor_ru_calculate_block_count(ru->fsize);
 
-    if (ru->blk_cnt == 0 && ru->fsize > 0) {
-        ru->blk_cnt = qn_stor_ru_calculate_block_count(ru->fsize);
-        if (! qn_json_obj_set_integer(ru->progress, "bcount", ru->blk_cnt)) {
-            qn_json_obj_destroy(ru->progress);
-            free(ru);
-            return NULL;
+    // ---- Copy all blocks into the table, then fill up the ones never reached.
+    blk_arr = NULL;
+    if (! qn_json_obj_get_array(progress, "blocks", &blk_arr)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
+    if (ru->blk_cnt > 0 && qn_json_arr_size(blk_arr) > ru->blk_cnt) {
+        qn_err_set_out_of_range();
+        goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
+    } // if
+    if (! qn_stor_ru_reserve_blocks(ru, qn_json_arr_size(blk_arr))) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
+
+    for (i = 0; i < qn_json_arr_size(blk_arr); i += 1) {
+        blk_obj = NULL;
+        if (! qn_json_arr_get_object(blk_arr, i, &blk_obj)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
+        if (! qn_stor_ru_load_block(ru, &ru->blks[i], blk_obj)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
+        ru->blk_used += 1;
+    } // for
+    if (! qn_stor_ru_init_blocks(ru)) goto QN_STOR_RU_FROM_STRING_ERROR_HANDLING;
+
+    qn_json_obj_destroy(progress);
+    ru->rdr_vtbl = &qn_stor_ru_ctx_rdr_vtable;
+    return ru;
+
+QN_STOR_RU_FROM_STRING_ERROR_HANDLING:
+    qn_json_obj_destroy(progress);
+    qn_stor_ru_destroy(ru);
+    return NULL;
+}
+
+// ---- Checkpoint journal of a resumable upload (abbreviation: jnl) ----
+
+enum
+{
+    QN_STOR_RU_JNL_RECORD_SIZE = 256,
+    QN_STOR_RU_JNL_DATA_SIZE = (QN_STOR_RU_JNL_RECORD_SIZE - 32),
+    QN_STOR_RU_JNL_COMPACT_MIN_RECORDS = 1024
+};
+
+typedef enum _QN_STOR_RU_JNL_TYPE
+{
+    QN_STOR_RU_JNL_HEADER = 1,
+    QN_STOR_RU_JNL_HOST = 2,
+    QN_STOR_RU_JNL_BLOCK = 3,
+    QN_STOR_RU_JNL_CONTINUATION = 4
+} qn_stor_ru_jnl_type_em;
+
+static const char qn_stor_ru_jnl_magic[] = "QNRUJNL1";
+
+// ---- All records have the same size, so a record torn by a crash is always the last one and easy to skip.
+// ---- Data longer than one record goes on in continuation records, which repeat all fields but the data.
+typedef struct _QN_STOR_RU_JNL_RECORD
+{
+    qn_uint32 hash;                 // FNV-1a hash of the rest of the record.
+    qn_uint16 type;
+    qn_uint16 size;                 // Size of the data in this record.
+    qn_uint32 idx;                  // Block count in the header, index of the host or the block.
+    qn_uint32 host_idx;
+    qn_uint64 value;                // File size in the header, or offset of the block.
+    qn_uint32 crc32;
+    qn_uint32 total_size;           // Size of the data in all records of the entry, 0 for journals written before continuation records.
+    char data[QN_STOR_RU_JNL_DATA_SIZE];
+} qn_stor_ru_jnl_record_st, *qn_stor_ru_jnl_record_ptr;
+
+// ---- An entry being put together from its records while replaying.
+typedef struct _QN_STOR_RU_JNL_ENTRY
+{
+    qn_stor_ru_jnl_record_st head;  // The first record, whose data is not used.
+    char * data;                    // NUL-terminated.
+    qn_size size;
+    qn_size total_size;
+    qn_size cap;
+} qn_stor_ru_jnl_entry_st, *qn_stor_ru_jnl_entry_ptr;
+
+static qn_uint32 qn_stor_ru_jnl_hash(qn_stor_ru_jnl_record_ptr restrict rec)
+{
+    const unsigned char * pos = (const unsigned char *)rec + sizeof(rec->hash);
+    const unsigned char * end = (const unsigned char *)rec + sizeof(qn_stor_ru_jnl_record_st);
+    qn_uint32 hash = 2166136261U;
+
+    for (; pos < end; pos += 1) hash = (hash ^ *pos) * 16777619U;
+    return hash;
+}
+
+// ---- Write the record with the data, split into continuation records if it doesn't fit in one.
+static qn_bool qn_stor_ru_jnl_write(qn_fl_writer_ptr restrict wrt, qn_stor_ru_jnl_record_ptr restrict rec, const char * restrict data, qn_size data_size)
+{
+    qn_size pos = 0;
+
+    rec->total_size = data_size;
+    do {
+        rec->size = (data_size - pos < QN_STOR_RU_JNL_DATA_SIZE) ? data_size - pos : QN_STOR_RU_JNL_DATA_SIZE;
+        memcpy(rec->data, data + pos, rec->size);
+        memset(rec->data + rec->size, 0, QN_STOR_RU_JNL_DATA_SIZE - rec->size);
+        rec->hash = qn_stor_ru_jnl_hash(rec);
+        if (qn_fl_wrt_write(wrt, (const char *)rec, sizeof(qn_stor_ru_jnl_record_st)) != sizeof(qn_stor_ru_jnl_record_st)) return qn_false;
+
+        pos += rec->size;
+        rec->type = QN_STOR_RU_JNL_CONTINUATION;
+    } while (pos < data_size);
+    return qn_true;
+}
+
+static qn_bool qn_stor_ru_jnl_write_host(qn_fl_writer_ptr restrict wrt, int host_idx, qn_string restrict host)
+{
+    qn_stor_ru_jnl_record_st rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = QN_STOR_RU_JNL_HOST;
+    rec.idx = host_idx;
+    return qn_stor_ru_jnl_write(wrt, &rec, qn_str_cstr(host), qn_str_size(host));
+}
+
+// ---- Write the block, after any host which is not in the journal yet.
+static qn_bool qn_stor_ru_jnl_write_block(qn_stor_resumable_upload_ptr restrict ru, qn_fl_writer_ptr restrict wrt, int blk_idx, int * restrict host_cnt)
+{
+    int host_idx;
+    qn_stor_ru_jnl_record_st rec;
+    qn_stor_ru_block_ptr blk = &ru->blks[blk_idx];
+
+    for (host_idx = 0; host_idx < ru->host_cnt && ru->hosts[host_idx] != blk->host; host_idx += 1) ;
+    for (; *host_cnt <= host_idx; *host_cnt += 1) {
+        if (! qn_stor_ru_jnl_write_host(wrt, *host_cnt, ru->hosts[*host_cnt])) return qn_false;
+    } // for
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = QN_STOR_RU_JNL_BLOCK;
+    rec.idx = blk_idx;
+    rec.host_idx = host_idx;
+    rec.value = blk->offset;
+    rec.crc32 = blk->crc32;
+    return qn_stor_ru_jnl_write(wrt, &rec, blk->ctx, blk->ctx_size);
+}
+
+// ---- Write the whole progress into a new journal, then put it in place of the old one.
+static qn_bool qn_stor_ru_jnl_rewrite(qn_stor_resumable_upload_ptr restrict ru)
+{
+    int i;
+    int host_cnt = 0;
+    qn_bool ret;
+    qn_string tmp_fname;
+    qn_fl_writer_ptr wrt;
+    qn_stor_ru_jnl_record_st rec;
+
+    if (! (tmp_fname = qn_cs_sprintf("%s.tmp", qn_str_cstr(ru->jnl_fname)))) return qn_false;
+
+    remove(qn_str_cstr(tmp_fname));
+    if (! (wrt = qn_fl_wrt_open(qn_str_cstr(tmp_fname), 0, 0, QN_FL_WRT_TRUNCATE))) {
+        qn_str_destroy(tmp_fname);
+        return qn_false;
+    } // if
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = QN_STOR_RU_JNL_HEADER;
+    rec.idx = ru->blk_cnt;
+    rec.value = ru->fsize;
+
+    ret = qn_stor_ru_jnl_write(wrt, &rec, qn_stor_ru_jnl_magic, sizeof(qn_stor_ru_jnl_magic) - 1);
+    for (i = 0; ret && i < ru->blk_used; i += 1) {
+        if (ru->blks[i].ctx) ret = qn_stor_ru_jnl_write_block(ru, wrt, i, &host_cnt);
+    } // for
+    if (ret) ret = qn_fl_wrt_sync(wrt);
+    if (ret && rename(qn_str_cstr(tmp_fname), qn_str_cstr(ru->jnl_fname)) != 0) {
+        qn_err_fl_set_writing_file_failed();
+        ret = qn_false;
+    } // if
+
+    if (! ret) {
+        qn_fl_wrt_close(wrt);
+        remove(qn_str_cstr(tmp_fname));
+        qn_str_destroy(tmp_fname);
+        return qn_false;
+    } // if
+    qn_str_destroy(tmp_fname);
+
+    // ---- Make the rename itself durable. If it fails, a crash may bring the old journal back, which is still valid but behind.
+    qn_fl_sync_directory(qn_str_cstr(ru->jnl_fname));
+
+    qn_fl_wrt_close(ru->jnl);
+    ru->jnl = wrt;
+    ru->jnl_broken = qn_false;
+    ru->jnl_host_cnt = host_cnt;
+    ru->jnl_rec_cnt = 0;
+    ru->jnl_unsynced = 0;
+    ru->jnl_sync_time = qn_tm_monotonic_microseconds();
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Wait until all records appended to the journal are on the disk. If appending
+* has failed since the last call, the journal is rewritten from the progress
+* in memory instead.
+*
+* @param [in] ru The pointer to the resumable upload object.
+* @retval true All records are on the disk, or no journal is open.
+* @retval false Failed in syncing or rewriting, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_stor_ru_sync_journal(qn_stor_resumable_upload_ptr restrict ru)
+{
+    assert(ru);
+
+    if (! ru->jnl) return qn_true;
+    if (ru->jnl_broken) return qn_stor_ru_jnl_rewrite(ru);
+    if (ru->jnl_unsynced == 0) return qn_true;
+    if (! qn_fl_wrt_sync(ru->jnl)) return qn_false;
+
+    ru->jnl_unsynced = 0;
+    ru->jnl_sync_time = qn_tm_monotonic_microseconds();
+    return qn_true;
+}
+
+static qn_bool qn_stor_ru_jnl_append(qn_stor_resumable_upload_ptr restrict ru, int blk_idx)
+{
+    qn_foffset begin;
+
+    // ---- Once superseded records outnumber live ones, rewrite the journal to keep it in proportion to the block count.
+    if (ru->jnl_broken || ru->jnl_rec_cnt >= ru->blk_used * 2 + QN_STOR_RU_JNL_COMPACT_MIN_RECORDS) return qn_stor_ru_jnl_rewrite(ru);
+
+    begin = qn_fl_wrt_offset(ru->jnl);
+    if (! qn_stor_ru_jnl_write_block(ru, ru->jnl, blk_idx, &ru->jnl_host_cnt)) {
+        // ---- A torn entry may be left at the end, after which nothing could be replayed.
+        ru->jnl_broken = qn_true;
+        return qn_false;
+    } // if
+    ru->jnl_rec_cnt += 1;
+    ru->jnl_unsynced += qn_fl_wrt_offset(ru->jnl) - begin;
+
+    if (ru->jnl_unsynced < ru->jnl_sync_bytes && qn_tm_monotonic_microseconds() - ru->jnl_sync_time < (qn_uint64)ru->jnl_sync_ms * 1000) return qn_true;
+    return qn_stor_ru_sync_journal(ru);
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Start keeping the progress in a journal file. The current progress is
+* written into the file first, replacing any old content, then each chunk put
+* appends a fixed-size record to it, followed by continuation records if the
+* context or the host is too long for one. Records are synced to the disk in
+* batches, once either the time or the byte budget since the last sync is used
+* up. The journal is rewritten from time to time to drop superseded records.
+*
+* @param [in] ru The pointer to the resumable upload object.
+* @param [in] fname The name of the journal file.
+* @param [in] sync_ms The longest time in milliseconds for which appended
+*                     records may stay unsynced. It is checked when a record
+*                     is appended.
+* @param [in] sync_bytes The most bytes of records which may stay unsynced.
+*                        Passing 0 for either budget syncs every record.
+* @retval true The journal is open.
+* @retval false Failed in writing the journal, and an error code is set. The
+*               journal opened before, if any, is kept.
+*
+* @remark Read the progress back by qn_stor_ru_from_journal() after a crash.
+*         Remove the journal file after the upload is done.
+* @remark A chunk which is put never fails because of the journal. If
+*         appending fails, the journal is rewritten at the next chunk put, and
+*         qn_stor_ru_sync_journal() or qn_stor_ru_close_journal() reports the
+*         error if it still fails.
+*******************************************************************************/
+QN_SDK qn_bool qn_stor_ru_open_journal(qn_stor_resumable_upload_ptr restrict ru, const char * restrict fname, qn_uint32 sync_ms, qn_uint32 sync_bytes)
+{
+    qn_string old_fname;
+
+    assert(ru);
+    assert(fname);
+
+    old_fname = ru->jnl_fname;
+    if (! (ru->jnl_fname = qn_cs_duplicate(fname))) {
+        ru->jnl_fname = old_fname;
+        return qn_false;
+    } // if
+
+    if (! qn_stor_ru_jnl_rewrite(ru)) {
+        qn_str_destroy(ru->jnl_fname);
+        ru->jnl_fname = old_fname;
+        return qn_false;
+    } // if
+
+    qn_str_destroy(old_fname);
+    ru->jnl_sync_ms = sync_ms;
+    ru->jnl_sync_bytes = sync_bytes;
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Sync and close the journal. The journal file is kept.
+*
+* @param [in] ru The pointer to the resumable upload object.
+* @retval true All records are on the disk, or no journal is open.
+* @retval false Failed in syncing, and an error code is set. The journal is
+*               closed anyway.
+*******************************************************************************/
+QN_SDK qn_bool qn_stor_ru_close_journal(qn_stor_resumable_upload_ptr restrict ru)
+{
+    qn_bool ret;
+
+    assert(ru);
+
+    if (! ru->jnl) return qn_true;
+
+    ret = qn_stor_ru_sync_journal(ru);
+    qn_fl_wrt_close(ru->jnl);
+    ru->jnl = NULL;
+    qn_str_destroy(ru->jnl_fname);
+    ru->jnl_fname = NULL;
+    return ret;
+}
+
+// ---- Read a record. A short or damaged one can only be the torn tail left by a crash, and ends the journal.
+static qn_bool qn_stor_ru_jnl_read(qn_file_ptr restrict fl, qn_stor_ru_jnl_record_ptr restrict rec)
+{
+    ssize_t ret;
+    size_t size = 0;
+
+    while (size < sizeof(qn_stor_ru_jnl_record_st)) {
+        ret = qn_fl_read(fl, (char *)rec + size, sizeof(qn_stor_ru_jnl_record_st) - size);
+        if (ret <= 0) return qn_false;
+        size += ret;
+    } // while
+    return rec->hash == qn_stor_ru_jnl_hash(rec) && rec->size <= QN_STOR_RU_JNL_DATA_SIZE;
+}
+
+static qn_bool qn_stor_ru_jnl_apply(qn_stor_resumable_upload_ptr restrict ru, qn_stor_ru_jnl_record_ptr restrict rec, const char * restrict data, qn_size data_size)
+{
+    qn_stor_ru_block_ptr blk;
+
+    if (rec->type == QN_STOR_RU_JNL_HOST) {
+        if (rec->idx != ru->host_cnt) {
+            qn_err_stor_set_invalid_journal();
+            return qn_false;
+        } // if
+        return qn_stor_ru_intern_host(ru, data) != NULL;
+    } // if
+
+    if (rec->type != QN_STOR_RU_JNL_BLOCK) {
+        qn_err_stor_set_invalid_journal();
+        return qn_false;
+    } // if
+
+    if (ru->blk_cnt == 0) {
+        // -- The size of the source reader is unknown, so blocks are added as they are put.
+        if (! qn_stor_ru_reserve_blocks(ru, rec->idx + 1)) return qn_false;
+        for (; ru->blk_used <= rec->idx; ru->blk_used += 1) ru->blks[ru->blk_used].bsize = QN_STOR_RU_BLOCK_MAX_SIZE;
+    } // if
+
+    if (ru->blk_used <= rec->idx || ru->host_cnt <= rec->host_idx || data_size == 0 || rec->value == 0 || ru->blks[rec->idx].bsize < rec->value) {
+        qn_err_stor_set_invalid_journal();
+        return qn_false;
+    } // if
+
+    blk = &ru->blks[rec->idx];
+    if (! qn_stor_ru_set_block_context(ru, blk, data, data_size)) return qn_false;
+    blk->host = ru->hosts[rec->host_idx];
+    blk->crc32 = rec->crc32;
+
+    ru->uploaded_fsize += (qn_fsize)rec->value - blk->offset;
+    blk->offset = rec->value;
+    return qn_true;
+}
+
+// ---- Put the record into the entry, and apply the entry once all of its records are in.
+static qn_bool qn_stor_ru_jnl_replay(qn_stor_resumable_upload_ptr restrict ru, qn_stor_ru_jnl_entry_ptr restrict ent, qn_stor_ru_jnl_record_ptr restrict rec)
+{
+    qn_size total_size;
+    char * new_data;
+
+    if (rec->type == QN_STOR_RU_JNL_CONTINUATION) {
+        if (ent->size == ent->total_size || rec->idx != ent->head.idx || rec->total_size != ent->total_size || ent->total_size - ent->size < rec->size) {
+            qn_err_stor_set_invalid_journal();
+            return qn_false;
+        } // if
+    } else {
+        total_size = (rec->total_size == 0) ? rec->size : rec->total_size;
+        if (ent->size < ent->total_size || total_size < rec->size) {
+            qn_err_stor_set_invalid_journal();
+            return qn_false;
         } // if
+
+        if (ent->cap <= total_size) {
+            if (! (new_data = realloc(ent->data, total_size + 1))) {
+                qn_err_set_out_of_memory();
+                return qn_false;
+            } // if
+            ent->data = new_data;
+            ent->cap = total_size + 1;
+        } // if
+
+        ent->head = *rec;
+        ent->size = 0;
+        ent->total_size = total_size;
+    } // if
+
+    memcpy(ent->data + ent->size, rec->data, rec->size);
+    ent->size += rec->size;
+    ent->data[ent->size] = '\0';
+
+    if (ent->size < ent->total_size) return qn_true;
+    return qn_stor_ru_jnl_apply(ru, &ent->head, ent->data, ent->size);
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Create a resumable upload object by replaying the journal written through
+* qn_stor_ru_open_journal(). A record torn by a crash at the end of the
+* journal is skipped, as well as the entry it belongs to if it is a
+* continuation record, so the progress goes back to the last complete entry.
+*
+* @param [in] fname The name of the journal file.
+* @retval non-NULL The pointer to a new resumable upload object. Attach the
+*                  source reader by qn_stor_ru_attach(), and open the journal
+*                  again to go on keeping the progress.
+* @retval NULL Failed in reading the journal, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_stor_resumable_upload_ptr qn_stor_ru_from_journal(const char * restrict fname)
+{
+    qn_file_ptr fl;
+    qn_stor_ru_jnl_record_st rec;
+    qn_stor_ru_jnl_entry_st ent;
+    qn_stor_resumable_upload_ptr ru;
+
+    assert(fname);
+
+    if (! (fl = qn_fl_open(fname, NULL))) return NULL;
+
+    if (! qn_stor_ru_jnl_read(fl, &rec) || rec.type != QN_STOR_RU_JNL_HEADER || rec.size != sizeof(qn_stor_ru_jnl_magic) - 1 || memcmp(rec.data, qn_stor_ru_jnl_magic, rec.size) != 0) {
+        qn_fl_close(fl);
+        qn_err_stor_set_invalid_journal();
+        return NULL;
+    } // if
+
+    ru = calloc(1, sizeof(qn_stor_resumable_upload_st));
+    if (! ru) {
+        qn_fl_close(fl);
+        qn_err_set_out_of_memory();
+        return NULL;
     } // if
 
+    ru->fsize = rec.value;
+    ru->blk_cnt = rec.idx;
+    memset(&ent, 0, sizeof(ent));
+    if (! qn_stor_ru_init_blocks(ru)) goto QN_STOR_RU_FROM_JOURNAL_ERROR_HANDLING;
+
+    // ---- An entry missing continuation records at the end is torn as well, and is dropped.
+    while (qn_stor_ru_jnl_read(fl, &rec)) {
+        if (! qn_stor_ru_jnl_replay(ru, &ent, &rec)) goto QN_STOR_RU_FROM_JOURNAL_ERROR_HANDLING;
+    } // while
+
+    free(ent.data);
+    qn_fl_close(fl);
     ru->rdr_vtbl = &qn_stor_ru_ctx_rdr_vtable;
     return ru;
+
+QN_STOR_RU_FROM_JOURNAL_ERROR_HANDLING:
+    free(ent.data);
+    qn_fl_close(fl);
+    qn_stor_ru_destroy(ru);
+    return NULL;
 }
 
 QN_SDK qn_bool qn_stor_ru_attach(qn_stor_resumable_upload_ptr restrict ru, qn_io_reader_itf restrict data_rdr)
@@ -2570,142 +4104,98 @@ QN_SDK int qn_stor_ru_get_block_count(qn_stor_resumable_upload_ptr restrict ru)
     return ru->blk_cnt;
 }
 
-QN_SDK qn_json_object_ptr qn_stor_ru_get_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx)
+QN_SDK qn_stor_ru_block_ptr qn_stor_ru_get_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx)
 {
-    qn_json_array_ptr blk_arr;
-    qn_json_object_ptr blk_info = NULL;
-
     assert(ru);
-    assert(0 <= blk_idx);
 
-    blk_arr = NULL;
-    if (! qn_json_obj_get_array(ru->progress, "blocks", &blk_arr)) return NULL;
-    if (blk_idx > qn_json_arr_size(blk_arr)) {
+    if (blk_idx == QN_STOR_RU_BLOCK_LAST_INDEX) blk_idx = ru->blk_used - 1;
+    if (blk_idx < 0 || ru->blk_used <= blk_idx) {
         qn_err_set_out_of_range();
         return NULL;
     } // if
-    if (blk_idx == QN_STOR_RU_BLOCK_LAST_INDEX) {
-        blk_idx = qn_json_arr_size(blk_arr) - 1;
-    } // if
-    return (qn_json_arr_get_object(blk_arr, blk_idx, &blk_info)) ? blk_info : NULL;
+    return &ru->blks[blk_idx];
 }
 
-QN_SDK qn_json_object_ptr qn_stor_ru_update_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_json_object_ptr restrict up_ret)
+QN_SDK qn_stor_ru_block_ptr qn_stor_ru_update_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_json_object_ptr restrict up_ret)
 {
     qn_string ctx;
-    qn_string checksum;
     qn_string host;
     qn_integer crc32;
-    qn_integer old_offset;
     qn_integer new_offset;
-    qn_integer blk_size;
-    qn_json_array_ptr blk_arr;
-    qn_json_object_ptr blk_info;
-    qn_json_object_ptr new_blk_info;
+    qn_stor_ru_block_ptr blk;
+    qn_stor_ru_block_ptr ret;
 
     assert(ru);
     assert(0 <= blk_idx);
     assert(up_ret);
 
-    if (! (blk_info = qn_stor_ru_get_block_info(ru, blk_idx))) return NULL;
+    if (! (blk = qn_stor_ru_get_block_info(ru, blk_idx))) return NULL;
 
-    old_offset = 0;
-    if (! qn_json_obj_get_integer(blk_info, "offset", 0)) return NULL;
-
-    blk_size = -1;
-    if (! qn_json_obj_get_integer(blk_info, "bsize", &blk_size)) return NULL;
-    
-    // ---- Get and set the returned block information back into the blk_info object.
+    // ---- Get and set the returned block information back into the block table.
     ctx = NULL;
     if (! qn_json_obj_get_string(up_ret, "ctx", &ctx)) return NULL;
 
-    checksum = NULL;
-    if (! qn_json_obj_get_string(up_ret, "checksum", &checksum)) return NULL;
-
+    ret = NULL;
     host = NULL;
-    if (! qn_json_obj_get_string(up_ret, "host", &host)) return NULL;
+    if (! qn_json_obj_get_string(up_ret, "host", &host)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN;
 
     crc32 = -1;
-    if (! qn_json_obj_get_integer(up_ret, "crc32", &crc32)) return NULL;
+    if (! qn_json_obj_get_integer(up_ret, "crc32", &crc32)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN;
 
     new_offset = -1;
-    if (! qn_json_obj_get_integer(up_ret, "offset", &new_offset)) return NULL;
+    if (! qn_json_obj_get_integer(up_ret, "offset", &new_offset)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN;
 
-    if (! ctx || ! checksum || ! host || crc32 < 0 || new_offset < 0) {
+    if (! ctx || ! host || crc32 < 0 || new_offset < 0 || new_offset > blk->bsize) {
         qn_err_stor_set_invalid_upload_result();
-        return NULL;
+        goto QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN;
     } // if
 
-    new_blk_info = qn_json_obj_create();
-    if (! new_blk_info) return NULL;
+    if (! qn_stor_ru_set_block_context(ru, blk, qn_str_cstr(ctx), qn_str_size(ctx))) goto QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN;
+    if (! (blk->host = qn_stor_ru_intern_host(ru, qn_str_cstr(host)))) goto QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN;
+    blk->crc32 = crc32;
 
-    if (! qn_json_obj_set_cstr(new_blk_info, "ctx", ctx)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
-    if (! qn_json_obj_set_cstr(new_blk_info, "checksum", checksum)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
-    if (! qn_json_obj_set_cstr(new_blk_info, "host", host)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
-    if (! qn_json_obj_set_integer(new_blk_info, "crc32", crc32)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
-    if (! qn_json_obj_set_integer(new_blk_info, "offset", new_offset)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
-    if (! qn_json_obj_set_integer(new_blk_info, "bsize", blk_size)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
+    ru->uploaded_fsize += new_offset - blk->offset;
+    blk->offset = new_offset;
 
-    blk_arr = NULL;
-    if (! qn_json_obj_get_array(ru->progress, "blocks", &blk_arr)) return NULL;
-    if (! qn_json_arr_replace_object(blk_arr, blk_idx, new_blk_info)) goto QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING;
-    ru->uploaded_fsize += new_offset - old_offset;
-    return new_blk_info;
+    // ---- The chunk is put anyway, so a failed append is left to qn_stor_ru_sync_journal() to report.
+    if (ru->jnl) qn_stor_ru_jnl_append(ru, blk_idx);
+    ret = blk;
 
-QN_STOR_RU_UPDATE_BLOCK_INFO_ERROR_HANDLING:
-    qn_json_obj_destroy(new_blk_info);
-    return NULL;
+QN_STOR_RU_UPDATE_BLOCK_INFO_CLEAN:
+    qn_stor_ru_release_string(host);
+    qn_stor_ru_release_string(ctx);
+    return ret;
 }
 
-QN_SDK qn_io_reader_itf qn_stor_ru_create_block_reader(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_json_object_ptr * restrict blk_info)
+QN_SDK qn_io_reader_itf qn_stor_ru_create_block_reader(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_stor_ru_block_ptr * restrict blk_info)
 {
-    int i;
-    int blk_size = QN_STOR_RU_BLOCK_MAX_SIZE;
-    qn_json_object_ptr new_blk_info;
-    qn_json_array_ptr blk_arr;
-
     assert(ru);
     assert(0 <= blk_idx);
 
-    blk_arr = NULL;
-    if (! qn_json_obj_get_array(ru->progress, "blocks", &blk_arr)) return NULL;
     if (ru->blk_cnt == 0) {
         // -- The source reader is a file with unknown size.
         // -- Return the very next block's reader.
-        if (! (new_blk_info = qn_json_arr_push_new_empty_object(blk_arr))) return NULL;
-        if (! qn_json_obj_set_integer(new_blk_info, "bsize", blk_size)) return NULL;
-        *blk_info = new_blk_info;
-        return qn_io_rdr_section(ru->src_rdr, 0, blk_size);
+        if (! qn_stor_ru_reserve_blocks(ru, ru->blk_used + 1)) return NULL;
+        *blk_info = &ru->blks[ru->blk_used++];
+        (*blk_info)->bsize = QN_STOR_RU_BLOCK_MAX_SIZE;
+        return qn_io_rdr_section(ru->src_rdr, 0, QN_STOR_RU_BLOCK_MAX_SIZE);
     } // if
 
     if (ru->blk_cnt <= blk_idx) {
         qn_err_set_out_of_range();
         return NULL;
     } // if
-    
-    if (qn_json_arr_size(blk_arr) <= blk_idx) {
-        for (i = qn_json_arr_size(blk_arr); i < blk_idx; i += 1) {
-            if (! (new_blk_info = qn_json_arr_push_new_empty_object(blk_arr))) return NULL;
-            if (! qn_json_obj_set_integer(new_blk_info, "bsize", blk_size)) return NULL;
-        } // for
-        if (i == ru->blk_cnt - 1) {
-            blk_size = (int)(ru->fsize & (QN_STOR_RU_BLOCK_MAX_SIZE - 1));
-            if (blk_size == 0) blk_size = QN_STOR_RU_BLOCK_MAX_SIZE;
-        } // if
-        if (! (new_blk_info = qn_json_arr_push_new_empty_object(blk_arr))) return NULL;
-        if (! qn_json_obj_set_integer(new_blk_info, "bsize", blk_size)) return NULL;
-    } // if
 
     // -- The source reader is a file.
-    *blk_info = new_blk_info;
-    return qn_io_rdr_section(ru->src_rdr, blk_idx * QN_STOR_RU_BLOCK_MAX_SIZE, blk_size);
+    *blk_info = &ru->blks[blk_idx];
+    return qn_io_rdr_section(ru->src_rdr, (qn_foffset)blk_idx * QN_STOR_RU_BLOCK_MAX_SIZE, (*blk_info)->bsize);
 }
 
 QN_SDK qn_io_reader_itf qn_stor_ru_to_context_reader(qn_stor_resumable_upload_ptr restrict ru)
 {
     ru->ctx_idx = 0;
     ru->ctx_pos = 0;
-    ru->need_comma = 0;
+    ru->need_comma = qn_false;
     return &ru->rdr_vtbl;
 }
 
@@ -2719,33 +4209,102 @@ QN_SDK qn_fsize qn_stor_ru_uploaded_fsize(qn_stor_resumable_upload_ptr restrict
     return ru->uploaded_fsize;
 }
 
-QN_SDK qn_bool qn_stor_ru_is_block_uploaded(qn_json_object_ptr restrict blk_info)
+QN_SDK qn_bool qn_stor_ru_is_block_uploaded(qn_stor_ru_block_ptr restrict blk_info)
 {
-    qn_json_integer lhs = -1;
-    qn_json_integer rhs = 0;
     // | offset | bsize | status    |
-    // | -1     | > 0   | uploading |
-    // | 0      | 0     | N/A       |
-    if (! qn_json_obj_get_integer(blk_info, "offset", &lhs)) return qn_false;
-    if (! qn_json_obj_get_integer(blk_info, "bsize", &rhs)) return qn_false;
-    return (lhs == rhs);
+    // | 0      | > 0   | not put   |
+    // | > 0    | > 0   | uploading |
+    return (blk_info->offset == blk_info->bsize);
 }
 
-QN_SDK qn_bool qn_stor_ru_is_file_uploaded(qn_stor_resumable_upload_ptr restrict ru)
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Get the number of bytes of the block which have been put.
+*
+* @param [in] blk_info The block info returned by qn_stor_ru_get_block_info().
+* @retval The offset of the next chunk in the block.
+*******************************************************************************/
+QN_SDK int qn_stor_ru_get_block_offset(qn_stor_ru_block_ptr restrict blk_info)
 {
-    return ru->uploaded_fsize == ru->fsize;
+    return blk_info->offset;
 }
 
-static inline qn_bool qn_stor_prepare_error_info(qn_storage_ptr restrict stor)
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Get the size of the block, which is less than QN_STOR_RU_BLOCK_MAX_SIZE only
+* for the last block.
+*
+* @param [in] blk_info The block info returned by qn_stor_ru_get_block_info().
+* @retval The size of the block in bytes.
+*******************************************************************************/
+QN_SDK int qn_stor_ru_get_block_size(qn_stor_ru_block_ptr restrict blk_info)
 {
-    if (! (qn_json_obj_set_integer(stor->obj_body, "fn-code", 0))) return qn_false;
-    if (! (qn_json_obj_set_cstr(stor->obj_body, "fn-error", "OK"))) return qn_false;
+    return blk_info->bsize;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Get the context returned by the server for the last chunk put into the block.
+*
+* @param [in] blk_info The block info returned by qn_stor_ru_get_block_info().
+* @param [out] ctx_size The size of the context in bytes.
+* @retval non-NULL The context, which is NOT terminated by NUL, and is owned by
+*                  the block until the next chunk is put.
+* @retval NULL The block has never been put, and ctx_size is set to 0.
+*******************************************************************************/
+QN_SDK const char * qn_stor_ru_get_block_context(qn_stor_ru_block_ptr restrict blk_info, qn_size * restrict ctx_size)
+{
+    *ctx_size = (blk_info->ctx) ? blk_info->ctx_size : 0;
+    return blk_info->ctx;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Get the host to which the last chunk of the block was put, where the next
+* chunk must go as well.
+*
+* @param [in] blk_info The block info returned by qn_stor_ru_get_block_info().
+* @retval non-NULL The host, owned by the resumable upload object.
+* @retval NULL The block has never been put.
+*******************************************************************************/
+QN_SDK const char * qn_stor_ru_get_block_host(qn_stor_ru_block_ptr restrict blk_info)
+{
+    return (blk_info->host) ? qn_str_cstr(blk_info->host) : NULL;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Get the CRC32 checksum of the last chunk put into the block, as returned by
+* the server.
+*
+* @param [in] blk_info The block info returned by qn_stor_ru_get_block_info().
+* @retval The checksum, or 0 if the block has never been put.
+*******************************************************************************/
+QN_SDK qn_uint32 qn_stor_ru_get_block_crc32(qn_stor_ru_block_ptr restrict blk_info)
+{
+    return blk_info->crc32;
+}
+
+QN_SDK qn_bool qn_stor_ru_is_file_uploaded(qn_stor_resumable_upload_ptr restrict ru)
+{
+    return ru->uploaded_fsize == ru->fsize;
+}
+
+static inline qn_bool qn_stor_prepare_error_info(qn_storage_ptr restrict stor)
+{
+    if (! (qn_json_obj_set_integer(stor->obj_body, "fn-code", 0))) return qn_false;
+    if (! (qn_json_obj_set_cstr(stor->obj_body, "fn-error", "OK"))) return qn_false;
     return qn_true;
 }
 
 static inline qn_json_object_ptr qn_stor_rename_error_info(qn_storage_ptr restrict stor)
 {
-    qn_json_obj_set_integer(stor->obj_body, "fn-code", qn_http_resp_get_code(stor->resp));
+    qn_stor_set_response_info(stor);
     if (! qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
     return stor->obj_body;
 }
@@ -2795,11 +4354,8 @@ static qn_bool qn_stor_ru_prepare_for_resumable_upload(qn_storage_ptr restrict s
 
 // -------- Resumable Upload Functions (abbreviation: ru) --------
 
-QN_SDK qn_json_object_ptr qn_stor_ru_api_mkblk(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_json_object_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
+static qn_string qn_stor_ru_prepare_mkblk(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
 {
-    qn_bool ret;
-    qn_integer blk_size;
-    qn_string url;
     qn_rgn_entry_ptr rgn_entry;
 
     // ---- Check preconditions.
@@ -2808,15 +4364,13 @@ QN_SDK qn_json_object_ptr qn_stor_ru_api_mkblk(qn_storage_ptr restrict stor, con
     assert(blk_info);
     assert(data_rdr);
 
-    blk_size = -1;
-    if (! qn_json_obj_get_integer(blk_info, "bsize", &blk_size)) return NULL;
-    if (blk_size < 0) {
+    if (blk_info->bsize <= 0) {
         qn_err_stor_set_lack_of_block_info();
         return NULL;
     } // if
 
     if (chk_size == 0) chk_size = QN_STOR_RU_CHUNK_DEFAULT_SIZE;
-    if (blk_size < chk_size) chk_size = blk_size;
+    if (blk_info->bsize < chk_size) chk_size = blk_info->bsize;
 
     // ---- Process all extra options.
     if (upe) {
@@ -2829,23 +4383,26 @@ QN_SDK qn_json_object_ptr qn_stor_ru_api_mkblk(qn_storage_ptr restrict stor, con
     if (! qn_stor_ru_prepare_for_resumable_upload(stor, uptoken, "application/octet-stream", data_rdr, chk_size, rgn_entry)) return NULL;
 
     // ---- Prepare upload URL.
-    url = qn_cs_sprintf("%s/mkblk/%d", qn_str_cstr(rgn_entry->base_url), blk_size);
+    return qn_cs_sprintf("%s/mkblk/%d", qn_str_cstr(rgn_entry->base_url), blk_info->bsize);
+}
+
+QN_SDK qn_json_object_ptr qn_stor_ru_api_mkblk(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_bool ret;
+    qn_string url;
+
+    if (! (url = qn_stor_ru_prepare_mkblk(stor, uptoken, data_rdr, blk_info, chk_size, upe))) return NULL;
 
     // ---- Do the mkblk action.
+    qn_http_conn_set_tuning_profile(stor->conn, QN_HTTP_TUNING_BULK);
     ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
     qn_str_destroy(url);
     if (! ret) return NULL;
     return qn_stor_rename_error_info(stor);
 }
 
-QN_SDK qn_json_object_ptr qn_stor_ru_api_bput(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_json_object_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
+static qn_string qn_stor_ru_prepare_bput(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
 {
-    qn_bool ret;
-    qn_string url;
-    qn_string host;
-    qn_string ctx;
-    qn_integer offset;
-    qn_integer blk_size;
     qn_rgn_entry_ptr rgn_entry;
 
     // ---- Check preconditions.
@@ -2854,36 +4411,13 @@ QN_SDK qn_json_object_ptr qn_stor_ru_api_bput(qn_storage_ptr restrict stor, cons
     assert(blk_info);
     assert(data_rdr);
 
-    blk_size = -1;
-    if (! qn_json_obj_get_integer(blk_info, "bsize", &blk_size)) return NULL;
-    if (blk_size <= 0) {
-        qn_err_stor_set_lack_of_block_info();
-        return NULL;
-    } // if
-
-    offset = -1;
-    if (! qn_json_obj_get_integer(blk_info, "offset", &offset)) return NULL;
-    if (offset <= 0) {
-        qn_err_stor_set_lack_of_block_info();
-        return NULL;
-    } // if
-
-    host = NULL;
-    if (! qn_json_obj_get_string(blk_info, "host", &host)) return NULL;
-    if (! host) {
-        qn_err_stor_set_lack_of_block_info();
-        return NULL;
-    } // if
-
-    ctx = NULL;
-    if (! qn_json_obj_get_string(blk_info, "ctx", &ctx)) return NULL;
-    if (! ctx) {
+    if (blk_info->bsize <= 0 || blk_info->offset <= 0 || ! blk_info->host || ! blk_info->ctx) {
         qn_err_stor_set_lack_of_block_info();
         return NULL;
     } // if
 
     if (chk_size == 0) chk_size = QN_STOR_RU_CHUNK_DEFAULT_SIZE;
-    if ((blk_size - offset) < chk_size) chk_size = (blk_size - offset);
+    if ((blk_info->bsize - blk_info->offset) < chk_size) chk_size = (blk_info->bsize - blk_info->offset);
 
     // ---- Process all extra options.
     if (upe) {
@@ -2896,18 +4430,26 @@ QN_SDK qn_json_object_ptr qn_stor_ru_api_bput(qn_storage_ptr restrict stor, cons
     if (! qn_stor_ru_prepare_for_resumable_upload(stor, uptoken, "application/octet-stream", data_rdr, chk_size, rgn_entry)) return NULL;
 
     // ---- Prepare upload URL.
-    url = qn_cs_sprintf("%s/bput/%s/%d", qn_str_cstr(host), qn_str_cstr(ctx), offset);
+    return qn_cs_sprintf("%s/bput/%.*s/%d", qn_str_cstr(blk_info->host), (int)blk_info->ctx_size, blk_info->ctx, blk_info->offset);
+}
+
+QN_SDK qn_json_object_ptr qn_stor_ru_api_bput(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_bool ret;
+    qn_string url;
+
+    if (! (url = qn_stor_ru_prepare_bput(stor, uptoken, data_rdr, blk_info, chk_size, upe))) return NULL;
 
     // ---- Do the bput action.
+    qn_http_conn_set_tuning_profile(stor->conn, QN_HTTP_TUNING_BULK);
     ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
     qn_str_destroy(url);
     if (! ret) return NULL;
     return qn_stor_rename_error_info(stor);
 }
 
-QN_SDK qn_json_object_ptr qn_stor_ru_api_mkfile(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict ctx_rdr, qn_json_object_ptr restrict last_blk_info, qn_fsize fsize, qn_stor_upload_extra_ptr restrict upe)
+static qn_string qn_stor_ru_prepare_mkfile(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict ctx_rdr, qn_stor_ru_block_ptr restrict last_blk_info, qn_fsize fsize, qn_stor_upload_extra_ptr restrict upe)
 {
-    qn_bool ret;
     qn_string url;
     qn_string url_tmp;
     qn_string host;
@@ -2927,9 +4469,7 @@ QN_SDK qn_json_object_ptr qn_stor_ru_api_mkfile(qn_storage_ptr restrict stor, co
     assert(ctx_rdr);
     assert(last_blk_info);
 
-    host = NULL;
-    if (! qn_json_obj_get_string(last_blk_info, "host", &host)) return NULL;
-    if (! host) {
+    if (! (host = last_blk_info->host)) {
         qn_err_stor_set_lack_of_block_info();
         return NULL;
     } // if
@@ -3005,21 +4545,205 @@ QN_SDK qn_json_object_ptr qn_stor_ru_api_mkfile(qn_storage_ptr restrict stor, co
         } // if
     } // if
 
+    return url;
+}
+
+QN_SDK qn_json_object_ptr qn_stor_ru_api_mkfile(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict ctx_rdr, qn_stor_ru_block_ptr restrict last_blk_info, qn_fsize fsize, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_bool ret;
+    qn_string url;
+
+    if (! (url = qn_stor_ru_prepare_mkfile(stor, uptoken, ctx_rdr, last_blk_info, fsize, upe))) return NULL;
+
     // ---- Do the mkfile action.
-    ret = qn_http_conn_post(stor->conn, url, stor->req, stor->resp);
+    ret = qn_stor_send(stor, 0, url, qn_true);
     qn_str_destroy(url);
     if (! ret) return NULL;
     return qn_stor_rename_error_info(stor);
 }
 
+// ---- Chunk buffer keeps a chunk in memory so that it can be sent again when retrying.
+
+typedef struct _QN_STOR_CHUNK_BUFFER
+{
+    qn_io_reader_ptr rdr_vtbl;
+    char * buf;
+    size_t cap;
+    size_t size;
+    size_t pos;
+} qn_stor_chunk_buffer_st, *qn_stor_chunk_buffer_ptr;
+
+static inline qn_stor_chunk_buffer_ptr qn_stor_cbuf_from_io_reader(qn_io_reader_itf restrict itf)
+{
+    return (qn_stor_chunk_buffer_ptr)( ( (char *)itf ) - (char *)( &((qn_stor_chunk_buffer_ptr)0)->rdr_vtbl ) );
+}
+
+static void qn_stor_cbuf_rdr_close_vfn(qn_io_reader_itf restrict itf)
+{
+    // Owned by the caller of qn_stor_ru_upload_huge(), nothing to do here.
+}
+
+static ssize_t qn_stor_cbuf_rdr_peek_vfn(qn_io_reader_itf restrict itf, char * restrict buf, size_t buf_size)
+{
+    qn_stor_chunk_buffer_ptr cbuf = qn_stor_cbuf_from_io_reader(itf);
+    size_t rem = cbuf->size - cbuf->pos;
+
+    if (rem < buf_size) buf_size = rem;
+    memcpy(buf, cbuf->buf + cbuf->pos, buf_size);
+    return buf_size;
+}
+
+static ssize_t qn_stor_cbuf_rdr_read_vfn(qn_io_reader_itf restrict itf, char * restrict buf, size_t buf_size)
+{
+    ssize_t ret = qn_stor_cbuf_rdr_peek_vfn(itf, buf, buf_size);
+    qn_stor_cbuf_from_io_reader(itf)->pos += ret;
+    return ret;
+}
+
+static qn_bool qn_stor_cbuf_rdr_seek_vfn(qn_io_reader_itf restrict itf, qn_foffset offset)
+{
+    qn_stor_chunk_buffer_ptr cbuf = qn_stor_cbuf_from_io_reader(itf);
+
+    if (offset < 0 || cbuf->size < offset) {
+        qn_err_set_out_of_range();
+        return qn_false;
+    } // if
+    cbuf->pos = offset;
+    return qn_true;
+}
+
+static qn_bool qn_stor_cbuf_rdr_advance_vfn(qn_io_reader_itf restrict itf, qn_foffset delta)
+{
+    return qn_stor_cbuf_rdr_seek_vfn(itf, qn_stor_cbuf_from_io_reader(itf)->pos + delta);
+}
+
+static qn_io_reader_itf qn_stor_cbuf_rdr_duplicate_vfn(qn_io_reader_itf restrict itf)
+{
+    qn_err_set_invalid_argument();
+    return NULL;
+}
+
+static qn_io_reader_itf qn_stor_cbuf_rdr_section_vfn(qn_io_reader_itf restrict itf, qn_foffset offset, size_t sec_size)
+{
+    qn_err_set_invalid_argument();
+    return NULL;
+}
+
+static qn_string qn_stor_cbuf_rdr_name_vfn(qn_io_reader_itf restrict itf)
+{
+    return NULL;
+}
+
+static qn_fsize qn_stor_cbuf_rdr_size_vfn(qn_io_reader_itf restrict itf)
+{
+    return qn_stor_cbuf_from_io_reader(itf)->size;
+}
+
+static qn_io_reader_st qn_stor_cbuf_rdr_vtable = {
+    &qn_stor_cbuf_rdr_close_vfn,
+    &qn_stor_cbuf_rdr_peek_vfn,
+    &qn_stor_cbuf_rdr_read_vfn,
+    &qn_stor_cbuf_rdr_seek_vfn,
+    &qn_stor_cbuf_rdr_advance_vfn,
+    &qn_stor_cbuf_rdr_duplicate_vfn,
+    &qn_stor_cbuf_rdr_section_vfn,
+    &qn_stor_cbuf_rdr_name_vfn,
+    &qn_stor_cbuf_rdr_size_vfn,
+    NULL // PREFETCH
+};
+
+static qn_bool qn_stor_cbuf_fill(qn_stor_chunk_buffer_ptr restrict cbuf, qn_io_reader_itf restrict src_rdr)
+{
+    ssize_t ret;
+
+    cbuf->size = 0;
+    cbuf->pos = 0;
+    while (cbuf->size < cbuf->cap) {
+        ret = qn_io_rdr_read(src_rdr, cbuf->buf + cbuf->size, cbuf->cap - cbuf->size);
+        if (ret < 0) return qn_false;
+        if (ret == 0) break;
+        cbuf->size += ret;
+    } // while
+    return qn_true;
+}
+
+// ---- Put a chunk through the /mkblk or /bput API, and retry according to the retry policy if the chunk is buffered.
+static qn_json_object_ptr qn_stor_ru_put_chunk(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_section_reader_ptr restrict chk_rdr, qn_stor_chunk_buffer_ptr restrict cbuf, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_bool mkblk, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_json_object_ptr up_ret;
+    qn_io_reader_itf data_rdr;
+    qn_uint64 begin;
+    qn_uint size;
+    int attempt = 0;
+
+    // ---- The last chunk of a block may be short.
+    size = (chk_size == 0) ? QN_STOR_RU_CHUNK_DEFAULT_SIZE : chk_size;
+    if (blk_info->bsize - blk_info->offset < size) size = blk_info->bsize - blk_info->offset;
+
+    if (! cbuf) {
+        data_rdr = qn_io_srdr_to_io_reader(chk_rdr);
+        begin = qn_tm_monotonic_microseconds();
+        up_ret = (mkblk) ? qn_stor_ru_api_mkblk(stor, uptoken, data_rdr, blk_info, chk_size, upe) : qn_stor_ru_api_bput(stor, uptoken, data_rdr, blk_info, chk_size, upe);
+        qn_stor_chp_sample(stor->chp, size, begin, up_ret);
+        return up_ret;
+    } // if
+
+    if (! qn_stor_cbuf_fill(cbuf, qn_io_srdr_to_io_reader(chk_rdr))) return NULL;
+    data_rdr = (qn_io_reader_itf) &cbuf->rdr_vtbl;
+
+    while (1) {
+        attempt += 1;
+        cbuf->pos = 0;
+        begin = qn_tm_monotonic_microseconds();
+        up_ret = (mkblk) ? qn_stor_ru_api_mkblk(stor, uptoken, data_rdr, blk_info, chk_size, upe) : qn_stor_ru_api_bput(stor, uptoken, data_rdr, blk_info, chk_size, upe);
+        qn_stor_chp_sample(stor->chp, size, begin, up_ret);
+
+        // ---- The chunk is not committed unless a context is returned, so it is always safe to put it again.
+        if (attempt >= stor->rtp->max_attempts) return up_ret;
+        if (up_ret) {
+            if (! qn_stor_rtp_is_transient_code(up_ret)) return up_ret;
+        } else if (! qn_stor_rtp_is_transient_error()) {
+            return up_ret;
+        } // if
+
+        qn_stor_rtp_wait(stor, attempt);
+    } // while
+    return up_ret;
+}
+
+// ---- Ask the source reader to load the chunk after the one about to be put, so that reading it from disk overlaps with sending the current one.
+static void qn_stor_ru_prefetch_next_chunk(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size)
+{
+    qn_uint chk_bytes;
+    qn_foffset offset;
+
+    // ---- Offsets in a source of unknown size point to nothing.
+    if (ru->blk_cnt == 0) return;
+
+    if (chk_size == 0) chk_size = QN_STOR_RU_CHUNK_DEFAULT_SIZE;
+    chk_bytes = (blk_info->bsize - blk_info->offset < chk_size) ? blk_info->bsize - blk_info->offset : chk_size;
+    offset = (qn_foffset)blk_idx * QN_STOR_RU_BLOCK_MAX_SIZE + blk_info->offset + chk_bytes;
+    if (ru->fsize <= offset) return;
+    qn_io_rdr_prefetch(ru->src_rdr, offset, chk_size);
+}
+
+// ---- Take the size of the next chunk from the chunk policy if there is one, within the chunk buffer.
+static inline qn_uint qn_stor_ru_next_chunk_size(qn_storage_ptr restrict stor, qn_stor_chunk_buffer_ptr restrict cbuf, qn_uint chk_size)
+{
+    if (! stor->chp) return chk_size;
+    chk_size = qn_stor_chp_get_chunk_size(stor->chp);
+    return (cbuf && cbuf->cap < chk_size) ? cbuf->cap : chk_size;
+}
+
 QN_SDK qn_json_object_ptr qn_stor_ru_upload_huge(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_stor_resumable_upload_ptr ru, int * start_idx, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
 {
     int i;
-    qn_integer offset;
-    qn_json_object_ptr up_ret;
-    qn_json_object_ptr blk_info;
+    qn_json_object_ptr up_ret = NULL;
+    qn_stor_ru_block_ptr blk_info;
     qn_io_reader_itf sec_rdr;
     qn_io_section_reader_ptr chk_rdr;
+    qn_stor_chunk_buffer_st chk_buf;
+    qn_stor_chunk_buffer_ptr cbuf = NULL;
     qn_json_integer code = 0;
 
     // ---- Check preconditions.
@@ -3033,22 +4757,36 @@ QN_SDK qn_json_object_ptr qn_stor_ru_upload_huge(qn_storage_ptr restrict stor, c
     chk_rdr = qn_io_srdr_create(NULL, 0);
     if (! chk_rdr) return NULL;
 
+    if (stor->rtp && stor->rtp->max_attempts > 1) {
+        // ---- Buffer each chunk so that it can be put again after a transient failure.
+        if (chk_size == 0) chk_size = QN_STOR_RU_CHUNK_DEFAULT_SIZE;
+        chk_buf.rdr_vtbl = &qn_stor_cbuf_rdr_vtable;
+        chk_buf.cap = (stor->chp) ? qn_stor_chp_get_max_size(stor->chp) : chk_size;
+        if (! (chk_buf.buf = malloc(chk_buf.cap))) {
+            qn_io_srdr_destroy(chk_rdr);
+            qn_err_set_out_of_memory();
+            return NULL;
+        } // if
+        cbuf = &chk_buf;
+    } // if
+
     // ---- Start from the given index.
     for (i = *start_idx; i < qn_stor_ru_get_block_count(ru); i += 1) {
         blk_info = qn_stor_ru_get_block_info(ru, i);
         if (blk_info && qn_stor_ru_is_block_uploaded(blk_info)) continue;
 
         if (! (sec_rdr = qn_stor_ru_create_block_reader(ru, i, &blk_info))) {
+            if (cbuf) free(cbuf->buf);
             qn_io_srdr_destroy(chk_rdr);
             *start_idx = i;
             return NULL;
         } // if
 
-        offset = 0;
-        if (! qn_json_obj_get_integer(blk_info, "offset", &offset)) goto QN_STOR_UPLOAD_HUGE_ERROR_HANDLING;
-        if (offset == 0) {
+        if (blk_info->offset == 0) {
+            chk_size = qn_stor_ru_next_chunk_size(stor, cbuf, chk_size);
             qn_io_srdr_reset(chk_rdr, sec_rdr, chk_size);
-            up_ret = qn_stor_ru_api_mkblk(stor, uptoken, qn_io_srdr_to_io_reader(chk_rdr), blk_info, chk_size, upe);
+            qn_stor_ru_prefetch_next_chunk(ru, i, blk_info, chk_size);
+            up_ret = qn_stor_ru_put_chunk(stor, uptoken, chk_rdr, cbuf, blk_info, chk_size, qn_true, upe);
             if (! up_ret) goto QN_STOR_UPLOAD_HUGE_ERROR_HANDLING;
 
             code = -1;
@@ -3058,14 +4796,16 @@ QN_SDK qn_json_object_ptr qn_stor_ru_upload_huge(qn_storage_ptr restrict stor, c
                 up_ret = NULL;
                 goto QN_STOR_UPLOAD_HUGE_ERROR_HANDLING;
             } // if
-        } else if (! qn_io_rdr_advance(sec_rdr, offset)) {
+        } else if (! qn_io_rdr_advance(sec_rdr, blk_info->offset)) {
             goto QN_STOR_UPLOAD_HUGE_ERROR_HANDLING;
         } // if
 
         // ---- If the whole block is uploaded through the /mkblk API, skip all subsequent calls to the /bput API.
         while (! qn_stor_ru_is_block_uploaded(blk_info)) {
+            chk_size = qn_stor_ru_next_chunk_size(stor, cbuf, chk_size);
             qn_io_srdr_reset(chk_rdr, sec_rdr, chk_size);
-            up_ret = qn_stor_ru_api_bput(stor, uptoken, qn_io_srdr_to_io_reader(chk_rdr), blk_info, chk_size, upe);
+            qn_stor_ru_prefetch_next_chunk(ru, i, blk_info, chk_size);
+            up_ret = qn_stor_ru_put_chunk(stor, uptoken, chk_rdr, cbuf, blk_info, chk_size, qn_false, upe);
             if (! up_ret) goto QN_STOR_UPLOAD_HUGE_ERROR_HANDLING;
 
             code = -1;
@@ -3079,17 +4819,712 @@ QN_SDK qn_json_object_ptr qn_stor_ru_upload_huge(qn_storage_ptr restrict stor, c
         qn_io_rdr_close(sec_rdr);
     } // for
 
+    if (cbuf) free(cbuf->buf);
     qn_io_srdr_destroy(chk_rdr);
     *start_idx = i;
     return qn_stor_ru_api_mkfile(stor, uptoken, qn_stor_ru_to_context_reader(ru), blk_info, qn_stor_ru_uploaded_fsize(ru), upe);
 
 QN_STOR_UPLOAD_HUGE_ERROR_HANDLING:
     qn_io_rdr_close(sec_rdr);
+    if (cbuf) free(cbuf->buf);
     qn_io_srdr_destroy(chk_rdr);
     *start_idx = i;
     return up_ret;
 }
 
+// -------- Asynchronous Upload (abbreviation: au) --------
+
+typedef enum _QN_STOR_AU_STEP
+{
+    QN_STOR_AU_STEP_UPLOAD = 0,
+    QN_STOR_AU_STEP_MKBLK = 1,
+    QN_STOR_AU_STEP_BPUT = 2,
+    QN_STOR_AU_STEP_MKFILE = 3
+} qn_stor_au_step_em;
+
+typedef struct _QN_STOR_ASYNC_UPLOAD
+{
+    qn_http_multi_ptr mt;
+    qn_storage_ptr stor;            // Holds the request and response of the step in flight.
+
+    qn_stor_au_state_em sts;
+    qn_stor_au_step_em step;
+    qn_json_object_ptr result;
+
+    const char * uptoken;
+    qn_stor_upload_extra_ptr upe;
+
+    // ---- Progress of a resumable upload.
+    qn_stor_resumable_upload_ptr ru;
+    qn_bool one_blk;                // Stop after the current block instead of going on to the next one and mkfile.
+    int attempt;
+    qn_uint32 delay;                // In milliseconds, how long the next submission waits before being sent.
+    int blk_idx;
+    qn_uint chk_size;
+    qn_uint chk_bytes;              // Size of the chunk in flight.
+    qn_uint64 chk_begin;            // When the chunk in flight was submitted, in microseconds.
+    qn_stor_ru_block_ptr blk_info;
+    qn_io_reader_itf sec_rdr;
+    qn_io_section_reader_ptr chk_rdr;
+} qn_stor_async_upload_st;
+
+QN_SDK qn_stor_async_upload_ptr qn_stor_au_create(qn_http_multi_ptr restrict mt)
+{
+    qn_stor_async_upload_ptr new_au = calloc(1, sizeof(qn_stor_async_upload_st));
+    if (! new_au) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+
+    new_au->stor = qn_stor_create();
+    if (! new_au->stor) {
+        free(new_au);
+        return NULL;
+    } // if
+
+    new_au->chk_rdr = qn_io_srdr_create(NULL, 0);
+    if (! new_au->chk_rdr) {
+        qn_stor_destroy(new_au->stor);
+        free(new_au);
+        return NULL;
+    } // if
+
+    new_au->mt = mt;
+    return new_au;
+}
+
+static void qn_stor_au_close_block(qn_stor_async_upload_ptr restrict au)
+{
+    if (au->sec_rdr) {
+        qn_io_rdr_close(au->sec_rdr);
+        au->sec_rdr = NULL;
+    } // if
+}
+
+QN_SDK void qn_stor_au_destroy(qn_stor_async_upload_ptr restrict au)
+{
+    if (au) {
+        qn_stor_au_close_block(au);
+        qn_io_srdr_destroy(au->chk_rdr);
+        qn_stor_destroy(au->stor);
+        free(au);
+    } // if
+}
+
+QN_SDK qn_stor_au_state_em qn_stor_au_get_state(qn_stor_async_upload_ptr restrict au)
+{
+    return au->sts;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Get the result of the last step, which is the final result once the upload
+* is done, or the error message object of the failed step.
+*
+* @param [in] au The pointer to the asynchronous upload.
+* @retval non-NULL The result or error message object, owned by the upload.
+* @retval NULL No step has got a response.
+*******************************************************************************/
+QN_SDK qn_json_object_ptr qn_stor_au_get_result(qn_stor_async_upload_ptr restrict au)
+{
+    return au->result;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Get the index of the block being uploaded, which can be passed to
+* qn_stor_ru_upload_huge() or qn_stor_au_start_upload_huge() to resume a
+* failed upload.
+*
+* @param [in] au The pointer to the asynchronous upload.
+* @retval The index of the block.
+*******************************************************************************/
+QN_SDK int qn_stor_au_get_block_index(qn_stor_async_upload_ptr restrict au)
+{
+    return au->blk_idx;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Attach a retry policy to the upload. A chunk put through the mkblk or bput
+* API is put again after a transient failure, until the maximum number of
+* attempts is reached. The backoff delay of the policy is kept by the timer of
+* the multi object, so other transfers go on while the chunk waits. Form
+* uploads and the mkfile call are never resent.
+*
+* @param [in] au The pointer to the asynchronous upload.
+* @param [in] rtp The pointer to the retry policy, or NULL to disable retrying.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_au_set_retry_policy(qn_stor_async_upload_ptr restrict au, qn_stor_retry_policy_ptr restrict rtp)
+{
+    au->stor->rtp = rtp;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Attach a chunk policy to the upload, which gives the size of each chunk put
+* through the mkblk or bput API and learns from how it goes.
+*
+* @param [in] au The pointer to the asynchronous upload.
+* @param [in] chp The pointer to the chunk policy, or NULL to use fixed chunks.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_au_set_chunk_policy(qn_stor_async_upload_ptr restrict au, qn_stor_chunk_policy_ptr restrict chp)
+{
+    au->stor->chp = chp;
+}
+
+static qn_bool qn_stor_au_submit(qn_stor_async_upload_ptr restrict au, qn_stor_au_step_em step, const char * restrict url)
+{
+    qn_uint32 delay = au->delay;
+
+    au->step = step;
+    au->result = NULL;
+    au->delay = 0;
+    au->chk_begin = qn_tm_monotonic_microseconds() + (qn_uint64) delay * 1000;
+    if (! qn_http_multi_submit_post_delayed(au->mt, url, au->stor->req, au->stor->resp, au, delay)) return qn_false;
+    au->sts = QN_STOR_AU_RUNNING;
+    return qn_true;
+}
+
+static qn_bool qn_stor_au_submit_url(qn_stor_async_upload_ptr restrict au, qn_stor_au_step_em step, qn_string url)
+{
+    qn_bool ret;
+
+    if (! url) return qn_false;
+    ret = qn_stor_au_submit(au, step, qn_str_cstr(url));
+    qn_str_destroy(url);
+    return ret;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Start uploading data in one HTTP round-trip, like qn_stor_up_api_upload()
+* does, without blocking the calling thread.
+*
+* @param [in] au The pointer to the asynchronous upload.
+* @param [in] uptoken The upload token, which must stay alive until the upload
+*                     is done.
+* @param [in] data_rdr The reader of the data.
+* @param [in] upe The pointer to an extra option structure, which must stay
+*                 alive until the upload is done.
+* @retval true The request is submitted to the multi object.
+* @retval false Failed in submitting the request, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_bool qn_stor_au_start_upload(qn_stor_async_upload_ptr restrict au, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_rgn_entry_ptr rgn_entry;
+
+    assert(au);
+    assert(uptoken);
+    assert(data_rdr);
+
+    au->uptoken = uptoken;
+    au->upe = upe;
+    au->ru = NULL;
+    au->sts = QN_STOR_AU_FAILED;
+
+    if (! (rgn_entry = qn_stor_up_prepare_upload(au->stor, uptoken, data_rdr, upe))) return qn_false;
+    return qn_stor_au_submit(au, QN_STOR_AU_STEP_UPLOAD, qn_str_cstr(rgn_entry->base_url));
+}
+
+static void qn_stor_au_prepare_chunk(qn_stor_async_upload_ptr restrict au)
+{
+    if (au->stor->chp) au->chk_size = qn_stor_chp_get_chunk_size(au->stor->chp);
+
+    // ---- The last chunk of a block may be short.
+    au->chk_bytes = au->chk_size;
+    if (au->blk_info->bsize - au->blk_info->offset < au->chk_bytes) au->chk_bytes = au->blk_info->bsize - au->blk_info->offset;
+    qn_io_srdr_reset(au->chk_rdr, au->sec_rdr, au->chk_size);
+    qn_stor_ru_prefetch_next_chunk(au->ru, au->blk_idx, au->blk_info, au->chk_size);
+}
+
+// ---- Submit the next chunk of the resumable upload, or the mkfile call after the last block, in the order of qn_stor_ru_upload_huge().
+static qn_bool qn_stor_au_submit_next(qn_stor_async_upload_ptr restrict au)
+{
+    qn_io_reader_itf data_rdr = qn_io_srdr_to_io_reader(au->chk_rdr);
+
+    while (1) {
+        if (! au->sec_rdr) {
+            if (au->one_blk && au->blk_info && qn_stor_ru_is_block_uploaded(au->blk_info)) {
+                au->sts = QN_STOR_AU_DONE;
+                return qn_true;
+            } // if
+            if (au->blk_idx >= qn_stor_ru_get_block_count(au->ru)) {
+                return qn_stor_au_submit_url(au, QN_STOR_AU_STEP_MKFILE, qn_stor_ru_prepare_mkfile(au->stor, au->uptoken, qn_stor_ru_to_context_reader(au->ru), au->blk_info, qn_stor_ru_uploaded_fsize(au->ru), au->upe));
+            } // if
+
+            au->blk_info = qn_stor_ru_get_block_info(au->ru, au->blk_idx);
+            if (au->blk_info && qn_stor_ru_is_block_uploaded(au->blk_info)) {
+                au->blk_idx += 1;
+                continue;
+            } // if
+
+            if (! (au->sec_rdr = qn_stor_ru_create_block_reader(au->ru, au->blk_idx, &au->blk_info))) return qn_false;
+
+            if (au->blk_info->offset == 0) {
+                qn_stor_au_prepare_chunk(au);
+                return qn_stor_au_submit_url(au, QN_STOR_AU_STEP_MKBLK, qn_stor_ru_prepare_mkblk(au->stor, au->uptoken, data_rdr, au->blk_info, au->chk_size, au->upe));
+            } // if
+            if (! qn_io_rdr_advance(au->sec_rdr, au->blk_info->offset)) return qn_false;
+        } // if
+
+        if (qn_stor_ru_is_block_uploaded(au->blk_info)) {
+            qn_stor_au_close_block(au);
+            if (au->one_blk) continue;
+            au->blk_idx += 1;
+            continue;
+        } // if
+
+        qn_stor_au_prepare_chunk(au);
+        return qn_stor_au_submit_url(au, QN_STOR_AU_STEP_BPUT, qn_stor_ru_prepare_bput(au->stor, au->uptoken, data_rdr, au->blk_info, au->chk_size, au->upe));
+    } // while
+    return qn_false;
+}
+
+static qn_bool qn_stor_au_start_blocks(qn_stor_async_upload_ptr restrict au, const char * restrict uptoken, qn_stor_resumable_upload_ptr restrict ru, int start_idx, qn_uint chk_size, qn_bool one_blk, qn_stor_upload_extra_ptr restrict upe)
+{
+    assert(au);
+    assert(uptoken);
+    assert(ru);
+    assert(0 <= start_idx);
+
+    qn_stor_au_close_block(au);
+    au->uptoken = uptoken;
+    au->upe = upe;
+    au->ru = ru;
+    au->one_blk = one_blk;
+    au->attempt = 1;
+    au->delay = 0;
+    au->blk_idx = start_idx;
+    au->blk_info = NULL;
+    au->chk_size = (chk_size == 0) ? QN_STOR_RU_CHUNK_DEFAULT_SIZE : chk_size;
+    au->sts = QN_STOR_AU_FAILED;
+
+    return qn_stor_au_submit_next(au);
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Start uploading a huge file through the mkblk, bput and mkfile APIs, like
+* qn_stor_ru_upload_huge() does, without blocking the calling thread. Each
+* step is submitted to the multi object when the previous one is advanced by
+* qn_stor_au_advance().
+*
+* @param [in] au The pointer to the asynchronous upload.
+* @param [in] uptoken The upload token, which must stay alive until the upload
+*                     is done.
+* @param [in] ru The resumable upload object, which keeps the progress and must
+*                stay alive until the upload is done.
+* @param [in] start_idx The index of the block to start from.
+* @param [in] chk_size The size of each chunk, or 0 for the default size.
+* @param [in] upe The pointer to an extra option structure, which must stay
+*                 alive until the upload is done.
+* @retval true The first request is submitted to the multi object.
+* @retval false Failed in submitting the request, and an error code is set.
+*
+* @remark Chunks are retried only if a retry policy is attached by
+*         qn_stor_au_set_retry_policy(). Resume a failed upload from the index
+*         returned by qn_stor_au_get_block_index().
+*******************************************************************************/
+QN_SDK qn_bool qn_stor_au_start_upload_huge(qn_stor_async_upload_ptr restrict au, const char * restrict uptoken, qn_stor_resumable_upload_ptr restrict ru, int start_idx, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
+{
+    return qn_stor_au_start_blocks(au, uptoken, ru, start_idx, chk_size, qn_false, upe);
+}
+
+// ---- Prepare to put the failed chunk again. The progress is kept only on success, so reopening the block reader finds the same chunk.
+static qn_bool qn_stor_au_retry(qn_stor_async_upload_ptr restrict au, qn_bool transient)
+{
+    if (! transient || (au->step != QN_STOR_AU_STEP_MKBLK && au->step != QN_STOR_AU_STEP_BPUT)) return qn_false;
+    if (! au->stor->rtp || au->attempt >= au->stor->rtp->max_attempts) return qn_false;
+
+    // ---- Back off as qn_stor_send() does, but let the multi object keep the delay instead of blocking other transfers.
+    au->delay = qn_stor_rtp_delay(au->stor, au->attempt);
+    au->attempt += 1;
+    qn_stor_au_close_block(au);
+    return qn_true;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Async-Upload
+*
+* Handle a finished transfer of the upload, and submit the next step if there
+* is one.
+*
+* @param [in] au The pointer to the asynchronous upload, which is the user data
+*                of the result.
+* @param [in] rs The result fetched by qn_http_multi_complete().
+* @retval QN_STOR_AU_RUNNING The next step is submitted.
+* @retval QN_STOR_AU_DONE The upload is done, qn_stor_au_get_result() returns
+*                         the result object.
+* @retval QN_STOR_AU_FAILED The upload failed. Either an error code is set, or
+*                           qn_stor_au_get_result() returns the error message
+*                           object returned by the server.
+*******************************************************************************/
+QN_SDK qn_stor_au_state_em qn_stor_au_advance(qn_stor_async_upload_ptr restrict au, qn_http_multi_result_ptr restrict rs)
+{
+    qn_json_integer code;
+
+    assert(au);
+    assert(rs && rs->user_data == au);
+
+    au->sts = QN_STOR_AU_FAILED;
+    if (rs->err_code != QN_ERR_SUCCEED) {
+        qn_err_set_code(rs->err_code, 0, __FILE__, __LINE__);
+        if (au->step == QN_STOR_AU_STEP_MKBLK || au->step == QN_STOR_AU_STEP_BPUT) qn_stor_chp_sample(au->stor->chp, au->chk_bytes, au->chk_begin, NULL);
+        if (qn_stor_au_retry(au, qn_stor_rtp_is_transient_error())) qn_stor_au_submit_next(au);
+        return au->sts;
+    } // if
+
+    if (! (au->result = qn_stor_rename_error_info(au->stor))) return au->sts;
+    if (au->step == QN_STOR_AU_STEP_UPLOAD || au->step == QN_STOR_AU_STEP_MKFILE) {
+        au->sts = QN_STOR_AU_DONE;
+        return au->sts;
+    } // if
+    qn_stor_chp_sample(au->stor->chp, au->chk_bytes, au->chk_begin, au->result);
+
+    code = -1;
+    if (! qn_json_obj_get_integer(au->result, "fn-code", &code) || code != 200) {
+        if (qn_stor_au_retry(au, qn_stor_rtp_is_transient_code(au->result))) qn_stor_au_submit_next(au);
+        return au->sts;
+    } // if
+    if (! (au->blk_info = qn_stor_ru_update_block_info(au->ru, au->blk_idx, au->result))) return au->sts;
+
+    au->attempt = 1;
+    qn_stor_au_submit_next(au);
+    return au->sts;
+}
+
+enum
+{
+    QN_STOR_RU_PARALLEL_MAX_WORKERS = 16
+};
+
+// ---- Hand the next block which is not uploaded yet to the worker.
+static qn_bool qn_stor_ru_dispatch_block(qn_stor_async_upload_ptr restrict au, const char * restrict uptoken, qn_stor_resumable_upload_ptr restrict ru, int * restrict next_idx, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_stor_ru_block_ptr blk_info;
+
+    while (*next_idx < qn_stor_ru_get_block_count(ru)) {
+        blk_info = qn_stor_ru_get_block_info(ru, *next_idx);
+        *next_idx += 1;
+        if (blk_info && qn_stor_ru_is_block_uploaded(blk_info)) continue;
+
+        qn_stor_au_start_blocks(au, uptoken, ru, *next_idx - 1, chk_size, qn_true, upe);
+        return qn_true;
+    } // while
+    return qn_false;
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Resumable-Upload
+*
+* Upload a huge file like qn_stor_ru_upload_huge() does, but put up to the
+* given number of blocks at the same time. Each block in flight goes through
+* its own connection, never multiplexed with others over one HTTP/2
+* connection, and all transfers are driven by one multi object on the calling
+* thread. The file is made after all blocks are uploaded.
+*
+* @param [in] stor The pointer to the storage object, whose HTTP version, retry
+*                  policy and chunk policy apply to each chunk, and which makes
+*                  the file. If another transport is set to it, blocks are put
+*                  one after another through that transport instead.
+* @param [in] uptoken The upload token.
+* @param [in] ru The resumable upload object, which must have a known size.
+* @param [in,out] start_idx The index of the block to start from. On return it
+*                           holds the lowest index of failed blocks, from
+*                           where the upload can be resumed.
+* @param [in] chk_size The size of each chunk, or 0 for the default size.
+* @param [in] workers The number of blocks in flight, at most 16. Values less
+*                     than 2 fall back to qn_stor_ru_upload_huge().
+* @param [in] upe The pointer to an extra option structure.
+* @retval non-NULL The result object of the mkfile API, or the error message
+*                  object returned by the server for a failed block.
+* @retval NULL Failed in uploading, and an error code is set.
+*******************************************************************************/
+QN_SDK qn_json_object_ptr qn_stor_ru_upload_huge_parallel(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_stor_resumable_upload_ptr ru, int * start_idx, qn_uint chk_size, int workers, qn_stor_upload_extra_ptr restrict upe)
+{
+    qn_http_multi_ptr mt;
+    qn_http_multi_result_st rs;
+    qn_stor_async_upload_ptr aus[QN_STOR_RU_PARALLEL_MAX_WORKERS];
+    qn_stor_async_upload_ptr au;
+    qn_stor_async_upload_ptr failed_au = NULL;
+    qn_json_object_ptr tmp_body;
+    qn_json_object_ptr up_ret = NULL;
+    qn_json_integer code;
+    qn_err_code_em err_code = QN_ERR_SUCCEED;
+    int next_idx = *start_idx;
+    int busy = 0;
+    int running = 0;
+    int i;
+
+    assert(stor);
+    assert(uptoken);
+    assert(ru);
+    assert(0 <= *start_idx);
+
+    // ---- Blocks of a source with unknown size are found one after another, and a transport other than cURL can't be driven by a multi object.
+    if (workers < 2 || qn_stor_ru_get_block_count(ru) == 0 || stor->tpt) return qn_stor_ru_upload_huge(stor, uptoken, ru, start_idx, chk_size, upe);
+    if (workers > QN_STOR_RU_PARALLEL_MAX_WORKERS) workers = QN_STOR_RU_PARALLEL_MAX_WORKERS;
+
+    if (! (mt = qn_http_multi_create())) return NULL;
+
+    // ---- Tune workers like the blocking upload does, and keep blocks from sharing one TCP window under HTTP/2.
+    qn_http_multi_set_version(mt, stor->ver);
+    qn_http_multi_set_tuning_profile(mt, QN_HTTP_TUNING_BULK);
+    qn_http_multi_set_multiplexing(mt, qn_false);
+    for (i = 0; i < workers; i += 1) {
+        if (! (aus[i] = qn_stor_au_create(mt))) {
+            while (--i >= 0) qn_stor_au_destroy(aus[i]);
+            qn_http_multi_destroy(mt);
+            return NULL;
+        } // if
+        qn_stor_au_set_retry_policy(aus[i], stor->rtp);
+        qn_stor_au_set_chunk_policy(aus[i], stor->chp);
+    } // for
+
+    for (i = 0; i < workers && ! failed_au && qn_stor_ru_dispatch_block(aus[i], uptoken, ru, &next_idx, chk_size, upe); i += 1) {
+        if (qn_stor_au_get_state(aus[i]) == QN_STOR_AU_RUNNING) {
+            busy += 1;
+        } else if (qn_stor_au_get_state(aus[i]) == QN_STOR_AU_FAILED) {
+            failed_au = aus[i];
+            err_code = qn_err_get_code();
+        } // if
+    } // for
+
+    // ---- After a block fails, no more blocks are handed out, and those in flight are waited for so that their progress is kept.
+    while (busy > 0) {
+        if (! qn_http_multi_poll(mt, 1000, &running)) {
+            if (! failed_au) err_code = qn_err_get_code();
+            break;
+        } // if
+
+        while (qn_http_multi_complete(mt, &rs)) {
+            au = (qn_stor_async_upload_ptr) rs.user_data;
+            if (qn_stor_au_advance(au, &rs) == QN_STOR_AU_RUNNING) continue;
+
+            while (1) {
+                if (qn_stor_au_get_state(au) == QN_STOR_AU_FAILED) {
+                    if (! failed_au || qn_stor_au_get_block_index(au) < qn_stor_au_get_block_index(failed_au)) {
+                        failed_au = au;
+                        err_code = qn_err_get_code();
+                    } // if
+                    busy -= 1;
+                    break;
+                } // if
+                if (qn_stor_au_get_state(au) == QN_STOR_AU_RUNNING) break;
+                if (failed_au || ! qn_stor_ru_dispatch_block(au, uptoken, ru, &next_idx, chk_size, upe)) {
+                    busy -= 1;
+                    break;
+                } // if
+            } // while
+        } // while
+    } // while
+
+    if (busy > 0 || failed_au) {
+        *start_idx = (failed_au) ? qn_stor_au_get_block_index(failed_au) : *start_idx;
+        code = 0;
+        if (failed_au && qn_stor_au_get_result(failed_au) && qn_json_obj_get_integer(qn_stor_au_get_result(failed_au), "fn-code", &code) && code != 200) {
+            // ---- Hand the error message object returned by the server over to the storage object.
+            tmp_body = stor->obj_body;
+            stor->obj_body = failed_au->stor->obj_body;
+            failed_au->stor->obj_body = tmp_body;
+            up_ret = stor->obj_body;
+        } else if (err_code != QN_ERR_SUCCEED) {
+            qn_err_set_code(err_code, 0, __FILE__, __LINE__);
+        } // if
+    } // if
+
+    for (i = 0; i < workers; i += 1) qn_stor_au_destroy(aus[i]);
+    qn_http_multi_destroy(mt);
+    if (busy > 0 || failed_au) return up_ret;
+
+    *start_idx = qn_stor_ru_get_block_count(ru);
+    return qn_stor_ru_api_mkfile(stor, uptoken, qn_stor_ru_to_context_reader(ru), qn_stor_ru_get_block_info(ru, *start_idx - 1), qn_stor_ru_uploaded_fsize(ru), upe);
+}
+
+// -------- Download Extra (abbreviation: dle) --------
+
+typedef struct _QN_STOR_DOWNLOAD_EXTRA
+{
+    qn_bool ranged;
+    qn_foffset offset;
+    qn_fsize size;
+} qn_stor_download_extra_st;
+
+QN_SDK qn_stor_download_extra_ptr qn_stor_dle_create(void)
+{
+    qn_stor_download_extra_ptr new_dle = calloc(1, sizeof(qn_stor_download_extra_st));
+    if (! new_dle) {
+        qn_err_set_out_of_memory();
+        return NULL;
+    } // if
+    return new_dle;
+}
+
+QN_SDK void qn_stor_dle_destroy(qn_stor_download_extra_ptr restrict dle)
+{
+    if (dle) {
+        free(dle);
+    } // if
+}
+
+QN_SDK void qn_stor_dle_reset(qn_stor_download_extra_ptr restrict dle)
+{
+    memset(dle, 0, sizeof(qn_stor_download_extra_st));
+}
+
+/***************************************************************************//**
+* @ingroup Storage-Download
+*
+* Download only part of the file.
+*
+* @param [in] dle The pointer to the download extra.
+* @param [in] offset The offset of the first byte to download.
+* @param [in] size The number of bytes to download, or 0 for all bytes from the
+*                  offset to the end of the file.
+* @retval NONE
+*******************************************************************************/
+QN_SDK void qn_stor_dle_set_range(qn_stor_download_extra_ptr restrict dle, qn_foffset offset, qn_fsize size)
+{
+    dle->ranged = qn_true;
+    dle->offset = offset;
+    dle->size = size;
+}
+
+// -------- Download Functions (abbreviation: dl) --------
+
+typedef struct _QN_STOR_DL_WRITER
+{
+    qn_io_writer_ptr wrt_vtbl;
+    qn_io_writer_itf data_wrt;
+    qn_http_response_ptr resp;
+} qn_stor_dl_writer_st, *qn_stor_dl_writer_ptr;
+
+static inline qn_stor_dl_writer_ptr qn_stor_dl_wrt_from_io_writer(qn_io_writer_itf restrict itf)
+{
+    return (qn_stor_dl_writer_ptr)( ( (char *) itf ) - (char *)( &((qn_stor_dl_writer_ptr)0)->wrt_vtbl ) );
+}
+
+static void qn_stor_dl_wrt_close_vfn(qn_io_writer_itf restrict itf)
+{
+    // ---- The writer lives on the stack of qn_stor_dl_api_download().
+}
+
+static ssize_t qn_stor_dl_wrt_write_vfn(qn_io_writer_itf restrict itf, const char * restrict buf, size_t buf_size)
+{
+    qn_stor_dl_writer_ptr dw = qn_stor_dl_wrt_from_io_writer(itf);
+
+    // ---- A server ignoring the range sends the whole file with 200, which must not land at the offset of the range.
+    if (qn_http_resp_get_code(dw->resp) != 206) {
+        qn_err_stor_set_range_not_honored();
+        return QN_IO_WRT_WRITING_FAILED;
+    } // if
+    return qn_io_wrt_write(dw->data_wrt, buf, buf_size);
+}
+
+static qn_io_writer_itf qn_stor_dl_wrt_duplicate_vfn(qn_io_writer_itf restrict itf)
+{
+    return NULL;
+}
+
+static qn_io_writer_st qn_stor_dl_wrt_vtable = {
+    &qn_stor_dl_wrt_close_vfn,
+    &qn_stor_dl_wrt_write_vfn,
+    &qn_stor_dl_wrt_duplicate_vfn
+};
+
+/***************************************************************************//**
+* @ingroup Storage-Download
+*
+* Download a file and stream its content into a writer.
+*
+* @param [in] stor The pointer to the storage object.
+* @param [in] url The download URL, signed by qn_mac_make_dnurl() for private
+*                 buckets or by qn_cdn_make_dnurl_with_deadline() for CDN
+*                 timestamp anti-leech.
+* @param [in] data_wrt The writer receiving the content. For ranged downloads it
+*                      must already be positioned at the offset of the range,
+*                      e.g. a file writer opened by qn_fl_wrt_open().
+* @param [in] dle The pointer to an extra option structure, or NULL to download
+*                 the whole file.
+*
+* @retval non-NULL The pointer to a result object, or an error message object.
+* @retval NULL An application error occurs in downloading the file.
+*
+* @remark The result object contains the `fn-code` and `fn-error` fields as
+*         well as the timing fields described in qn_stor_mn_api_stat(). The
+*         content is written only if the response is a 2xx one, otherwise the
+*         error message returned by the server is put into `fn-error`.
+*
+*         For ranged downloads the server must answer with 206, or the function
+*         fails with the QN_ERR_STOR_RANGE_NOT_HONORED error before writing any
+*         byte.
+*
+*         **NOTE**: The caller MUST NOT destroy the result or error object
+*                   because the next call to storage core functions will do
+*                   that.
+*******************************************************************************/
+QN_SDK qn_json_object_ptr qn_stor_dl_api_download(qn_storage_ptr restrict stor, const char * restrict url, qn_io_writer_itf restrict data_wrt, qn_stor_download_extra_ptr restrict dle)
+{
+    qn_bool ret;
+    qn_string range;
+    qn_stor_dl_writer_st dw;
+
+    assert(stor);
+    assert(url);
+    assert(data_wrt);
+
+    // ---- Prepare the request and response.
+    qn_stor_reset(stor);
+
+    if (!qn_stor_prepare_common_request_headers(stor)) return NULL;
+
+    if (dle && dle->ranged) {
+        if (dle->size > 0) {
+            range = qn_cs_sprintf("bytes=%llu-%llu", (unsigned long long)dle->offset, (unsigned long long)(dle->offset + dle->size - 1));
+        } else {
+            range = qn_cs_sprintf("bytes=%llu-", (unsigned long long)dle->offset);
+        } // if
+        if (!range) return NULL;
+
+        ret = qn_http_req_set_header(stor->req, "Range", qn_str_cstr(range));
+        qn_str_destroy(range);
+        if (!ret) return NULL;
+
+        dw.wrt_vtbl = &qn_stor_dl_wrt_vtable;
+        dw.data_wrt = data_wrt;
+        dw.resp = stor->resp;
+        qn_http_resp_set_stream_writer(stor->resp, &dw.wrt_vtbl);
+    } else {
+        qn_http_resp_set_stream_writer(stor->resp, data_wrt);
+    } // if
+
+    if (! (stor->obj_body = qn_json_obj_create())) return NULL;
+    if (! (qn_json_obj_set_integer(stor->obj_body, "fn-code", 0))) return NULL;
+    if (! (qn_json_obj_set_cstr(stor->obj_body, "fn-error", "OK"))) return NULL;
+
+    // ---- Error messages of non-2xx responses are parsed as usual.
+    qn_http_json_wrt_prepare(stor->resp_json_wrt, &stor->obj_body, NULL);
+    qn_http_resp_set_data_writer(stor->resp, stor->resp_json_wrt, &qn_http_json_wrt_write_cfn);
+
+    // ---- Do the download action.
+    ret = qn_stor_send(stor, QN_STOR_API_BULK, url, qn_false);
+    qn_http_resp_set_stream_writer(stor->resp, NULL);
+    if (!ret) return NULL;
+
+    qn_stor_set_response_info(stor);
+    if (!qn_json_obj_rename(stor->obj_body, "error", "fn-error")) return (qn_err_is_no_such_entry()) ? stor->obj_body : NULL;
+    return stor->obj_body;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,42 @@ typedef struct _QN_STORAGE * qn_storage_ptr;
 QN_SDK extern qn_storage_ptr qn_stor_create(void);
 QN_SDK extern void qn_stor_destroy(qn_storage_ptr restrict stor);
 
+QN_SDK extern void qn_stor_set_http_version(qn_storage_ptr restrict stor, qn_http_version_em ver);
+QN_SDK extern void qn_stor_set_transport(qn_storage_ptr restrict stor, qn_http_transport_itf restrict tpt);
+QN_SDK extern qn_bool qn_stor_prewarm(qn_storage_ptr restrict stor, qn_rgn_table_ptr restrict rtbl, const char * restrict name, int timeout_ms);
+
+// -------- Retry Policy (abbreviation: rtp) --------
+
+struct _QN_STOR_RETRY_POLICY;
+typedef struct _QN_STOR_RETRY_POLICY * qn_stor_retry_policy_ptr;
+
+QN_SDK extern qn_stor_retry_policy_ptr qn_stor_rtp_create(void);
+QN_SDK extern void qn_stor_rtp_destroy(qn_stor_retry_policy_ptr restrict rtp);
+
+QN_SDK extern void qn_stor_rtp_set_max_attempts(qn_stor_retry_policy_ptr restrict rtp, int max_attempts);
+QN_SDK extern void qn_stor_rtp_set_backoff(qn_stor_retry_policy_ptr restrict rtp, qn_uint32 base_ms, qn_uint32 max_ms);
+QN_SDK extern void qn_stor_rtp_set_retrying_non_idempotent(qn_stor_retry_policy_ptr restrict rtp, qn_bool enable);
+
+QN_SDK extern void qn_stor_set_retry_policy(qn_storage_ptr restrict stor, qn_stor_retry_policy_ptr restrict rtp);
+
+// -------- Chunk Policy (abbreviation: chp) --------
+
+struct _QN_STOR_CHUNK_POLICY;
+typedef struct _QN_STOR_CHUNK_POLICY * qn_stor_chunk_policy_ptr;
+
+QN_SDK extern qn_stor_chunk_policy_ptr qn_stor_chp_create(void);
+QN_SDK extern void qn_stor_chp_destroy(qn_stor_chunk_policy_ptr restrict chp);
+
+QN_SDK extern void qn_stor_chp_set_size_range(qn_stor_chunk_policy_ptr restrict chp, qn_uint min_size, qn_uint max_size);
+QN_SDK extern void qn_stor_chp_set_target_time(qn_stor_chunk_policy_ptr restrict chp, qn_uint32 target_ms);
+QN_SDK extern qn_uint qn_stor_chp_get_chunk_size(qn_stor_chunk_policy_ptr restrict chp);
+
+QN_SDK extern void qn_stor_set_chunk_policy(qn_storage_ptr restrict stor, qn_stor_chunk_policy_ptr restrict chp);
+
+// -------- Hedged Requests (abbreviation: hdg) --------
+
+QN_SDK extern void qn_stor_set_hedging_delay(qn_storage_ptr restrict stor, qn_uint32 delay_ms);
+
 QN_SDK extern qn_json_object_ptr qn_stor_get_object_body(const qn_storage_ptr restrict stor);
 QN_SDK extern qn_json_array_ptr qn_stor_get_array_body(const qn_storage_ptr restrict stor);
 QN_SDK extern qn_http_hdr_iterator_ptr qn_stor_resp_get_header_iterator(const qn_storage_ptr restrict stor);
@@ -52,6 +88,7 @@ QN_SDK extern void qn_stor_mne_reset(qn_stor_management_extra_ptr restrict me);
 
 QN_SDK extern void qn_stor_mne_set_force_overwrite(qn_stor_management_extra_ptr restrict me, qn_bool force);
 QN_SDK extern void qn_stor_mne_set_region_entry(qn_stor_management_extra_ptr restrict me, qn_rgn_entry_ptr restrict entry);
+QN_SDK extern void qn_stor_mne_set_region_host(qn_stor_management_extra_ptr restrict me, qn_rgn_host_ptr restrict host);
 
 // -------- Management Functions (abbreviation: mn) --------
 
@@ -91,6 +128,7 @@ QN_SDK extern void qn_stor_lse_reset(qn_stor_list_extra_ptr restrict lse);
 QN_SDK extern void qn_stor_lse_set_prefix(qn_stor_list_extra_ptr restrict lse, const char * restrict prefix, const char * restrict delimiter);
 QN_SDK extern void qn_stor_lse_set_marker(qn_stor_list_extra_ptr restrict lse, const char * restrict marker);
 QN_SDK extern void qn_stor_lse_set_limit(qn_stor_list_extra_ptr restrict lse, qn_uint32 limit);
+QN_SDK extern void qn_stor_lse_set_region_host(qn_stor_list_extra_ptr restrict lse, qn_rgn_host_ptr restrict host);
 
 // -------- List Functions (abbreviation: ls) --------
 
@@ -185,36 +223,95 @@ enum
 struct _QN_STOR_RESUMABLE_UPLOAD;
 typedef struct _QN_STOR_RESUMABLE_UPLOAD * qn_stor_resumable_upload_ptr;
 
+struct _QN_STOR_RU_BLOCK;
+typedef struct _QN_STOR_RU_BLOCK * qn_stor_ru_block_ptr;
+
 QN_SDK extern qn_stor_resumable_upload_ptr qn_stor_ru_create(qn_io_reader_itf restrict data_rdr);
 QN_SDK extern void qn_stor_ru_destroy(qn_stor_resumable_upload_ptr restrict ru);
 
 QN_SDK extern qn_string qn_stor_ru_to_string(qn_stor_resumable_upload_ptr restrict ru);
 QN_SDK extern qn_stor_resumable_upload_ptr qn_stor_ru_from_string(const char * restrict str, qn_size str_len);
 
+QN_SDK extern qn_bool qn_stor_ru_open_journal(qn_stor_resumable_upload_ptr restrict ru, const char * restrict fname, qn_uint32 sync_ms, qn_uint32 sync_bytes);
+QN_SDK extern qn_bool qn_stor_ru_sync_journal(qn_stor_resumable_upload_ptr restrict ru);
+QN_SDK extern qn_bool qn_stor_ru_close_journal(qn_stor_resumable_upload_ptr restrict ru);
+QN_SDK extern qn_stor_resumable_upload_ptr qn_stor_ru_from_journal(const char * restrict fname);
+
 QN_SDK extern qn_bool qn_stor_ru_attach(qn_stor_resumable_upload_ptr restrict ru, qn_io_reader_itf restrict data_rdr);
 
 QN_SDK extern int qn_stor_ru_get_block_count(qn_stor_resumable_upload_ptr restrict ru);
 
-QN_SDK extern qn_json_object_ptr qn_stor_ru_get_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx);
-QN_SDK extern qn_json_object_ptr qn_stor_ru_update_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_json_object_ptr restrict up_ret);
+QN_SDK extern qn_stor_ru_block_ptr qn_stor_ru_get_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx);
+QN_SDK extern qn_stor_ru_block_ptr qn_stor_ru_update_block_info(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_json_object_ptr restrict up_ret);
 
-QN_SDK extern qn_io_reader_itf qn_stor_ru_create_block_reader(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_json_object_ptr * restrict blk_info);
+QN_SDK extern qn_io_reader_itf qn_stor_ru_create_block_reader(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, qn_stor_ru_block_ptr * restrict blk_info);
 QN_SDK extern qn_io_reader_itf qn_stor_ru_to_context_reader(qn_stor_resumable_upload_ptr restrict ru);
 
 QN_SDK extern qn_fsize qn_stor_ru_total_fsize(qn_stor_resumable_upload_ptr restrict ru);
 QN_SDK extern qn_fsize qn_stor_ru_uploaded_fsize(qn_stor_resumable_upload_ptr restrict ru);
 
-QN_SDK extern qn_bool qn_stor_ru_is_block_uploaded(qn_json_object_ptr restrict blk_info);
+QN_SDK extern int qn_stor_ru_get_block_offset(qn_stor_ru_block_ptr restrict blk_info);
+QN_SDK extern int qn_stor_ru_get_block_size(qn_stor_ru_block_ptr restrict blk_info);
+QN_SDK extern const char * qn_stor_ru_get_block_context(qn_stor_ru_block_ptr restrict blk_info, qn_size * restrict ctx_size);
+QN_SDK extern const char * qn_stor_ru_get_block_host(qn_stor_ru_block_ptr restrict blk_info);
+QN_SDK extern qn_uint32 qn_stor_ru_get_block_crc32(qn_stor_ru_block_ptr restrict blk_info);
+
+QN_SDK extern qn_bool qn_stor_ru_is_block_uploaded(qn_stor_ru_block_ptr restrict blk_info);
 QN_SDK extern qn_bool qn_stor_ru_is_file_uploaded(qn_stor_resumable_upload_ptr restrict ru);
 
 // -------- Resumable Upload Functions (abbreviation: ru) --------
 
-QN_SDK extern qn_json_object_ptr qn_stor_ru_api_mkblk(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_json_object_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe);
-QN_SDK extern qn_json_object_ptr qn_stor_ru_api_bput(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_json_object_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe);
-QN_SDK extern qn_json_object_ptr qn_stor_ru_api_mkfile(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict ctx_rdr, qn_json_object_ptr restrict last_blk_info, qn_fsize fsize, qn_stor_upload_extra_ptr restrict upe);
+QN_SDK extern qn_json_object_ptr qn_stor_ru_api_mkblk(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe);
+QN_SDK extern qn_json_object_ptr qn_stor_ru_api_bput(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_ru_block_ptr restrict blk_info, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe);
+QN_SDK extern qn_json_object_ptr qn_stor_ru_api_mkfile(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_io_reader_itf restrict ctx_rdr, qn_stor_ru_block_ptr restrict last_blk_info, qn_fsize fsize, qn_stor_upload_extra_ptr restrict upe);
 
 QN_SDK extern qn_json_object_ptr qn_stor_ru_upload_huge(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_stor_resumable_upload_ptr ru, int * start_idx, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe);
 
+// -------- Asynchronous Upload (abbreviation: au) --------
+
+typedef enum _QN_STOR_AU_STATE
+{
+    QN_STOR_AU_IDLE = 0,
+    QN_STOR_AU_RUNNING = 1,
+    QN_STOR_AU_DONE = 2,
+    QN_STOR_AU_FAILED = 3
+} qn_stor_au_state_em;
+
+struct _QN_STOR_ASYNC_UPLOAD;
+typedef struct _QN_STOR_ASYNC_UPLOAD * qn_stor_async_upload_ptr;
+
+QN_SDK extern qn_stor_async_upload_ptr qn_stor_au_create(qn_http_multi_ptr restrict mt);
+QN_SDK extern void qn_stor_au_destroy(qn_stor_async_upload_ptr restrict au);
+
+QN_SDK extern void qn_stor_au_set_retry_policy(qn_stor_async_upload_ptr restrict au, qn_stor_retry_policy_ptr restrict rtp);
+QN_SDK extern void qn_stor_au_set_chunk_policy(qn_stor_async_upload_ptr restrict au, qn_stor_chunk_policy_ptr restrict chp);
+
+QN_SDK extern qn_bool qn_stor_au_start_upload(qn_stor_async_upload_ptr restrict au, const char * restrict uptoken, qn_io_reader_itf restrict data_rdr, qn_stor_upload_extra_ptr restrict upe);
+QN_SDK extern qn_bool qn_stor_au_start_upload_huge(qn_stor_async_upload_ptr restrict au, const char * restrict uptoken, qn_stor_resumable_upload_ptr restrict ru, int start_idx, qn_uint chk_size, qn_stor_upload_extra_ptr restrict upe);
+
+QN_SDK extern qn_stor_au_state_em qn_stor_au_advance(qn_stor_async_upload_ptr restrict au, qn_http_multi_result_ptr restrict rs);
+
+QN_SDK extern qn_stor_au_state_em qn_stor_au_get_state(qn_stor_async_upload_ptr restrict au);
+QN_SDK extern qn_json_object_ptr qn_stor_au_get_result(qn_stor_async_upload_ptr restrict au);
+QN_SDK extern int qn_stor_au_get_block_index(qn_stor_async_upload_ptr restrict au);
+
+QN_SDK extern qn_json_object_ptr qn_stor_ru_upload_huge_parallel(qn_storage_ptr restrict stor, const char * restrict uptoken, qn_stor_resumable_upload_ptr ru, int * start_idx, qn_uint chk_size, int workers, qn_stor_upload_extra_ptr restrict upe);
+
+// -------- Download Extra (abbreviation: dle) --------
+
+struct _QN_STOR_DOWNLOAD_EXTRA;
+typedef struct _QN_STOR_DOWNLOAD_EXTRA * qn_stor_download_extra_ptr;
+
+QN_SDK extern qn_stor_download_extra_ptr qn_stor_dle_create(void);
+QN_SDK extern void qn_stor_dle_destroy(qn_stor_download_extra_ptr restrict dle);
+QN_SDK extern void qn_stor_dle_reset(qn_stor_download_extra_ptr restrict dle);
+
+QN_SDK extern void qn_stor_dle_set_range(qn_stor_download_extra_ptr restrict dle, qn_foffset offset, qn_fsize size);
+
+// -------- Download Functions (abbreviation: dl) --------
+
+QN_SDK extern qn_json_object_ptr qn_stor_dl_api_download(qn_storage_ptr restrict stor, const char * restrict url, qn_io_writer_itf restrict data_wrt, qn_stor_download_extra_ptr restrict dle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,7 +8,7 @@ extern "C"
 {
 #endif
 
-static const char * qn_ver_full_string = "libqiniu-0.12.2";
+static const char * qn_ver_full_string = "libqiniu-0.13.0";
 
 QN_SDK const char * qn_ver_get_full_string(void)
 {
@@ -495,6 +495,61 @@ void test_obj_set()
     qn_json_obj_destroy(obj_root);
 }
 
+void test_obj_set_beyond_default_capacity(void)
+{
+    qn_json_object_ptr obj_root = NULL;
+    qn_json_integer int_ret = 0;
+    char key[] = {"_int00"};
+    int i = 0;
+
+    obj_root = qn_json_obj_create();
+    CU_ASSERT_PTR_NOT_NULL(obj_root);
+
+    // insert keys in descending order so that every insertion moves all elements set before
+    for (i = 31; i >= 0; i -= 1) {
+        key[4] = '0' + i / 10;
+        key[5] = '0' + i % 10;
+        CU_ASSERT_TRUE(qn_json_obj_set_integer(obj_root, key, i));
+    } // for
+    CU_ASSERT_EQUAL(qn_json_obj_size(obj_root), 32);
+
+    for (i = 0; i < 32; i += 1) {
+        key[4] = '0' + i / 10;
+        key[5] = '0' + i % 10;
+        int_ret = -1;
+        CU_ASSERT_TRUE(qn_json_obj_get_integer(obj_root, key, &int_ret));
+        CU_ASSERT_EQUAL(int_ret, i);
+    } // for
+
+    qn_json_obj_destroy(obj_root);
+}
+
+void test_destroy_array_holding_elements(void)
+{
+    qn_json_array_ptr arr_root = NULL;
+    qn_json_object_ptr obj_elem = NULL;
+    qn_json_array_ptr arr_elem = NULL;
+
+    // fewer elements than the default capacity, so that the element count differs from the capacity
+    arr_root = qn_json_arr_create();
+    CU_ASSERT_FATAL(arr_root != NULL);
+
+    CU_ASSERT_TRUE(qn_json_arr_push_cstr(arr_root, "A string element"));
+
+    obj_elem = qn_json_arr_push_new_empty_object(arr_root);
+    CU_ASSERT_FATAL(obj_elem != NULL);
+    CU_ASSERT_TRUE(qn_json_obj_set_cstr(obj_elem, "_str", "A string in an object"));
+
+    arr_elem = qn_json_arr_push_new_empty_array(arr_root);
+    CU_ASSERT_FATAL(arr_elem != NULL);
+    CU_ASSERT_TRUE(qn_json_arr_push_cstr(arr_elem, "A string in an array"));
+
+    CU_ASSERT_EQUAL(qn_json_arr_size(arr_root), 3);
+
+    // all elements must be released, which a leak checker verifies
+    qn_json_arr_destroy(arr_root);
+}
+
 void test_manipulate_array(void)
 {
     qn_bool bool_val;
@@ -697,6 +752,8 @@ CU_TestInfo test_normal_cases_of_json_manipulating[] = {
     {"test_obj_rename_accompanied_field_3_new_key_equals_to_old_key()", test_obj_rename_accompanied_field_3_new_key_equals_to_old_key},
     {"test_obj_rename_accompanied_field_4_new_key_replace_old_key_in_place()", test_obj_rename_accompanied_field_4_new_key_replace_old_key_in_place},
     {"test_obj_set()", test_obj_set},
+    {"test_obj_set_beyond_default_capacity()", test_obj_set_beyond_default_capacity},
+    {"test_destroy_array_holding_elements()", test_destroy_array_holding_elements},
     {"test_manipulate_array()", test_manipulate_array},
     {"test_arr_replace()", test_arr_replace},
     CU_TEST_INFO_NULL
@@ -2343,7 +2400,7 @@ void test_format_array_holding_string_element(void)
     arr_root = qn_json_arr_create();
     CU_ASSERT_FATAL(arr_root != NULL);
 
-    CU_ASSERT_TRUE(qn_json_arr_push_string(arr_root, "Normal string"));
+    CU_ASSERT_TRUE(qn_json_arr_push_cstr(arr_root, "Normal string"));
 
     CU_ASSERT_TRUE(qn_json_fmt_format_array(fmt, arr_root, buf, &buf_size));
     CU_ASSERT_EQUAL_FATAL(buf_size, 17);
@@ -2577,7 +2634,7 @@ void test_format_array_holding_complex_element(void)
     obj_elem = qn_json_arr_push_new_empty_object(arr_root);
     CU_ASSERT_TRUE(obj_elem != NULL);
 
-    CU_ASSERT_TRUE(qn_json_obj_set_string(obj_elem, "_str", "Trivial"));
+    CU_ASSERT_TRUE(qn_json_obj_set_cstr(obj_elem, "_str", "Trivial"));
 
     buf_size = sizeof(buf);
     CU_ASSERT_TRUE(qn_json_fmt_format_array(fmt, arr_root, buf, &buf_size));
@@ -0,0 +1,718 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <CUnit/Basic.h>
+
+#include "qiniu/base/errors.h"
+#include "qiniu/base/json.h"
+#include "qiniu/os/file.h"
+#include "qiniu/auth.h"
+#include "qiniu/http.h"
+#include "qiniu/region.h"
+#include "qiniu/storage.h"
+
+#define TEST_RU_BLOCK_SIZE (4 * 1024 * 1024)
+
+// ---- helper functions ----
+
+static qn_string make_temp_file(qn_fsize fsize)
+{
+    char fname[] = {"/tmp/test_storage_XXXXXX"};
+    int fd;
+
+    fd = mkstemp(fname);
+    if (fd < 0) return NULL;
+
+    // ---- A sparse file costs no disk space however large it is.
+    if (ftruncate(fd, fsize) < 0) {
+        close(fd);
+        unlink(fname);
+        return NULL;
+    } // if
+    close(fd);
+    return qn_cs_duplicate(fname);
+}
+
+static qn_json_object_ptr make_upload_result(const char * restrict ctx, qn_json_integer offset)
+{
+    qn_json_object_ptr up_ret = qn_json_obj_create();
+    if (! up_ret) return NULL;
+
+    if (! qn_json_obj_set_cstr(up_ret, "ctx", ctx) || ! qn_json_obj_set_cstr(up_ret, "checksum", "checksum") || ! qn_json_obj_set_cstr(up_ret, "host", "http://up.qiniu.com") || ! qn_json_obj_set_integer(up_ret, "crc32", 1) || ! qn_json_obj_set_integer(up_ret, "offset", offset)) {
+        qn_json_obj_destroy(up_ret);
+        return NULL;
+    } // if
+    return up_ret;
+}
+
+// ---- The storage object sends requests to an in-process loopback transport, so no server is needed.
+
+static qn_storage_ptr test_stor;
+static qn_http_loopback_ptr test_lpbk;
+static qn_rgn_host_ptr test_rgn_host;
+static qn_stor_management_extra_ptr test_mne;
+static qn_stor_retry_policy_ptr test_rtp;
+static qn_mac_ptr test_mac;
+
+static int init_loopback_storage(void)
+{
+    if (! (test_stor = qn_stor_create())) return 1;
+    if (! (test_lpbk = qn_http_lpbk_create())) return 1;
+    if (! (test_rgn_host = qn_rgn_host_create())) return 1;
+    if (! qn_rgn_host_add_entry(test_rgn_host, "http://rs1.loopback.invalid", "rs.qiniu.com")) return 1;
+    if (! qn_rgn_host_add_entry(test_rgn_host, "http://rs2.loopback.invalid", "rs.qiniu.com")) return 1;
+    if (! (test_mne = qn_stor_mne_create())) return 1;
+    if (! (test_rtp = qn_stor_rtp_create())) return 1;
+    if (! (test_mac = qn_mac_create("access-key", "secret-key"))) return 1;
+
+    qn_stor_mne_set_region_entry(test_mne, qn_rgn_host_get_entry(test_rgn_host, 0));
+    qn_stor_rtp_set_backoff(test_rtp, 1, 2);
+    qn_stor_set_transport(test_stor, qn_http_lpbk_to_transport(test_lpbk));
+    return 0;
+}
+
+static int clean_loopback_storage(void)
+{
+    qn_mac_destroy(test_mac);
+    qn_stor_rtp_destroy(test_rtp);
+    qn_stor_mne_destroy(test_mne);
+    qn_rgn_host_destroy(test_rgn_host);
+    qn_http_lpbk_destroy(test_lpbk);
+    qn_stor_destroy(test_stor);
+    return 0;
+}
+
+// ---- Each entry of the region host answers with its own status code, or fails in transmission if the code is 0.
+static int test_entry_codes[2];
+
+static qn_bool answer_by_entry(void * restrict user_data, qn_http_loopback_ptr restrict lpbk, const char * restrict url, qn_http_request_ptr restrict req)
+{
+    static const char stat_ret[] = {"{\"fsize\":1,\"hash\":\"hash\",\"mimeType\":\"text/plain\",\"putTime\":1}"};
+    static const char error_ret[] = {"{\"error\":\"service unavailable\"}"};
+    int code = test_entry_codes[(strstr(url, "//rs1.")) ? 0 : 1];
+
+    if (code == 0) {
+        qn_err_comm_set_transmission_failed();
+        return qn_false;
+    } // if
+    if (code == 200) return qn_http_lpbk_set_response(lpbk, code, stat_ret, sizeof(stat_ret) - 1);
+    return qn_http_lpbk_set_response(lpbk, code, error_ret, sizeof(error_ret) - 1);
+}
+
+static qn_json_integer get_code(qn_json_object_ptr restrict ret)
+{
+    qn_json_integer code = 0;
+    qn_json_obj_get_integer(ret, "fn-code", &code);
+    return code;
+}
+
+// ---- test functions ----
+
+void test_read_contexts_in_small_pieces(void)
+{
+    qn_string fname;
+    qn_file_ptr fl;
+    qn_stor_resumable_upload_ptr ru;
+    qn_stor_ru_block_ptr blk_info;
+    qn_json_object_ptr up_ret;
+    qn_io_reader_itf rdr;
+    qn_fsize fsize = TEST_RU_BLOCK_SIZE * 2 + 1;
+    char ctx[32];
+    char buf[128];
+    size_t size = 0;
+    ssize_t ret;
+    int i;
+
+    fname = make_temp_file(fsize);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fname);
+
+    fl = qn_fl_open(fname, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fl);
+
+    ru = qn_stor_ru_create(qn_fl_to_io_reader(fl));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ru);
+    CU_ASSERT_EQUAL(qn_stor_ru_get_block_count(ru), 3);
+
+    for (i = 0; i < 3; i += 1) {
+        rdr = qn_stor_ru_create_block_reader(ru, i, &blk_info);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(rdr);
+        qn_io_rdr_close(rdr);
+
+        snprintf(ctx, sizeof(ctx), "context-of-block-%d", i);
+        up_ret = make_upload_result(ctx, (i < 2) ? TEST_RU_BLOCK_SIZE : 1);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(up_ret);
+        CU_ASSERT_PTR_NOT_NULL(qn_stor_ru_update_block_info(ru, i, up_ret));
+        qn_json_obj_destroy(up_ret);
+    } // for
+
+    // ---- Read with a buffer shorter than a context, so that each context spans several reads.
+    rdr = qn_stor_ru_to_context_reader(ru);
+    while ((ret = qn_io_rdr_read(rdr, buf + size, 5)) > 0) size += ret;
+    CU_ASSERT_EQUAL(ret, 0);
+    CU_ASSERT_EQUAL(size, qn_io_rdr_size(rdr));
+    buf[size] = '\0';
+    CU_ASSERT_STRING_EQUAL(buf, "context-of-block-0,context-of-block-1,context-of-block-2");
+
+    qn_stor_ru_destroy(ru);
+    qn_fl_close(fl);
+    unlink(fname);
+    qn_str_destroy(fname);
+}
+
+void test_read_block_beyond_2gb(void)
+{
+    qn_string fname;
+    qn_file_ptr fl;
+    qn_stor_resumable_upload_ptr ru;
+    qn_stor_ru_block_ptr blk_info;
+    qn_io_reader_itf rdr;
+    int blk_idx = 600;
+    qn_fsize fsize = (qn_fsize)TEST_RU_BLOCK_SIZE * (blk_idx + 1);
+    char buf[16];
+    int fd;
+
+    fname = make_temp_file(fsize);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fname);
+
+    // ---- Put a mark at the beginning of the block, which is beyond 2GB.
+    fd = open(fname, O_WRONLY);
+    CU_ASSERT_FATAL(0 <= fd);
+    CU_ASSERT_EQUAL(pwrite(fd, "block-600", 9, (off_t)TEST_RU_BLOCK_SIZE * blk_idx), 9);
+    close(fd);
+
+    fl = qn_fl_open(fname, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fl);
+
+    ru = qn_stor_ru_create(qn_fl_to_io_reader(fl));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ru);
+    CU_ASSERT_EQUAL(qn_stor_ru_get_block_count(ru), blk_idx + 1);
+
+    rdr = qn_stor_ru_create_block_reader(ru, blk_idx, &blk_info);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rdr);
+    CU_ASSERT_EQUAL(qn_io_rdr_read(rdr, buf, 9), 9);
+    CU_ASSERT_EQUAL(memcmp(buf, "block-600", 9), 0);
+    qn_io_rdr_close(rdr);
+
+    qn_stor_ru_destroy(ru);
+    qn_fl_close(fl);
+    unlink(fname);
+    qn_str_destroy(fname);
+}
+
+static qn_bool put_block(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, const char * restrict ctx, const char * restrict host, qn_json_integer offset)
+{
+    qn_json_object_ptr up_ret = make_upload_result(ctx, offset);
+    qn_bool ret;
+
+    if (! up_ret) return qn_false;
+    ret = qn_json_obj_set_cstr(up_ret, "host", host) && qn_stor_ru_update_block_info(ru, blk_idx, up_ret) != NULL;
+    qn_json_obj_destroy(up_ret);
+    return ret;
+}
+
+static void check_block(qn_stor_resumable_upload_ptr restrict ru, int blk_idx, const char * restrict ctx, const char * restrict host, int offset)
+{
+    qn_stor_ru_block_ptr blk_info;
+    const char * blk_ctx;
+    qn_size ctx_size;
+
+    blk_info = qn_stor_ru_get_block_info(ru, blk_idx);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(blk_info);
+    CU_ASSERT_EQUAL(qn_stor_ru_get_block_offset(blk_info), offset);
+    CU_ASSERT_EQUAL(qn_stor_ru_get_block_crc32(blk_info), 1);
+    CU_ASSERT_STRING_EQUAL(qn_stor_ru_get_block_host(blk_info), host);
+
+    blk_ctx = qn_stor_ru_get_block_context(blk_info, &ctx_size);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(blk_ctx);
+    CU_ASSERT_EQUAL(ctx_size, strlen(ctx));
+    CU_ASSERT_EQUAL(memcmp(blk_ctx, ctx, ctx_size), 0);
+}
+
+void test_round_trip_through_journal(void)
+{
+    qn_string fname;
+    qn_string jnl_fname;
+    qn_file_ptr fl;
+    qn_stor_resumable_upload_ptr ru;
+    qn_stor_resumable_upload_ptr new_ru;
+    qn_io_reader_itf rdr;
+    qn_stor_ru_block_ptr blk_info;
+    char long_ctx[601];
+    char long_host[301];
+    qn_fsize fsize = TEST_RU_BLOCK_SIZE * 2 + 1;
+
+    // ---- Both are longer than the data of one journal record.
+    memset(long_ctx, 'c', sizeof(long_ctx) - 1);
+    long_ctx[sizeof(long_ctx) - 1] = '\0';
+    memcpy(long_host, "http://", 7);
+    memset(long_host + 7, 'h', sizeof(long_host) - 8);
+    long_host[sizeof(long_host) - 1] = '\0';
+
+    fname = make_temp_file(fsize);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fname);
+    jnl_fname = make_temp_file(0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(jnl_fname);
+
+    fl = qn_fl_open(fname, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fl);
+    ru = qn_stor_ru_create(qn_fl_to_io_reader(fl));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ru);
+
+    rdr = qn_stor_ru_create_block_reader(ru, 0, &blk_info);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rdr);
+    qn_io_rdr_close(rdr);
+
+    CU_ASSERT_TRUE_FATAL(qn_stor_ru_open_journal(ru, jnl_fname, 0, 0));
+    CU_ASSERT_TRUE(put_block(ru, 0, "short-context", "http://up.qiniu.com", 1024));
+    CU_ASSERT_TRUE(put_block(ru, 0, long_ctx, long_host, TEST_RU_BLOCK_SIZE));
+    CU_ASSERT_TRUE(put_block(ru, 2, "last-context", "http://up.qiniu.com", 1));
+    CU_ASSERT_TRUE(qn_stor_ru_close_journal(ru));
+
+    new_ru = qn_stor_ru_from_journal(jnl_fname);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(new_ru);
+    CU_ASSERT_EQUAL(qn_stor_ru_get_block_count(new_ru), 3);
+    CU_ASSERT_EQUAL(qn_stor_ru_total_fsize(new_ru), fsize);
+    CU_ASSERT_EQUAL(qn_stor_ru_uploaded_fsize(new_ru), TEST_RU_BLOCK_SIZE + 1);
+    check_block(new_ru, 0, long_ctx, long_host, TEST_RU_BLOCK_SIZE);
+    check_block(new_ru, 2, "last-context", "http://up.qiniu.com", 1);
+    CU_ASSERT_FALSE(qn_stor_ru_is_block_uploaded(qn_stor_ru_get_block_info(new_ru, 1)));
+
+    qn_stor_ru_destroy(new_ru);
+    qn_stor_ru_destroy(ru);
+    qn_fl_close(fl);
+    unlink(jnl_fname);
+    unlink(fname);
+    qn_str_destroy(jnl_fname);
+    qn_str_destroy(fname);
+}
+
+void test_replay_journal_with_torn_tail(void)
+{
+    qn_string fname;
+    qn_string jnl_fname;
+    qn_file_ptr fl;
+    qn_stor_resumable_upload_ptr ru;
+    qn_stor_resumable_upload_ptr new_ru;
+    qn_io_reader_itf rdr;
+    qn_stor_ru_block_ptr blk_info;
+    char long_ctx[601];
+    struct stat st;
+    off_t full_size;
+    off_t rec_size;
+
+    memset(long_ctx, 'c', sizeof(long_ctx) - 1);
+    long_ctx[sizeof(long_ctx) - 1] = '\0';
+
+    fname = make_temp_file(TEST_RU_BLOCK_SIZE);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fname);
+    jnl_fname = make_temp_file(0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(jnl_fname);
+
+    fl = qn_fl_open(fname, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(fl);
+    ru = qn_stor_ru_create(qn_fl_to_io_reader(fl));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ru);
+
+    rdr = qn_stor_ru_create_block_reader(ru, 0, &blk_info);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rdr);
+    qn_io_rdr_close(rdr);
+
+    // ---- The journal holds the header, the host, and one record for the first put, then three records for the second one.
+    CU_ASSERT_TRUE_FATAL(qn_stor_ru_open_journal(ru, jnl_fname, 0, 0));
+    CU_ASSERT_TRUE(put_block(ru, 0, "first-context", "http://up.qiniu.com", 1024));
+    CU_ASSERT_EQUAL_FATAL(stat(jnl_fname, &st), 0);
+    rec_size = st.st_size / 3;
+    CU_ASSERT_TRUE(put_block(ru, 0, long_ctx, "http://up.qiniu.com", 2048));
+    CU_ASSERT_TRUE(qn_stor_ru_close_journal(ru));
+    CU_ASSERT_EQUAL_FATAL(stat(jnl_fname, &st), 0);
+    full_size = st.st_size;
+    CU_ASSERT_EQUAL(full_size, rec_size * 6);
+
+    // ---- The last continuation record is torn.
+    CU_ASSERT_EQUAL_FATAL(truncate(jnl_fname, full_size - 100), 0);
+    new_ru = qn_stor_ru_from_journal(jnl_fname);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(new_ru);
+    check_block(new_ru, 0, "first-context", "http://up.qiniu.com", 1024);
+    CU_ASSERT_EQUAL(qn_stor_ru_uploaded_fsize(new_ru), 1024);
+    qn_stor_ru_destroy(new_ru);
+
+    // ---- Only the first record of the second put is complete.
+    CU_ASSERT_EQUAL_FATAL(truncate(jnl_fname, rec_size * 4), 0);
+    new_ru = qn_stor_ru_from_journal(jnl_fname);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(new_ru);
+    check_block(new_ru, 0, "first-context", "http://up.qiniu.com", 1024);
+    qn_stor_ru_destroy(new_ru);
+
+    // ---- The record of the first put is torn, so nothing is put.
+    CU_ASSERT_EQUAL_FATAL(truncate(jnl_fname, rec_size * 3 - 1), 0);
+    new_ru = qn_stor_ru_from_journal(jnl_fname);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(new_ru);
+    CU_ASSERT_FALSE(qn_stor_ru_is_block_uploaded(qn_stor_ru_get_block_info(new_ru, 0)));
+    CU_ASSERT_EQUAL(qn_stor_ru_uploaded_fsize(new_ru), 0);
+    qn_stor_ru_destroy(new_ru);
+
+    qn_stor_ru_destroy(ru);
+    qn_fl_close(fl);
+    unlink(jnl_fname);
+    unlink(fname);
+    qn_str_destroy(jnl_fname);
+    qn_str_destroy(fname);
+}
+
+void test_retry_batch_with_array_body(void)
+{
+    static const char items[] = {"[{\"code\":200,\"data\":{\"fsize\":1}},{\"code\":612,\"data\":{\"error\":\"no such file or directory\"}}]"};
+    qn_stor_batch_ptr bt;
+    qn_json_object_ptr ret;
+    qn_json_array_ptr arr;
+    qn_uint64 cnt;
+
+    bt = qn_stor_bt_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(bt);
+    CU_ASSERT_TRUE(qn_stor_bt_add_stat_op(bt, "bucket", "key-1"));
+    CU_ASSERT_TRUE(qn_stor_bt_add_stat_op(bt, "bucket", "key-2"));
+
+    // ---- The array body used to crash the retry check, which wrote the status code into a NULL object.
+    qn_stor_set_retry_policy(test_stor, test_rtp);
+    CU_ASSERT_TRUE(qn_http_lpbk_set_response(test_lpbk, 200, items, sizeof(items) - 1));
+
+    cnt = qn_http_lpbk_get_request_count(test_lpbk);
+    ret = qn_stor_bt_api_batch(test_stor, test_mac, bt, test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 200);
+    CU_ASSERT_TRUE(qn_json_obj_get_array(ret, "items", &arr));
+    CU_ASSERT_EQUAL(qn_json_arr_size(arr), 2);
+    CU_ASSERT_EQUAL(qn_http_lpbk_get_request_count(test_lpbk), cnt + 1);
+
+    // ---- A batch is not resendable, so a server error is returned as is.
+    CU_ASSERT_TRUE(qn_http_lpbk_set_response(test_lpbk, 503, "{\"error\":\"busy\"}", 16));
+
+    cnt = qn_http_lpbk_get_request_count(test_lpbk);
+    ret = qn_stor_bt_api_batch(test_stor, test_mac, bt, test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 503);
+    CU_ASSERT_EQUAL(qn_http_lpbk_get_request_count(test_lpbk), cnt + 1);
+
+    qn_stor_set_retry_policy(test_stor, NULL);
+    qn_stor_bt_destroy(bt);
+}
+
+// ---- Answer with 503 until the given number of failures is used up, then with the stat result.
+static int test_failures_left;
+
+static qn_bool answer_after_failures(void * restrict user_data, qn_http_loopback_ptr restrict lpbk, const char * restrict url, qn_http_request_ptr restrict req)
+{
+    static const char stat_ret[] = {"{\"fsize\":1,\"hash\":\"hash\",\"mimeType\":\"text/plain\",\"putTime\":1}"};
+    static const char error_ret[] = {"{\"error\":\"service unavailable\"}"};
+
+    if (test_failures_left > 0) {
+        test_failures_left -= 1;
+        return qn_http_lpbk_set_response(lpbk, 503, error_ret, sizeof(error_ret) - 1);
+    } // if
+    return qn_http_lpbk_set_response(lpbk, 200, stat_ret, sizeof(stat_ret) - 1);
+}
+
+void test_retry_stat_until_success(void)
+{
+    qn_json_object_ptr ret;
+    qn_json_integer fsize;
+    qn_uint64 cnt;
+
+    qn_stor_set_retry_policy(test_stor, test_rtp);
+    qn_stor_rtp_set_max_attempts(test_rtp, 3);
+    qn_http_lpbk_set_handler(test_lpbk, NULL, &answer_after_failures);
+
+    // ---- A stat is resendable, so two server errors are retried and the third attempt succeeds.
+    test_failures_left = 2;
+
+    cnt = qn_http_lpbk_get_request_count(test_lpbk);
+    ret = qn_stor_mn_api_stat(test_stor, test_mac, "bucket", "key", test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 200);
+    CU_ASSERT_EQUAL(qn_http_lpbk_get_request_count(test_lpbk), cnt + 3);
+
+    fsize = 0;
+    CU_ASSERT_TRUE(qn_json_obj_get_integer(ret, "fsize", &fsize));
+    CU_ASSERT_EQUAL(fsize, 1);
+
+    // ---- Once all attempts are used up, the last server error is returned.
+    test_failures_left = 3;
+
+    cnt = qn_http_lpbk_get_request_count(test_lpbk);
+    ret = qn_stor_mn_api_stat(test_stor, test_mac, "bucket", "key", test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 503);
+    CU_ASSERT_EQUAL(qn_http_lpbk_get_request_count(test_lpbk), cnt + 3);
+
+    test_failures_left = 0;
+    qn_http_lpbk_set_handler(test_lpbk, NULL, NULL);
+    qn_stor_set_retry_policy(test_stor, NULL);
+}
+
+void test_hedge_answered_by_second_entry(void)
+{
+    qn_json_object_ptr ret;
+    qn_json_integer fsize = 0;
+    qn_uint64 cnt;
+
+    qn_stor_set_hedging_delay(test_stor, 1);
+    qn_stor_mne_set_region_host(test_mne, test_rgn_host);
+    qn_http_lpbk_set_handler(test_lpbk, NULL, &answer_by_entry);
+    test_entry_codes[0] = 503;
+    test_entry_codes[1] = 200;
+
+    cnt = qn_http_lpbk_get_request_count(test_lpbk);
+    ret = qn_stor_mn_api_stat(test_stor, test_mac, "bucket", "key", test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 200);
+    CU_ASSERT_TRUE(qn_json_obj_get_integer(ret, "fsize", &fsize));
+    CU_ASSERT_EQUAL(fsize, 1);
+    CU_ASSERT_EQUAL(qn_http_lpbk_get_request_count(test_lpbk), cnt + 2);
+
+    qn_http_lpbk_set_handler(test_lpbk, NULL, NULL);
+    qn_stor_mne_set_region_host(test_mne, NULL);
+    qn_stor_set_hedging_delay(test_stor, 0);
+}
+
+void test_hedge_prefers_completed_response(void)
+{
+    qn_json_object_ptr ret;
+
+    qn_stor_set_hedging_delay(test_stor, 1);
+    qn_stor_mne_set_region_host(test_mne, test_rgn_host);
+    qn_http_lpbk_set_handler(test_lpbk, NULL, &answer_by_entry);
+
+    // ---- The 5xx answer of the first entry wins over the failure of the duplicate.
+    test_entry_codes[0] = 503;
+    test_entry_codes[1] = 0;
+
+    ret = qn_stor_mn_api_stat(test_stor, test_mac, "bucket", "key", test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 503);
+
+    // ---- So does the 5xx answer of the duplicate over the failure of the first entry.
+    test_entry_codes[0] = 0;
+    test_entry_codes[1] = 502;
+
+    ret = qn_stor_mn_api_stat(test_stor, test_mac, "bucket", "key", test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 502);
+
+    qn_http_lpbk_set_handler(test_lpbk, NULL, NULL);
+    qn_stor_mne_set_region_host(test_mne, NULL);
+    qn_stor_set_hedging_delay(test_stor, 0);
+}
+
+void test_hedge_with_retry_policy(void)
+{
+    qn_json_object_ptr ret;
+    qn_uint64 cnt;
+
+    qn_stor_set_hedging_delay(test_stor, 1);
+    qn_stor_set_retry_policy(test_stor, test_rtp);
+    qn_stor_rtp_set_max_attempts(test_rtp, 3);
+    qn_stor_mne_set_region_host(test_mne, test_rgn_host);
+    qn_http_lpbk_set_handler(test_lpbk, NULL, &answer_by_entry);
+
+    // ---- Both entries are sent the request on each attempt.
+    test_entry_codes[0] = 503;
+    test_entry_codes[1] = 503;
+
+    cnt = qn_http_lpbk_get_request_count(test_lpbk);
+    ret = qn_stor_mn_api_stat(test_stor, test_mac, "bucket", "key", test_mne);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 503);
+    CU_ASSERT_EQUAL(qn_http_lpbk_get_request_count(test_lpbk), cnt + 6);
+
+    qn_http_lpbk_set_handler(test_lpbk, NULL, NULL);
+    qn_stor_mne_set_region_host(test_mne, NULL);
+    qn_stor_set_retry_policy(test_stor, NULL);
+    qn_stor_set_hedging_delay(test_stor, 0);
+}
+
+// ---- Answer the resumable upload APIs as the server does, and record the size of each chunk put.
+static qn_fsize test_chunk_sizes[16];
+static int test_chunk_cnt;
+static int test_failed_chunk;
+static qn_fsize test_blk_offset;
+
+static qn_bool answer_resumable_upload(void * restrict user_data, qn_http_loopback_ptr restrict lpbk, const char * restrict url, qn_http_request_ptr restrict req)
+{
+    static const char mkfile_ret[] = {"{\"hash\":\"hash\",\"key\":\"key\"}"};
+    static const char error_ret[] = {"{\"error\":\"service unavailable\"}"};
+    char put_ret[256];
+    int size;
+
+    if (strstr(url, "/mkfile/")) return qn_http_lpbk_set_response(lpbk, 200, mkfile_ret, sizeof(mkfile_ret) - 1);
+    if (test_chunk_cnt >= sizeof(test_chunk_sizes) / sizeof(test_chunk_sizes[0])) return qn_false;
+
+    test_chunk_sizes[test_chunk_cnt] = qn_http_req_body_size(req);
+    if (test_chunk_cnt++ == test_failed_chunk) return qn_http_lpbk_set_response(lpbk, 503, error_ret, sizeof(error_ret) - 1);
+
+    if (strstr(url, "/mkblk/")) test_blk_offset = 0;
+    test_blk_offset += qn_http_req_body_size(req);
+    size = snprintf(put_ret, sizeof(put_ret), "{\"ctx\":\"ctx\",\"checksum\":\"checksum\",\"crc32\":1,\"offset\":%d,\"host\":\"http://up.loopback.invalid\"}", (int)test_blk_offset);
+    return qn_http_lpbk_set_response(lpbk, 200, put_ret, size);
+}
+
+static qn_json_object_ptr upload_one_block(qn_stor_chunk_policy_ptr restrict chp, int failed_chunk)
+{
+    qn_string fname;
+    qn_file_ptr fl;
+    qn_stor_resumable_upload_ptr ru;
+    qn_stor_upload_extra_ptr upe;
+    qn_json_object_ptr ret = NULL;
+    int start_idx = 0;
+
+    test_chunk_cnt = 0;
+    test_failed_chunk = failed_chunk;
+    qn_stor_set_chunk_policy(test_stor, chp);
+    qn_http_lpbk_set_handler(test_lpbk, NULL, &answer_resumable_upload);
+
+    if ((fname = make_temp_file(TEST_RU_BLOCK_SIZE))) {
+        if ((fl = qn_fl_open(fname, NULL))) {
+            if ((ru = qn_stor_ru_create(qn_fl_to_io_reader(fl)))) {
+                if ((upe = qn_stor_upe_create())) {
+                    qn_stor_upe_set_region_entry(upe, qn_rgn_host_get_entry(test_rgn_host, 0));
+                    ret = qn_stor_ru_upload_huge(test_stor, "uptoken", ru, &start_idx, 0, upe);
+                    qn_stor_upe_destroy(upe);
+                } // if
+                qn_stor_ru_destroy(ru);
+            } // if
+            qn_fl_close(fl);
+        } // if
+        unlink(fname);
+        qn_str_destroy(fname);
+    } // if
+
+    qn_http_lpbk_set_handler(test_lpbk, NULL, NULL);
+    qn_stor_set_chunk_policy(test_stor, NULL);
+    return ret;
+}
+
+void test_clamp_chunk_size_into_range(void)
+{
+    qn_stor_chunk_policy_ptr chp = qn_stor_chp_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(chp);
+    CU_ASSERT_EQUAL(qn_stor_chp_get_chunk_size(chp), QN_STOR_RU_CHUNK_DEFAULT_SIZE);
+
+    qn_stor_chp_set_size_range(chp, 1024 * 64, 1024 * 128);
+    CU_ASSERT_EQUAL(qn_stor_chp_get_chunk_size(chp), 1024 * 128);
+
+    // ---- The minimum is raised to 16KB, and the maximum falls back to the block size.
+    qn_stor_chp_set_size_range(chp, 1, 0);
+    CU_ASSERT_EQUAL(qn_stor_chp_get_chunk_size(chp), 1024 * 128);
+    qn_stor_chp_set_size_range(chp, 1024 * 1024, 0);
+    CU_ASSERT_EQUAL(qn_stor_chp_get_chunk_size(chp), 1024 * 1024);
+
+    qn_stor_chp_destroy(chp);
+}
+
+void test_grow_chunks_on_fast_link(void)
+{
+    qn_stor_chunk_policy_ptr chp;
+    qn_json_object_ptr ret;
+
+    chp = qn_stor_chp_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(chp);
+
+    // ---- The loopback link is far faster than one chunk per second, so each chunk doubles until the block size is reached.
+    ret = upload_one_block(chp, -1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 200);
+    CU_ASSERT_EQUAL_FATAL(test_chunk_cnt, 5);
+    CU_ASSERT_EQUAL(test_chunk_sizes[0], 1024 * 256);
+    CU_ASSERT_EQUAL(test_chunk_sizes[1], 1024 * 512);
+    CU_ASSERT_EQUAL(test_chunk_sizes[2], 1024 * 1024);
+    CU_ASSERT_EQUAL(test_chunk_sizes[3], 1024 * 1024 * 2);
+    CU_ASSERT_EQUAL(test_chunk_sizes[4], 1024 * 256);
+    CU_ASSERT_EQUAL(qn_stor_chp_get_chunk_size(chp), TEST_RU_BLOCK_SIZE);
+
+    qn_stor_chp_destroy(chp);
+}
+
+void test_halve_chunks_after_failure(void)
+{
+    qn_stor_chunk_policy_ptr chp;
+    qn_json_object_ptr ret;
+
+    chp = qn_stor_chp_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(chp);
+
+    ret = upload_one_block(chp, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ret);
+    CU_ASSERT_EQUAL(get_code(ret), 503);
+    CU_ASSERT_EQUAL_FATAL(test_chunk_cnt, 2);
+    CU_ASSERT_EQUAL(test_chunk_sizes[1], 1024 * 512);
+    CU_ASSERT_EQUAL(qn_stor_chp_get_chunk_size(chp), 1024 * 256);
+
+    qn_stor_chp_destroy(chp);
+}
+
+CU_TestInfo test_chunk_policy_of_resumable_upload[] = {
+    {"test_clamp_chunk_size_into_range()", test_clamp_chunk_size_into_range},
+    {"test_grow_chunks_on_fast_link()", test_grow_chunks_on_fast_link},
+    {"test_halve_chunks_after_failure()", test_halve_chunks_after_failure},
+    CU_TEST_INFO_NULL
+};
+
+CU_TestInfo test_hedging_of_storage_apis[] = {
+    {"test_hedge_answered_by_second_entry()", test_hedge_answered_by_second_entry},
+    {"test_hedge_prefers_completed_response()", test_hedge_prefers_completed_response},
+    {"test_hedge_with_retry_policy()", test_hedge_with_retry_policy},
+    CU_TEST_INFO_NULL
+};
+
+CU_TestInfo test_retry_of_storage_apis[] = {
+    {"test_retry_batch_with_array_body()", test_retry_batch_with_array_body},
+    {"test_retry_stat_until_success()", test_retry_stat_until_success},
+    CU_TEST_INFO_NULL
+};
+
+CU_TestInfo test_normal_cases_of_resumable_upload[] = {
+    {"test_read_contexts_in_small_pieces()", test_read_contexts_in_small_pieces},
+    {"test_read_block_beyond_2gb()", test_read_block_beyond_2gb},
+    {"test_round_trip_through_journal()", test_round_trip_through_journal},
+    {"test_replay_journal_with_torn_tail()", test_replay_journal_with_torn_tail},
+    CU_TEST_INFO_NULL
+};
+
+// ---- test suites ----
+
+CU_SuiteInfo suites[] = {
+    {"test_normal_cases_of_resumable_upload", NULL, NULL, test_normal_cases_of_resumable_upload},
+    {"test_retry_of_storage_apis", init_loopback_storage, clean_loopback_storage, test_retry_of_storage_apis},
+    {"test_hedging_of_storage_apis", init_loopback_storage, clean_loopback_storage, test_hedging_of_storage_apis},
+    {"test_chunk_policy_of_resumable_upload", init_loopback_storage, clean_loopback_storage, test_chunk_policy_of_resumable_upload},
+    CU_SUITE_INFO_NULL
+};
+
+int main(void)
+{
+    CU_pSuite pSuite = NULL;
+
+    if (CU_initialize_registry() != CUE_SUCCESS) {
+        return CU_get_error();
+    } // if
+
+    pSuite = CU_add_suite("Suite_Test_Storage", NULL, NULL);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    } // if
+
+    if (CU_register_suites(suites) != CUE_SUCCESS) {
+        printf("Cannot register test suites.\n");
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}